@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstring>
+#include <iostream>
+
+#include "decimal_limbs.h"
+#include "limb_operations.h"
+
+// Formatting of vectors as binary and hex digits into caller supplied
+// buffers. Digits come out of lookup tables a byte or a nibble at a time,
+// and x and z are picked by table index rather than by testing bits, so
+// wide four valued buses format without allocating or branching per bit.
+//
+// The formatters take the limbs of the value plane and, for four valued
+// vectors, of the unknown plane, using the encoding of
+// quad_value_bit_vector. Two valued vectors pass a null unknown plane.
+
+namespace bsim {
+
+  struct bit_format_table {
+    // The 8 binary digits of every byte, most significant first
+    char binary[256][8];
+
+    // The hex digit of every (unknown nibble << 4) | value nibble. A
+    // nibble with unknown bits prints as x or z after its lowest unknown
+    // bit.
+    char hex[256];
+
+    bit_format_table() {
+      for (int b = 0; b < 256; b++) {
+        for (int j = 0; j < 8; j++) {
+          binary[b][7 - j] = (b >> j) & 0x01 ? '1' : '0';
+        }
+      }
+
+      for (int unk = 0; unk < 16; unk++) {
+        for (int val = 0; val < 16; val++) {
+          char digit;
+          if (unk == 0) {
+            digit = val > 9 ? val + 87 : val + 48;
+          } else {
+            digit = (val & unk & (-unk)) ? 'z' : 'x';
+          }
+          hex[(unk << 4) | val] = digit;
+        }
+      }
+    }
+  };
+
+  static inline const bit_format_table& bit_format_tables() {
+    static const bit_format_table table;
+    return table;
+  }
+
+  static inline unsigned char limb_byte(const bv_uint64* w, const int k) {
+    return (w[k / 8] >> (8*(k % 8))) & 0xff;
+  }
+
+  static inline char quad_bit_char(const bv_uint64* value,
+                                   const bv_uint64* unknown,
+                                   const int i) {
+    static const char quad_chars[] = {'0', '1', 'x', 'z'};
+
+    const int k = i / BV_WORD_BITS;
+    const int shift = i % BV_WORD_BITS;
+    const int v = (value[k] >> shift) & 0x01;
+    const int u = unknown == nullptr ? 0 : (unknown[k] >> shift) & 0x01;
+    return quad_chars[v | (u << 1)];
+  }
+
+  // Writes bits [start, end) as end - start binary digits, most
+  // significant first, and returns the end of the output
+  static inline char* format_binary_limbs(char* out,
+                                          const bv_uint64* value,
+                                          const bv_uint64* unknown,
+                                          const int start,
+                                          const int end) {
+    static const char quad_chars[] = {'0', '1', 'x', 'z'};
+    const bit_format_table& table = bit_format_tables();
+
+    int i = end;
+    while ((i > start) && (((i % 8) != 0) || (i - 8 < start))) {
+      i--;
+      *out++ = quad_bit_char(value, unknown, i);
+    }
+
+    while (i - 8 >= start) {
+      i -= 8;
+      const unsigned char v = limb_byte(value, i / 8);
+      const unsigned char u = unknown == nullptr ? 0 : limb_byte(unknown, i / 8);
+
+      if (u == 0) {
+        memcpy(out, table.binary[v], 8);
+        out += 8;
+      } else {
+        for (int j = 7; j >= 0; j--) {
+          *out++ = quad_chars[((v >> j) & 0x01) | (((u >> j) & 0x01) << 1)];
+        }
+      }
+    }
+
+    while (i > start) {
+      i--;
+      *out++ = quad_bit_char(value, unknown, i);
+    }
+
+    return out;
+  }
+
+  // Writes the (width + 3) / 4 hex digits of a vector, most significant
+  // first, and returns the end of the output
+  static inline char* format_hex_limbs(char* out,
+                                       const bv_uint64* value,
+                                       const bv_uint64* unknown,
+                                       const int width) {
+    const bit_format_table& table = bit_format_tables();
+
+    for (int d = (width + 3) / 4 - 1; d >= 0; d--) {
+      const int k = (4*d) / BV_WORD_BITS;
+      const int shift = (4*d) % BV_WORD_BITS;
+
+      const int val = (value[k] >> shift) & 0x0f;
+      const int unk = unknown == nullptr ? 0 : (unknown[k] >> shift) & 0x0f;
+      *out++ = table.hex[(unk << 4) | val];
+    }
+
+    return out;
+  }
+
+  static inline int decimal_digit_count(int n) {
+    int count = 1;
+    while (n >= 10) {
+      n /= 10;
+      count++;
+    }
+    return count;
+  }
+
+  // Writes width'base, as in 12'h
+  static inline char* format_width_prefix(char* out,
+                                          const int width,
+                                          const char base) {
+    const int count = decimal_digit_count(width);
+    int n = width;
+    for (int i = count - 1; i >= 0; i--) {
+      out[i] = '0' + (n % 10);
+      n /= 10;
+    }
+    out += count;
+
+    *out++ = '\'';
+    *out++ = base;
+    return out;
+  }
+
+  // Size of the output of the binary and hex formatters of a vector of
+  // width bits, hex output includes the width'h prefix
+  static inline int binary_format_length(const int width) {
+    return width;
+  }
+
+  static inline int hex_format_length(const int width) {
+    return decimal_digit_count(width) + 2 + (width + 3) / 4;
+  }
+
+  // The single digit Verilog's %d prints for a value with unknown bits:
+  // x or z when every bit is x or every bit is z, otherwise X when any
+  // bit is x and Z when only some bits are z
+  static inline char unknown_decimal_char(const bv_uint64* value,
+                                          const bv_uint64* unknown,
+                                          const int width) {
+    bool any_x = false;
+    bool all_x = true;
+    bool all_z = true;
+    for (int i = 0; i < NUM_WORDS(width); i++) {
+      const bv_uint64 mask = i == NUM_WORDS(width) - 1 ? top_word_mask(width) : ~((bv_uint64) 0);
+      const bv_uint64 x = unknown[i] & ~value[i];
+      const bv_uint64 z = unknown[i] & value[i];
+
+      any_x = any_x || (x != 0);
+      all_x = all_x && (x == mask);
+      all_z = all_z && (z == mask);
+    }
+
+    if (all_x) {
+      return 'x';
+    }
+    if (all_z) {
+      return 'z';
+    }
+    return any_x ? 'X' : 'Z';
+  }
+
+  // Streams the binary digits of a vector through a fixed buffer
+  static inline std::ostream& write_binary_limbs(std::ostream& out,
+                                                 const bv_uint64* value,
+                                                 const bv_uint64* unknown,
+                                                 const int width) {
+    char buf[512];
+    for (int end = width; end > 0; end -= (int) sizeof(buf)) {
+      const int start = end > (int) sizeof(buf) ? end - (int) sizeof(buf) : 0;
+      format_binary_limbs(buf, value, unknown, start, end);
+      out.write(buf, end - start);
+    }
+    return out;
+  }
+
+}
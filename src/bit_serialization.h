@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "limb_operations.h"
+
+// Binary records for saving and restoring vectors. A record is an 8 byte
+// header followed by the limbs of the vector:
+//
+//   byte 0      format version, BV_SERIAL_VERSION
+//   byte 1      flags, BV_SERIAL_UNKNOWN_PLANE when an x/z plane follows
+//   bytes 2-3   zero
+//   bytes 4-7   width in bits
+//
+// then NUM_WORDS(width) value limbs and, with the flag set, as many
+// unknown plane limbs. All fields are little endian, so on little endian
+// hosts the limbs are copied in and out with a single memcpy per plane.
+// Records can be written back to back and read in order, which makes a
+// dump of a whole design a sequence of memcpys.
+
+#define BV_SERIAL_VERSION 1
+#define BV_SERIAL_UNKNOWN_PLANE 0x01
+#define BV_SERIAL_HEADER_BYTES 8
+
+namespace bsim {
+
+  // Bytes being read, deserialize_from consumes records from the front
+  struct byte_span {
+    const unsigned char* data;
+    size_t size;
+
+    byte_span(const unsigned char* data_, const size_t size_) :
+      data(data_), size(size_) {}
+
+    explicit byte_span(const std::vector<unsigned char>& bytes) :
+      data(bytes.data()), size(bytes.size()) {}
+
+    inline void advance(const size_t n) {
+      data += n;
+      size -= n;
+    }
+  };
+
+  static inline bv_uint64 little_endian_limb(const bv_uint64 w) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return __builtin_bswap64(w);
+#else
+    return w;
+#endif
+  }
+
+  static inline size_t serialized_record_size(const int width,
+                                              const bool has_unknown) {
+    const size_t plane_bytes = sizeof(bv_uint64)*NUM_WORDS(width);
+    return BV_SERIAL_HEADER_BYTES + (has_unknown ? 2 : 1)*plane_bytes;
+  }
+
+  static inline unsigned char* write_serial_limbs(unsigned char* out,
+                                                  const bv_uint64* w,
+                                                  const int n) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    for (int i = 0; i < n; i++) {
+      const bv_uint64 le = little_endian_limb(w[i]);
+      memcpy(out + sizeof(bv_uint64)*i, &le, sizeof(bv_uint64));
+    }
+#else
+    if (n > 0) {
+      memcpy(out, w, sizeof(bv_uint64)*n);
+    }
+#endif
+    return out + sizeof(bv_uint64)*n;
+  }
+
+  static inline void read_serial_limbs(bv_uint64* w,
+                                       const unsigned char* in,
+                                       const int n) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    for (int i = 0; i < n; i++) {
+      bv_uint64 le;
+      memcpy(&le, in + sizeof(bv_uint64)*i, sizeof(bv_uint64));
+      w[i] = little_endian_limb(le);
+    }
+#else
+    if (n > 0) {
+      memcpy(w, in, sizeof(bv_uint64)*n);
+    }
+#endif
+  }
+
+  // Writes a whole record, unknown is null for two valued vectors.
+  // Returns the end of the output.
+  static inline unsigned char* write_serial_record(unsigned char* out,
+                                                   const int width,
+                                                   const bv_uint64* value,
+                                                   const bv_uint64* unknown) {
+    out[0] = BV_SERIAL_VERSION;
+    out[1] = unknown == nullptr ? 0 : BV_SERIAL_UNKNOWN_PLANE;
+    out[2] = 0;
+    out[3] = 0;
+    for (int i = 0; i < 4; i++) {
+      out[4 + i] = (((unsigned) width) >> (8*i)) & 0xff;
+    }
+    out += BV_SERIAL_HEADER_BYTES;
+
+    out = write_serial_limbs(out, value, NUM_WORDS(width));
+    if (unknown != nullptr) {
+      out = write_serial_limbs(out, unknown, NUM_WORDS(width));
+    }
+    return out;
+  }
+
+  // Checks the header of the record at the front of in, and that the
+  // whole record is there. The limbs start BV_SERIAL_HEADER_BYTES in.
+  static inline bool read_serial_header(const byte_span& in,
+                                        int* width,
+                                        bool* has_unknown) {
+    if ((in.size < BV_SERIAL_HEADER_BYTES) ||
+        (in.data[0] != BV_SERIAL_VERSION) ||
+        ((in.data[1] & ~BV_SERIAL_UNKNOWN_PLANE) != 0)) {
+      return false;
+    }
+
+    unsigned w = 0;
+    for (int i = 0; i < 4; i++) {
+      w |= ((unsigned) in.data[4 + i]) << (8*i);
+    }
+    if (w > 0x7fffffffu - BV_WORD_BITS) {
+      return false;
+    }
+
+    *width = (int) w;
+    *has_unknown = (in.data[1] & BV_SERIAL_UNKNOWN_PLANE) != 0;
+
+    return in.size >= serialized_record_size(*width, *has_unknown);
+  }
+
+}
@@ -0,0 +1,453 @@
+#pragma once
+
+#include <cassert>
+#include <cstring>
+
+#include "limb_operations.h"
+
+// Non-owning views of a run of bits inside a vector's storage. A view
+// reads and writes its field a limb at a time, so fields can be decoded
+// out of wide buses, compared or overwritten without building a new
+// vector. Views are made with span() and const_span() from the vector
+// headers and are only valid while the vector they look into is alive
+// and keeps its width.
+//
+// Storage is addressed as little endian bytes, which covers both the byte
+// arrays of bit_vector<N> and the limbs of dynamic_bit_vector.
+//
+// The four valued vectors have a value plane and an unknown plane, so
+// their views, const_quad_bit_span and quad_bit_span, look at the same
+// bits of both planes. A writable quad view stores through the vector's
+// set_value_word and set_unknown_word, which keeps the vector's cached
+// binary summary up to date.
+
+namespace bsim {
+
+  // Limb k of a storage area of storage_bytes bytes, bytes past the end
+  // read as zero
+  static inline bv_uint64 load_storage_limb(const unsigned char* data,
+                                            const int storage_bytes,
+                                            const int k) {
+    const int start = 8*k;
+    if (start >= storage_bytes) {
+      return 0;
+    }
+
+    bv_uint64 w = 0;
+    const int n = storage_bytes - start < 8 ? storage_bytes - start : 8;
+    memcpy(&w, data + start, n);
+    return w;
+  }
+
+  static inline void store_storage_limb(unsigned char* data,
+                                        const int storage_bytes,
+                                        const int k,
+                                        const bv_uint64 w) {
+    const int start = 8*k;
+    if (start >= storage_bytes) {
+      return;
+    }
+
+    const int n = storage_bytes - start < 8 ? storage_bytes - start : 8;
+    memcpy(data + start, &w, n);
+  }
+
+  // Bits [pos, pos + count) of the storage, count <= 64
+  static inline bv_uint64 read_storage_bits(const unsigned char* data,
+                                            const int storage_bytes,
+                                            const int pos,
+                                            const int count) {
+    if (count == 0) {
+      return 0;
+    }
+
+    const int k = pos / BV_WORD_BITS;
+    const int shift = pos % BV_WORD_BITS;
+
+    bv_uint64 w = load_storage_limb(data, storage_bytes, k) >> shift;
+    if ((shift != 0) && (count > BV_WORD_BITS - shift)) {
+      w |= load_storage_limb(data, storage_bytes, k + 1) << (BV_WORD_BITS - shift);
+    }
+
+    return w & top_word_mask(count);
+  }
+
+  static inline void write_storage_bits(unsigned char* data,
+                                        const int storage_bytes,
+                                        const int pos,
+                                        const int count,
+                                        const bv_uint64 value) {
+    if (count == 0) {
+      return;
+    }
+
+    const int k = pos / BV_WORD_BITS;
+    const int shift = pos % BV_WORD_BITS;
+    const bv_uint64 mask = top_word_mask(count);
+    const bv_uint64 v = value & mask;
+
+    bv_uint64 low = load_storage_limb(data, storage_bytes, k);
+    low = (low & ~(mask << shift)) | (v << shift);
+    store_storage_limb(data, storage_bytes, k, low);
+
+    if ((shift != 0) && (count > BV_WORD_BITS - shift)) {
+      const int high_shift = BV_WORD_BITS - shift;
+      bv_uint64 high = load_storage_limb(data, storage_bytes, k + 1);
+      high = (high & ~(mask >> high_shift)) | (v >> high_shift);
+      store_storage_limb(data, storage_bytes, k + 1, high);
+    }
+  }
+
+  class const_bit_span {
+    const unsigned char* data;
+    int storage_bytes;
+    int offset;
+    int length;
+
+  public:
+    const_bit_span(const unsigned char* data_,
+                   const int storage_bytes_,
+                   const int offset_,
+                   const int length_) :
+      data(data_), storage_bytes(storage_bytes_),
+      offset(offset_), length(length_) {
+      assert(offset >= 0);
+      assert(length >= 0);
+    }
+
+    inline int bitLength() const {
+      return length;
+    }
+
+    inline int num_words() const {
+      return NUM_WORDS(length);
+    }
+
+    unsigned char get(const int ind) const {
+      assert(ind < length);
+      return (unsigned char) read_storage_bits(data, storage_bytes, offset + ind, 1);
+    }
+
+    // Limb i of the field, bits past the end of the field are zero
+    inline bv_uint64 get_word(const int i) const {
+      const int pos = BV_WORD_BITS*i;
+      const int count = length - pos < BV_WORD_BITS ? length - pos : BV_WORD_BITS;
+      return read_storage_bits(data, storage_bytes, offset + pos, count);
+    }
+
+    // Only meaningful for fields of 64 bits or less
+    inline bv_uint64 as_native_uint64() const {
+      return length == 0 ? 0 : get_word(0);
+    }
+
+    // The sub field [start, end) of this one
+    inline const_bit_span subspan(const int start, const int end) const {
+      assert(start <= end);
+      assert(end <= length);
+      return const_bit_span(data, storage_bytes, offset + start, end - start);
+    }
+  };
+
+  class bit_span {
+    unsigned char* data;
+    int storage_bytes;
+    int offset;
+    int length;
+
+  public:
+    bit_span(unsigned char* data_,
+             const int storage_bytes_,
+             const int offset_,
+             const int length_) :
+      data(data_), storage_bytes(storage_bytes_),
+      offset(offset_), length(length_) {
+      assert(offset >= 0);
+      assert(length >= 0);
+    }
+
+    operator const_bit_span() const {
+      return const_bit_span(data, storage_bytes, offset, length);
+    }
+
+    inline int bitLength() const {
+      return length;
+    }
+
+    inline int num_words() const {
+      return NUM_WORDS(length);
+    }
+
+    unsigned char get(const int ind) const {
+      return const_bit_span(*this).get(ind);
+    }
+
+    inline bv_uint64 get_word(const int i) const {
+      return const_bit_span(*this).get_word(i);
+    }
+
+    inline bv_uint64 as_native_uint64() const {
+      return const_bit_span(*this).as_native_uint64();
+    }
+
+    inline void set(const int ind, const unsigned char val) {
+      assert(ind < length);
+      write_storage_bits(data, storage_bytes, offset + ind, 1, val & 0x01);
+    }
+
+    // Bits of w past the end of the field are dropped
+    inline void set_word(const int i, const bv_uint64 w) {
+      const int pos = BV_WORD_BITS*i;
+      const int count = length - pos < BV_WORD_BITS ? length - pos : BV_WORD_BITS;
+      write_storage_bits(data, storage_bytes, offset + pos, count, w);
+    }
+
+    // Copies src into the field. src must have the same length and must
+    // not overlap the field.
+    inline void assign(const const_bit_span& src) {
+      assert(src.bitLength() == length);
+      for (int i = 0; i < num_words(); i++) {
+        set_word(i, src.get_word(i));
+      }
+    }
+
+    inline void fill(const unsigned char val) {
+      const bv_uint64 w = (val & 0x01) ? ~((bv_uint64) 0) : 0;
+      for (int i = 0; i < num_words(); i++) {
+        set_word(i, w);
+      }
+    }
+
+    inline bit_span subspan(const int start, const int end) const {
+      assert(start <= end);
+      assert(end <= length);
+      return bit_span(data, storage_bytes, offset + start, end - start);
+    }
+  };
+
+  static inline bool operator==(const const_bit_span& a,
+                                const const_bit_span& b) {
+    if (a.bitLength() != b.bitLength()) {
+      return false;
+    }
+
+    for (int i = 0; i < a.num_words(); i++) {
+      if (a.get_word(i) != b.get_word(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static inline bool operator!=(const const_bit_span& a,
+                                const const_bit_span& b) {
+    return !(a == b);
+  }
+
+  static inline int popcount(const const_bit_span& a) {
+    int count = 0;
+    for (int i = 0; i < a.num_words(); i++) {
+      count += popcount_word(a.get_word(i));
+    }
+    return count;
+  }
+
+  // Reductions of a field, returned as a single bit
+  static inline unsigned char andr(const const_bit_span& a) {
+    return popcount(a) == a.bitLength();
+  }
+
+  static inline unsigned char orr(const const_bit_span& a) {
+    for (int i = 0; i < a.num_words(); i++) {
+      if (a.get_word(i) != 0) {
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  static inline unsigned char xorr(const const_bit_span& a) {
+    return popcount(a) & 0x01;
+  }
+
+  class const_quad_bit_span {
+    const unsigned char* value;
+    const unsigned char* unknown;
+    int storage_bytes;
+    int offset;
+    int length;
+
+  public:
+    const_quad_bit_span(const bv_uint64* value_,
+                        const bv_uint64* unknown_,
+                        const int num_words_,
+                        const int offset_,
+                        const int length_) :
+      value((const unsigned char*) value_),
+      unknown((const unsigned char*) unknown_),
+      storage_bytes(8*num_words_),
+      offset(offset_), length(length_) {
+      assert(offset >= 0);
+      assert(length >= 0);
+    }
+
+    inline int bitLength() const {
+      return length;
+    }
+
+    inline int num_words() const {
+      return NUM_WORDS(length);
+    }
+
+    // Limb i of each plane of the field, bits past the end of the field
+    // are zero
+    inline bv_uint64 get_value_word(const int i) const {
+      const int pos = BV_WORD_BITS*i;
+      const int count = length - pos < BV_WORD_BITS ? length - pos : BV_WORD_BITS;
+      return read_storage_bits(value, storage_bytes, offset + pos, count);
+    }
+
+    inline bv_uint64 get_unknown_word(const int i) const {
+      const int pos = BV_WORD_BITS*i;
+      const int count = length - pos < BV_WORD_BITS ? length - pos : BV_WORD_BITS;
+      return read_storage_bits(unknown, storage_bytes, offset + pos, count);
+    }
+
+    // Whether no bit of the field is x or z
+    inline bool is_binary() const {
+      for (int i = 0; i < num_words(); i++) {
+        if (get_unknown_word(i) != 0) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    inline const_quad_bit_span subspan(const int start, const int end) const {
+      assert(start <= end);
+      assert(end <= length);
+      return const_quad_bit_span((const bv_uint64*) value,
+                                 (const bv_uint64*) unknown,
+                                 storage_bytes / 8,
+                                 offset + start,
+                                 end - start);
+    }
+  };
+
+  // A writable view of a four valued vector, either quad_value_bit_vector
+  // or static_quad_value_bit_vector<N>
+  template<typename Vector>
+  class quad_bit_span {
+    Vector* v;
+    int offset;
+    int length;
+
+    // Stores count <= 64 bits at pos of one plane of v, a limb at a time
+    // through get and set
+    template<typename Get, typename Set>
+    static inline void write_plane_bits(Get get,
+                                        Set set,
+                                        const int pos,
+                                        const int count,
+                                        const bv_uint64 w) {
+      if (count == 0) {
+        return;
+      }
+
+      const int k = pos / BV_WORD_BITS;
+      const int shift = pos % BV_WORD_BITS;
+      const bv_uint64 mask = top_word_mask(count);
+      const bv_uint64 bits = w & mask;
+
+      set(k, (get(k) & ~(mask << shift)) | (bits << shift));
+      if ((shift != 0) && (count > BV_WORD_BITS - shift)) {
+        const int high_shift = BV_WORD_BITS - shift;
+        set(k + 1, (get(k + 1) & ~(mask >> high_shift)) | (bits >> high_shift));
+      }
+    }
+
+  public:
+    quad_bit_span(Vector& v_, const int offset_, const int length_) :
+      v(&v_), offset(offset_), length(length_) {
+      assert(offset >= 0);
+      assert(length >= 0);
+      assert(offset + length <= v->bitLength());
+    }
+
+    operator const_quad_bit_span() const {
+      return const_quad_bit_span(v->value_data(), v->unknown_data(),
+                                 v->num_words(), offset, length);
+    }
+
+    inline int bitLength() const {
+      return length;
+    }
+
+    inline int num_words() const {
+      return NUM_WORDS(length);
+    }
+
+    inline bv_uint64 get_value_word(const int i) const {
+      return const_quad_bit_span(*this).get_value_word(i);
+    }
+
+    inline bv_uint64 get_unknown_word(const int i) const {
+      return const_quad_bit_span(*this).get_unknown_word(i);
+    }
+
+    inline bool is_binary() const {
+      return const_quad_bit_span(*this).is_binary();
+    }
+
+    // Bits of w past the end of the field are dropped
+    inline void set_value_word(const int i, const bv_uint64 w) {
+      const int pos = BV_WORD_BITS*i;
+      const int count = length - pos < BV_WORD_BITS ? length - pos : BV_WORD_BITS;
+      Vector* vec = v;
+      write_plane_bits([vec](const int k) { return vec->get_value_word(k); },
+                       [vec](const int k, const bv_uint64 x) { vec->set_value_word(k, x); },
+                       offset + pos, count, w);
+    }
+
+    inline void set_unknown_word(const int i, const bv_uint64 w) {
+      const int pos = BV_WORD_BITS*i;
+      const int count = length - pos < BV_WORD_BITS ? length - pos : BV_WORD_BITS;
+      Vector* vec = v;
+      write_plane_bits([vec](const int k) { return vec->get_unknown_word(k); },
+                       [vec](const int k, const bv_uint64 x) { vec->set_unknown_word(k, x); },
+                       offset + pos, count, w);
+    }
+
+    // Copies src into the field. src must have the same length and must
+    // not overlap the field.
+    inline void assign(const const_quad_bit_span& src) {
+      assert(src.bitLength() == length);
+      for (int i = 0; i < num_words(); i++) {
+        set_value_word(i, src.get_value_word(i));
+        set_unknown_word(i, src.get_unknown_word(i));
+      }
+    }
+
+    inline quad_bit_span subspan(const int start, const int end) const {
+      assert(start <= end);
+      assert(end <= length);
+      return quad_bit_span(*v, offset + start, end - start);
+    }
+  };
+
+  // Whether two fields hold the same bits, comparing x and z exactly
+  static inline bool same_representation(const const_quad_bit_span& a,
+                                         const const_quad_bit_span& b) {
+    if (a.bitLength() != b.bitLength()) {
+      return false;
+    }
+
+    for (int i = 0; i < a.num_words(); i++) {
+      if ((a.get_value_word(i) != b.get_value_word(i)) ||
+          (a.get_unknown_word(i) != b.get_unknown_word(i))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+}
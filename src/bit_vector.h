@@ -2,10 +2,17 @@
 
 #include <bitset>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <stdint.h>
 #include <type_traits>
 
+#include "bit_span.h"
+#include "bit_format.h"
+#include "bit_serialization.h"
+#include "limb_operations.h"
+#include "verilog_literal.h"
+
 #define GEN_NUM_BYTES(N) (((N) / 8) + 1 - (((N) % 8 == 0)))
 #define NUM_BYTES_GT_8(N) GEN_NUM_BYTES(N)
 #define NUM_BYTES_GT_4(N) (N <= 64 ? 8 : NUM_BYTES_GT_8(N))
@@ -13,8 +20,13 @@
 #define NUM_BYTES_GT_1(N) (N <= 16 ? 2 : NUM_BYTES_GT_2(N))
 #define NUM_BYTES(N) (N <= 8 ? (1) : NUM_BYTES_GT_1(N))
 
+// Vectors wider than one limb are padded to a whole number of limbs so
+// that the arithmetic can work a limb at a time
+#define NUM_STORAGE_BYTES(N) (N <= 64 ? NUM_BYTES(N) : 8*NUM_WORDS(N))
+
 typedef int8_t  bv_sint8;
 typedef int32_t  bv_sint32;
+typedef int64_t  bv_sint64;
 
 typedef uint8_t  bv_uint8;
 typedef uint16_t bv_uint16;
@@ -23,49 +35,65 @@ typedef uint64_t bv_uint64;
 
 namespace bsim {
 
+  // Smallest unsigned integer type that holds N bits, used for the native
+  // instruction paths of vectors up to 64 bits wide
+  template<int N>
+  struct native_uint {
+    typedef typename std::conditional<(N <= 8), bv_uint8,
+      typename std::conditional<(N <= 16), bv_uint16,
+        typename std::conditional<(N <= 32), bv_uint32,
+                                  bv_uint64>::type>::type>::type type;
+  };
+
   template<int N>
   class bit_vector {
-    unsigned char bits[NUM_BYTES(N)];
+    unsigned char bits[NUM_STORAGE_BYTES(N)];
 
   public:
+    typedef typename native_uint<N>::type native_type;
+
     bit_vector() {
-      for (int i = 0; i < N; i++) {
-	set(i, 0);
+      for (int i = 0; i < NUM_STORAGE_BYTES(N); i++) {
+	bits[i] = 0;
       }
     }
 
-    bit_vector(const std::string& str) {
-      assert(str.size() == N);
+    // Either a Verilog literal of width N, such as 8'hff, or a string of
+    // binary digits. x and z digits read as zero.
+    bit_vector(const std::string& str) : bit_vector() {
+      const verilog_literal lit = str.find('\'') == std::string::npos ?
+        binary_digits_literal(N, str) : parse_verilog_literal(str);
+      assert(lit.width == N);
 
-      for (int i = N - 1; i >= 0; i--) {
-	unsigned char val = (str[i] == '0') ? 0 : 1;
-	int ind = N - i - 1;
-	set(ind, val);
+      bv_uint64 limbs[NUM_WORDS(N)];
+      decode_verilog_literal(lit, limbs, nullptr);
+      for (int i = 0; i < NUM_WORDS(N); i++) {
+        set_word(i, limbs[i]);
       }
     }
 
-    bit_vector(const int val) {
-      *((int*) (&bits)) = val;
+    bit_vector(const int val) : bit_vector() {
+      set_native(val);
     }
 
-    bit_vector(const bv_uint64 val) {
-      *((bv_uint64*)(&bits)) = val;
+    bit_vector(const bv_uint64 val) : bit_vector() {
+      set_native(val);
     }
     
-    bit_vector(const bv_uint32 val) {
-      *((bv_uint32*)(&bits)) = val;
+    bit_vector(const bv_uint32 val) : bit_vector() {
+      set_native(val);
     }
 
-    bit_vector(const bv_uint16 val) {
-      *((bv_uint16*)(&bits)) = val;
+    bit_vector(const bv_uint16 val) : bit_vector() {
+      set_native(val);
     }
 
-    bit_vector(const bv_uint8 val) {
-      *((bv_uint8*)(&bits)) = val;
+    bit_vector(const bv_uint8 val) : bit_vector() {
+      set_native(val);
     }
     
     bit_vector(const bit_vector<N>& other) {
-      for (int i = 0; i < NUM_BYTES(N); i++) {
+      for (int i = 0; i < NUM_STORAGE_BYTES(N); i++) {
 	bits[i] = other.bits[i];
       }
     }
@@ -75,13 +103,101 @@ namespace bsim {
     	return *this;
       }
 
-      for (int i = 0; i < N; i++) {
-    	set(i, other.get(i));
+      for (int i = 0; i < NUM_STORAGE_BYTES(N); i++) {
+	bits[i] = other.bits[i];
       }
 
       return *this;
     }
 
+    // Copies as many low bytes of val as fit in the vector, bits past the
+    // end of the vector are cleared
+    template<typename NativeType>
+    inline void set_native(const NativeType val) {
+      const int n = sizeof(NativeType) < NUM_STORAGE_BYTES(N) ? sizeof(NativeType) : NUM_STORAGE_BYTES(N);
+      memcpy(bits, &val, n);
+      clear_tail();
+    }
+
+    template<typename NativeType>
+    inline NativeType get_native() const {
+      NativeType val = 0;
+      const int n = sizeof(NativeType) < NUM_STORAGE_BYTES(N) ? sizeof(NativeType) : NUM_STORAGE_BYTES(N);
+      memcpy(&val, bits, n);
+      return val;
+    }
+
+    // Mask of the bits of native_type that are part of the vector
+    static inline native_type native_mask() {
+      return (native_type) (~((bv_uint64) 0) >> (64 - (N > 64 ? 64 : N)));
+    }
+
+    // Only valid for vectors of 64 bits or less. Every instance of the
+    // vector keeps the bits past the end at zero, so the value read back
+    // needs no masking.
+    inline native_type as_native() const {
+      native_type val;
+      memcpy(&val, bits, sizeof(native_type));
+      return val;
+    }
+
+    static inline bit_vector<N> from_native(const native_type val) {
+      bit_vector<N> res;
+      native_type masked = val & native_mask();
+      memcpy(res.bits, &masked, sizeof(native_type));
+      return res;
+    }
+
+#ifdef BV_HAS_UINT128
+    // Only valid for vectors of 128 bits or less
+    inline bv_uint128 as_wide() const {
+      return get_native<bv_uint128>();
+    }
+
+    static inline bit_vector<N> from_wide(const bv_uint128 val) {
+      bit_vector<N> res;
+      res.set_native(val);
+      return res;
+    }
+#endif
+
+    inline void clear_tail() {
+      for (int i = N / 8; i < NUM_STORAGE_BYTES(N); i++) {
+        int live = N - 8*i;
+        bits[i] &= (live > 0) ? ((1 << live) - 1) : 0;
+      }
+    }
+
+    static inline int bitLength() {
+      return N;
+    }
+
+    static inline int num_words() {
+      return NUM_WORDS(N);
+    }
+
+    inline bv_uint64 get_word(const int i) const {
+      if (N <= 64) {
+        return get_native<bv_uint64>();
+      }
+
+      bv_uint64 w;
+      memcpy(&w, bits + 8*i, sizeof(bv_uint64));
+      return w;
+    }
+
+    // Note: Callers writing the top word of a vector wider than 64 bits
+    // are responsible for keeping the bits past the end of the vector at
+    // zero, see clear_tail
+    inline void set_word(const int i, const bv_uint64 w) {
+      if (N <= 64) {
+        set_native(w);
+        return;
+      }
+
+      memcpy(bits + 8*i, &w, sizeof(bv_uint64));
+    }
+
     inline void set(const int ind, const unsigned char val) {
       int byte_num = ind / 8;
       int bit_num = ind % 8;
@@ -102,56 +218,131 @@ namespace bsim {
     }
 
     inline bool equals(const bit_vector<N>& other) const {
+      return memcmp(bits, other.bits, NUM_STORAGE_BYTES(N)) == 0;
+    }
 
-      for (int i = 0; i < N; i++) {
-	if (get(i) != other.get(i)) {
-	  return false;
-	}
-      }
+    // The little endian storage bytes, for bit_span views
+    inline const unsigned char* byte_data() const {
+      return bits;
+    }
 
-      return true;
+    inline unsigned char* byte_data() {
+      return bits;
     }
 
     template<typename ConvType>
     ConvType to_type() const {
-      return *((ConvType*) (&bits));
+      return get_native<ConvType>();
     }
 
     inline bv_uint64 as_native_int32() const {
-      return *((bv_sint32*) (&bits));
+      return get_native<bv_sint32>();
     }
     
     inline bv_uint64 as_native_uint64() const {
-      return *((bv_uint64*) (&bits));
+      return get_native<bv_uint64>();
     }
 
     inline bv_uint32 as_native_uint32() const {
-      return *((bv_uint32*) (&bits));
+      return get_native<bv_uint32>();
     }
 
     inline bv_uint16 as_native_uint16() const {
-      return *((bv_uint16*) (&bits));
+      return get_native<bv_uint16>();
     }
 
     inline bv_uint8 as_native_uint8() const {
-      return *((bv_uint8*) (&bits));
+      return get_native<bv_uint8>();
+    }
+
+    // The N binary digits, most significant first, into out, which is
+    // not null terminated. Returns the end of the output.
+    inline char* format_to(char* out) const {
+      bv_uint64 limbs[NUM_WORDS(N)];
+      for (int i = 0; i < NUM_WORDS(N); i++) {
+        limbs[i] = get_word(i);
+      }
+      return format_binary_limbs(out, limbs, nullptr, 0, N);
+    }
+
+    // The hex literal, as in 12'hfff, into hex_format_length(N)
+    // characters of out
+    inline char* format_hex_to(char* out) const {
+      bv_uint64 limbs[NUM_WORDS(N)];
+      for (int i = 0; i < NUM_WORDS(N); i++) {
+        limbs[i] = get_word(i);
+      }
+      return format_hex_limbs(format_width_prefix(out, N, 'h'), limbs, nullptr, N);
+    }
+
+    // The unsigned value in decimal, into at most
+    // decimal_format_length(N) characters of out
+    inline char* format_decimal_to(char* out) const {
+      bv_uint64 limbs[NUM_WORDS(N)];
+      for (int i = 0; i < NUM_WORDS(N); i++) {
+        limbs[i] = get_word(i);
+      }
+      return format_decimal_limbs(out, limbs, NUM_WORDS(N));
+    }
+
+    std::string to_decimal_string() const {
+      std::string str(decimal_format_length(N), '0');
+      str.resize(format_decimal_to(&str[0]) - &str[0]);
+      return str;
+    }
+
+    // Binary records, see bit_serialization.h
+    inline size_t serialized_size() const {
+      return serialized_record_size(N, false);
+    }
+
+    // Writes serialized_size() bytes to out and returns their end
+    inline unsigned char* serialize_to(unsigned char* out) const {
+      bv_uint64 limbs[NUM_WORDS(N)];
+      for (int i = 0; i < NUM_WORDS(N); i++) {
+        limbs[i] = get_word(i);
+      }
+      return write_serial_record(out, N, limbs, nullptr);
+    }
+
+    inline void serialize_to(std::vector<unsigned char>& buffer) const {
+      const size_t start = buffer.size();
+      buffer.resize(start + serialized_size());
+      serialize_to(&buffer[start]);
+    }
+
+    // Reads the record at the front of in and consumes it. Fails, leaving
+    // both unchanged, unless the record is complete, is N bits wide and
+    // has no x/z plane.
+    inline bool deserialize_from(byte_span& in) {
+      int width;
+      bool has_unknown;
+      if (!read_serial_header(in, &width, &has_unknown) ||
+          (width != N) ||
+          has_unknown) {
+        return false;
+      }
+
+      bv_uint64 limbs[NUM_WORDS(N)];
+      read_serial_limbs(limbs, in.data + BV_SERIAL_HEADER_BYTES, NUM_WORDS(N));
+      for (int i = 0; i < NUM_WORDS(N); i++) {
+        set_word(i, limbs[i]);
+      }
+      clear_tail();
+
+      in.advance(serialized_size());
+      return true;
     }
     
   };
 
   template<int N>
   static inline std::ostream& operator<<(std::ostream& out, const bit_vector<N>& a) {
-    for (int i = N - 1; i >= 0; i--) {
-      if (a.get(i) == 0) {
-	out << "0";
-      } else if (a.get(i) == 1) {
-	out << "1";
-      } else {
-	assert(false);
-      }
+    bv_uint64 limbs[NUM_WORDS(N)];
+    for (int i = 0; i < NUM_WORDS(N); i++) {
+      limbs[i] = a.get_word(i);
     }
-
-    return out;
+    return write_binary_limbs(out, limbs, nullptr, N);
   }
 
   template<int N>
@@ -160,6 +351,74 @@ namespace bsim {
     return a.equals(b);
   }
 
+  // In place updates of a, a limb at a time. These back the compound
+  // assignment operators, so a register update builds no temporary.
+  template<int N>
+  static inline void add_in_place(bit_vector<N>& a, const bit_vector<N>& b) {
+    bv_uint64 carry = 0;
+    for (int i = 0; i < bit_vector<N>::num_words(); i++) {
+      bv_uint64 sum;
+      carry = add_with_carry(a.get_word(i), b.get_word(i), carry, &sum);
+      a.set_word(i, sum);
+    }
+    a.clear_tail();
+  }
+
+  template<int N>
+  static inline void sub_in_place(bit_vector<N>& a, const bit_vector<N>& b) {
+    bv_uint64 borrow = 0;
+    for (int i = 0; i < bit_vector<N>::num_words(); i++) {
+      bv_uint64 diff;
+      borrow = sub_with_borrow(a.get_word(i), b.get_word(i), borrow, &diff);
+      a.set_word(i, diff);
+    }
+    a.clear_tail();
+  }
+
+  template<int N>
+  static inline void shift_left_in_place(bit_vector<N>& a, const int shift) {
+    assert(shift >= 0);
+
+    bv_uint64 words[NUM_WORDS(N)];
+    for (int i = 0; i < bit_vector<N>::num_words(); i++) {
+      words[i] = a.get_word(i);
+    }
+
+    shift_left_limbs(words, words, NUM_WORDS(N), shift);
+
+    for (int i = 0; i < bit_vector<N>::num_words(); i++) {
+      a.set_word(i, words[i]);
+    }
+    a.clear_tail();
+  }
+
+  // Logical shift unless arithmetic is set, in which case the sign bit
+  // is copied into the vacated high bits
+  template<int N>
+  static inline void shift_right_in_place(bit_vector<N>& a,
+                                          const int shift,
+                                          const bool arithmetic) {
+    assert(shift >= 0);
+
+    bv_uint64 words[NUM_WORDS(N)];
+    for (int i = 0; i < bit_vector<N>::num_words(); i++) {
+      words[i] = a.get_word(i);
+    }
+
+    const bool negative = arithmetic && (a.get(N - 1) == 1);
+    if (negative) {
+      words[NUM_WORDS(N) - 1] |= ~top_word_mask(N);
+    }
+
+    shift_right_limbs(words, words, NUM_WORDS(N), shift,
+                      negative ? ~((bv_uint64) 0) : 0);
+
+    for (int i = 0; i < bit_vector<N>::num_words(); i++) {
+      a.set_word(i, words[i]);
+    }
+    a.clear_tail();
+  }
+
   template<int N>
   class unsigned_int {
   protected:
@@ -189,6 +448,10 @@ namespace bsim {
       return (this->bits).equals((other.bits));
     }
 
+    inline typename bit_vector<N>::native_type as_native() const {
+      return bits.as_native();
+    }
+
     inline bv_uint64 as_native_uint64() const {
       return bits.as_native_uint64();
     }
@@ -205,6 +468,26 @@ namespace bsim {
       return bits.as_native_uint8();
     }
     
+    inline unsigned_int<N>& operator+=(const unsigned_int<N>& b) {
+      add_in_place(bits, b.bits);
+      return *this;
+    }
+
+    inline unsigned_int<N>& operator-=(const unsigned_int<N>& b) {
+      sub_in_place(bits, b.bits);
+      return *this;
+    }
+
+    inline unsigned_int<N>& operator<<=(const int shift) {
+      shift_left_in_place(bits, shift);
+      return *this;
+    }
+
+    inline unsigned_int<N>& operator>>=(const int shift) {
+      shift_right_in_place(bits, shift, false);
+      return *this;
+    }
+
     inline std::ostream& print(std::ostream& out) const {
       out << bits << "U";
       return out;
@@ -223,7 +506,14 @@ namespace bsim {
 
     signed_int(const bit_vector<N>& bits_) : bits(bits_) {}
 
-    signed_int(const int val) : bits(val) {}
+    signed_int(const int val) : bits(val) {
+      // Sign extend values into vectors wider than an int
+      if (val < 0) {
+	for (int i = 32; i < N; i++) {
+	  bits.set(i, 1);
+	}
+      }
+    }
 
     signed_int(const std::string& bitstr) : bits(bitstr) {}
 
@@ -244,6 +534,16 @@ namespace bsim {
       return (this->bits).equals((other.bits));
     }
 
+    inline typename bit_vector<N>::native_type as_native() const {
+      return bits.as_native();
+    }
+
+    // Sign extended value, only meaningful for N <= 64
+    inline bv_sint64 as_native_sint64() const {
+      bv_uint64 sign_bit = ((bv_uint64) 1) << ((N < 64 ? N : 64) - 1);
+      return (bv_sint64) ((((bv_uint64) bits.as_native()) ^ sign_bit) - sign_bit);
+    }
+
     template<int HighWidth>
     signed_int<HighWidth> sign_extend() const {
       signed_int<HighWidth> hw;
@@ -301,6 +601,26 @@ namespace bsim {
       return bits.as_native_uint8();
     }
     
+    inline signed_int<N>& operator+=(const signed_int<N>& b) {
+      add_in_place(bits, b.bits);
+      return *this;
+    }
+
+    inline signed_int<N>& operator-=(const signed_int<N>& b) {
+      sub_in_place(bits, b.bits);
+      return *this;
+    }
+
+    inline signed_int<N>& operator<<=(const int shift) {
+      shift_left_in_place(bits, shift);
+      return *this;
+    }
+
+    inline signed_int<N>& operator>>=(const int shift) {
+      shift_right_in_place(bits, shift, true);
+      return *this;
+    }
+
     inline std::ostream& print(std::ostream& out) const {
       out << bits << "S";
       return out;
@@ -308,6 +628,7 @@ namespace bsim {
     
   };
 
+  // Limb at a time add with carry
   template<int Width>
   static inline
   bit_vector<Width>
@@ -315,166 +636,521 @@ namespace bsim {
 		       const bit_vector<Width>& b) {
 
     bit_vector<Width> res;
-    unsigned char carry = 0;
-    for (int i = 0; i < Width; i++) {
-      unsigned char sum = a.get(i) + b.get(i) + carry;
-
-      carry = 0;
+    bv_uint64 carry = 0;
+    for (int i = 0; i < bit_vector<Width>::num_words(); i++) {
+      bv_uint64 sum;
+      carry = add_with_carry(a.get_word(i), b.get_word(i), carry, &sum);
+      res.set_word(i, sum);
+    }
+    res.clear_tail();
 
-      unsigned char z_i = sum & 0x01; //sum % 2;
-      res.set(i, z_i);
-      if (sum >= 2) {
-	carry = 1;
-      }
+    return res;
+  }
 
+  template<int Width>
+  static inline void
+  bit_vector_to_words(const bit_vector<Width>& a, bv_uint64* words) {
+    for (int i = 0; i < bit_vector<Width>::num_words(); i++) {
+      words[i] = a.get_word(i);
     }
+  }
 
+  template<int Width>
+  static inline bit_vector<Width>
+  bit_vector_from_words(const bv_uint64* words) {
+    bit_vector<Width> res;
+    for (int i = 0; i < bit_vector<Width>::num_words(); i++) {
+      res.set_word(i, words[i]);
+    }
+    res.clear_tail();
     return res;
   }
 
+  // Schoolbook multiplication of the limbs, switching to Karatsuba for
+  // very wide operands. The product is truncated to Width bits.
   template<int Width>  
   static inline
   bit_vector<Width>
   mul_general_width_bv(const bit_vector<Width>& a,
 		       const bit_vector<Width>& b) {
-    bit_vector<2*Width> full_len;
-
-    for (int i = 0; i < Width; i++) {
-      if (b.get(i) == 1) {
-
-	bit_vector<2*Width> shifted_a;
-
-	for (int j = 0; j < Width; j++) {
-	  shifted_a.set(j + i, a.get(j));
-	}
+    bv_uint64 a_words[NUM_WORDS(Width)];
+    bv_uint64 b_words[NUM_WORDS(Width)];
+    bit_vector_to_words(a, a_words);
+    bit_vector_to_words(b, b_words);
 
-	full_len =
-	  add_general_width_bv(full_len, shifted_a);
-      }
-    }
+    bv_uint64 prod[NUM_WORDS(Width)];
+    mul_limbs_low(prod, a_words, b_words, NUM_WORDS(Width));
 
-    bit_vector<Width> res;
-    for (int i = 0; i < Width; i++) {
-      res.set(i, full_len.get(i));
-    }
-    return res;
+    return bit_vector_from_words<Width>(prod);
   }    
 
+  // Limb at a time subtract with borrow
   template<int Width>
   static inline
   bit_vector<Width>
   sub_general_width_bv(const bit_vector<Width>& a,
 		       const bit_vector<Width>& b) {
-    bit_vector<Width> diff;
-    bit_vector<Width> a_cpy = a;
-
-    for (int i = 0; i < Width; i++) {
-
-      if ((a_cpy.get(i) == 0) &&
-	  (b.get(i) == 1)) {
 
-	int j = i + 1;
-
-	diff.set(i, 1);	  
-
-	// Modify to carry
-	while ((j < Width) && (a_cpy.get(j) != 1)) {
-	  a_cpy.set(j, 1);
-	  j++;
-	}
-
-	if (j >= Width) {
-	} else {
-	  a_cpy.set(j, 0);
-	}
-
-      } else if (a_cpy.get(i) == b.get(i)) {
-	diff.set(i, 0);
-      } else if ((a_cpy.get(i) == 1) &&
-		 (b.get(i) == 0)) {
-	diff.set(i, 1);
-      } else {
-	assert(false);
-      }
+    bit_vector<Width> diff;
+    bv_uint64 borrow = 0;
+    for (int i = 0; i < bit_vector<Width>::num_words(); i++) {
+      bv_uint64 d;
+      borrow = sub_with_borrow(a.get_word(i), b.get_word(i), borrow, &d);
+      diff.set_word(i, d);
     }
+    diff.clear_tail();
 
     return diff;
   }    
-  
+
   template<int Width>
-  class signed_int_operations {
+  class bit_vector_operations {
   public:
 
+    template<int Q = Width>
     static inline
-    signed_int<Width>
-    add_general_width(const signed_int<Width>& a,
-		      const signed_int<Width>& b) {
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), bit_vector<Q> >::type
+    land(const bit_vector<Width>& a,
+	 const bit_vector<Width>& b) {
+      bit_vector<Width> a_and_b;
+      for (int i = 0; i < Width; i++) {
+	a_and_b.set(i, a.get(i) & b.get(i));
+      }
+      return a_and_b;
 
-      bit_vector<Width> bits =
-	add_general_width_bv(a.get_bits(), b.get_bits());
+    }
 
-      signed_int<Width> c(bits);
-      return c;
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= 64, bit_vector<Q> >::type
+    land(const bit_vector<Width>& a,
+	 const bit_vector<Width>& b) {
+      return bit_vector<Width>::from_native(a.as_native() & b.as_native());
     }
 
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
     static inline
-    signed_int<Width>
-    mul_general_width(const signed_int<Width>& a,
-		      const signed_int<Width>& b) {
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), bit_vector<Q> >::type
+    land(const bit_vector<Width>& a,
+	 const bit_vector<Width>& b) {
+      return bit_vector<Width>::from_wide(a.as_wide() & b.as_wide());
+    }
+#endif
 
-      bit_vector<Width> bits =
-	mul_general_width_bv(a.get_bits(), b.get_bits());
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), bit_vector<Q> >::type
+    lnot(const bit_vector<Width>& a) {
+      bit_vector<Width> not_a;
+      for (int i = 0; i < Width; i++) {
+	not_a.set(i, ~a.get(i));
+      }
+      return not_a;
 
-      signed_int<Width> c(bits);
-      return c;
     }
 
+    template<int Q = Width>
     static inline
-    signed_int<Width>
-    sub_general_width(const signed_int<Width>& a,
-		      const signed_int<Width>& b) {
-
-      bit_vector<Width> bits =
-	sub_general_width_bv(a.get_bits(), b.get_bits());
+    typename std::enable_if<Q <= 64, bit_vector<Q> >::type
+    lnot(const bit_vector<Width>& a) {
+      return bit_vector<Width>::from_native(~a.as_native());
+    }
 
-      signed_int<Width> c(bits);
-      return c;
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), bit_vector<Q> >::type
+    lnot(const bit_vector<Width>& a) {
+      return bit_vector<Width>::from_wide(~a.as_wide());
     }
-    
-  };  
+#endif
 
-  template<int Width>
-  class unsigned_int_operations {
-  public:
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), bit_vector<Q> >::type
+    lor(const bit_vector<Width>& a,
+	const bit_vector<Width>& b) {
+      bit_vector<Width> a_or_b;
+      for (int i = 0; i < Width; i++) {
+	a_or_b.set(i, a.get(i) | b.get(i));
+      }
+      return a_or_b;
 
+    }
 
     template<int Q = Width>
     static inline
-    //typename std::enable_if<Q >= 65, unsigned_int<Q> >::type
-    unsigned_int<Q>
-    sub(const unsigned_int<Width>& a,
-	const unsigned_int<Width>& b) {
-      return sub_general_width(a, b);
+    typename std::enable_if<Q <= 64, bit_vector<Q> >::type
+    lor(const bit_vector<Width>& a,
+	const bit_vector<Width>& b) {
+      return bit_vector<Width>::from_native(a.as_native() | b.as_native());
     }
 
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
     static inline
-    unsigned_int<Width>
-    mul_general_width(const unsigned_int<Width>& a,
-		      const unsigned_int<Width>& b) {
-      bit_vector<Width> bits =
-	mul_general_width_bv(a.get_bits(), b.get_bits());
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), bit_vector<Q> >::type
+    lor(const bit_vector<Width>& a,
+	const bit_vector<Width>& b) {
+      return bit_vector<Width>::from_wide(a.as_wide() | b.as_wide());
+    }
+#endif
 
-      unsigned_int<Width> c(bits);
-      return c;
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), bit_vector<Q> >::type
+    lxor(const bit_vector<Width>& a,
+	 const bit_vector<Width>& b) {
+      bit_vector<Width> a_or_b;
+      for (int i = 0; i < Width; i++) {
+	a_or_b.set(i, a.get(i) ^ b.get(i));
+      }
+      return a_or_b;
 
-    }    
+    }
 
+    template<int Q = Width>
     static inline
-    unsigned_int<Width>
-    sub_general_width(const unsigned_int<Width>& a,
-		      const unsigned_int<Width>& b) {
-      bit_vector<Width> bits =
-	sub_general_width_bv(a.get_bits(), b.get_bits());
+    typename std::enable_if<Q <= 64, bit_vector<Q> >::type
+    lxor(const bit_vector<Width>& a,
+	 const bit_vector<Width>& b) {
+      return bit_vector<Width>::from_native(a.as_native() ^ b.as_native());
+    }
+
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), bit_vector<Q> >::type
+    lxor(const bit_vector<Width>& a,
+	 const bit_vector<Width>& b) {
+      return bit_vector<Width>::from_wide(a.as_wide() ^ b.as_wide());
+    }
+#endif
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), bit_vector<Q> >::type
+    left_shift(const bit_vector<Width>& a,
+	       const int shift_val) {
+      bit_vector<Width> res;
+      for (int i = shift_val; i < Width; i++) {
+	res.set(i, a.get(i - shift_val));
+      }
+
+      return res;
+    }
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= 64, bit_vector<Q> >::type
+    left_shift(const bit_vector<Width>& a,
+	       const int shift_val) {
+      if (shift_val >= Width) {
+	return bit_vector<Width>();
+      }
+      bv_uint64 shifted = ((bv_uint64) a.as_native()) << shift_val;
+      return bit_vector<Width>::from_native(shifted);
+    }
+
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), bit_vector<Q> >::type
+    left_shift(const bit_vector<Width>& a,
+	       const int shift_val) {
+      if (shift_val >= Width) {
+	return bit_vector<Width>();
+      }
+      return bit_vector<Width>::from_wide(a.as_wide() << shift_val);
+    }
+#endif
+
+    // Index of the highest set bit, or -1 if no bit is set
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), int>::type
+    top_bit_position(const bit_vector<Width>& a) {
+      bv_uint64 words[NUM_WORDS(Width)];
+      bit_vector_to_words(a, words);
+      return find_last_set_limbs(words, NUM_WORDS(Width));
+    }
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= 64, int>::type
+    top_bit_position(const bit_vector<Width>& a) {
+      bv_uint64 val = a.as_native();
+      if (val == 0) {
+	return -1;
+      }
+      return (BV_WORD_BITS - 1) - count_leading_zeros_word(val);
+    }
+
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), int>::type
+    top_bit_position(const bit_vector<Width>& a) {
+      return top_bit_position_wide(a.as_wide());
+    }
+#endif
+
+    // Compares the bits of a and b as unsigned numbers
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), bool>::type
+    unsigned_gt(const bit_vector<Width>& a,
+		const bit_vector<Width>& b) {
+      for (int i = Width - 1; i >= 0; i--) {
+	if (a.get(i) > b.get(i)) {
+	  return true;
+	}
+
+	if (a.get(i) < b.get(i)) {
+	  return false;
+	}
+      }
+
+      return false;
+    }
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= 64, bool>::type
+    unsigned_gt(const bit_vector<Width>& a,
+		const bit_vector<Width>& b) {
+      return a.as_native() > b.as_native();
+    }
+
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), bool>::type
+    unsigned_gt(const bit_vector<Width>& a,
+		const bit_vector<Width>& b) {
+      return a.as_wide() > b.as_wide();
+    }
+#endif
+
+    // Compares the bits of a and b as two's complement numbers
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), bool>::type
+    signed_gt(const bit_vector<Width>& a,
+	      const bit_vector<Width>& b) {
+      // a negative b non-negative
+      if ((a.get(Width - 1) == 1) && (b.get(Width - 1) == 0)) {
+	return false;
+      }
+
+      // b negative a non-negative
+      if ((b.get(Width - 1) == 1) && (a.get(Width - 1) == 0)) {
+	return true;
+      }
+
+      // Both negative or both non-negative
+      return unsigned_gt(a, b);
+    }
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= 64, bool>::type
+    signed_gt(const bit_vector<Width>& a,
+	      const bit_vector<Width>& b) {
+      // Flipping the sign bits turns the signed order into the
+      // unsigned order
+      typename bit_vector<Width>::native_type sign_bit =
+	((bv_uint64) 1) << (Width - 1);
+      return (a.as_native() ^ sign_bit) > (b.as_native() ^ sign_bit);
+    }
+
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), bool>::type
+    signed_gt(const bit_vector<Width>& a,
+	      const bit_vector<Width>& b) {
+      bv_uint128 sign_bit = ((bv_uint128) 1) << (Width - 1);
+      return (a.as_wide() ^ sign_bit) > (b.as_wide() ^ sign_bit);
+    }
+#endif
+
+    static inline void land_in_place(bit_vector<Width>& a,
+                                     const bit_vector<Width>& b) {
+      for (int i = 0; i < bit_vector<Width>::num_words(); i++) {
+        a.set_word(i, a.get_word(i) & b.get_word(i));
+      }
+    }
+
+    static inline void lor_in_place(bit_vector<Width>& a,
+                                    const bit_vector<Width>& b) {
+      for (int i = 0; i < bit_vector<Width>::num_words(); i++) {
+        a.set_word(i, a.get_word(i) | b.get_word(i));
+      }
+    }
+
+    static inline void lxor_in_place(bit_vector<Width>& a,
+                                     const bit_vector<Width>& b) {
+      for (int i = 0; i < bit_vector<Width>::num_words(); i++) {
+        a.set_word(i, a.get_word(i) ^ b.get_word(i));
+      }
+    }
+
+  };
+
+  template<int N>
+  static inline int top_bit_position(const bit_vector<N>& a) {
+    return bit_vector_operations<N>::top_bit_position(a);
+  }
+
+  template<int N>
+  static inline bit_vector<N>
+  left_shift(const bit_vector<N>& a,
+	     const int shift_val) {
+    return bit_vector_operations<N>::left_shift(a, shift_val);
+  }
+
+  // Views of bits [start, end) of a, see bit_span.h
+  template<int N>
+  static inline bit_span span(bit_vector<N>& a,
+                              const int start,
+                              const int end) {
+    assert((0 <= start) && (start <= end) && (end <= N));
+    return bit_span(a.byte_data(), NUM_STORAGE_BYTES(N), start, end - start);
+  }
+
+  template<int N>
+  static inline bit_span span(bit_vector<N>& a) {
+    return span(a, 0, N);
+  }
+
+  template<int N>
+  static inline const_bit_span const_span(const bit_vector<N>& a,
+                                          const int start,
+                                          const int end) {
+    assert((0 <= start) && (start <= end) && (end <= N));
+    return const_bit_span(a.byte_data(), NUM_STORAGE_BYTES(N), start, end - start);
+  }
+
+  template<int N>
+  static inline const_bit_span const_span(const bit_vector<N>& a) {
+    return const_span(a, 0, N);
+  }
+
+  template<int N>
+  static inline int popcount(const bit_vector<N>& a) {
+    int count = 0;
+    for (int i = 0; i < bit_vector<N>::num_words(); i++) {
+      count += popcount_word(a.get_word(i));
+    }
+    return count;
+  }
+
+  // Index of the lowest set bit at or above from, or -1 if there is none
+  template<int N>
+  static inline int find_next_set(const bit_vector<N>& a, const int from) {
+    bv_uint64 words[NUM_WORDS(N)];
+    bit_vector_to_words(a, words);
+    return find_next_set_limbs(words, NUM_WORDS(N), from);
+  }
+
+  // Index of the lowest set bit, or -1 if no bit is set
+  template<int N>
+  static inline int find_first_set(const bit_vector<N>& a) {
+    return find_next_set(a, 0);
+  }
+
+  // Zeros above the highest set bit, N if no bit is set
+  template<int N>
+  static inline int count_leading_zeros(const bit_vector<N>& a) {
+    return N - 1 - top_bit_position(a);
+  }
+
+  // Zeros below the lowest set bit, N if no bit is set
+  template<int N>
+  static inline int count_trailing_zeros(const bit_vector<N>& a) {
+    int first = find_first_set(a);
+    return first < 0 ? N : first;
+  }
+
+  template<int Width>
+  class unsigned_int_operations {
+  public:
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), unsigned_int<Q> >::type
+    sub(const unsigned_int<Width>& a,
+	const unsigned_int<Width>& b) {
+      return sub_general_width(a, b);
+    }
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= 64, unsigned_int<Q> >::type
+    sub(const unsigned_int<Width>& a,
+	const unsigned_int<Width>& b) {
+      return bit_vector<Width>::from_native(a.as_native() - b.as_native());
+    }
+
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), unsigned_int<Q> >::type
+    sub(const unsigned_int<Width>& a,
+	const unsigned_int<Width>& b) {
+      return bit_vector<Width>::from_wide(a.get_bits().as_wide() - b.get_bits().as_wide());
+    }
+#endif
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), unsigned_int<Q> >::type
+    mul(const unsigned_int<Width>& a,
+	const unsigned_int<Width>& b) {
+      return mul_general_width(a, b);
+    }
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= 64, unsigned_int<Q> >::type
+    mul(const unsigned_int<Width>& a,
+	const unsigned_int<Width>& b) {
+      // Multiply in 64 bits so that narrow operands are not promoted to
+      // (signed) int
+      bv_uint64 res = ((bv_uint64) a.as_native()) * ((bv_uint64) b.as_native());
+      return bit_vector<Width>::from_native(res);
+    }
+
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), unsigned_int<Q> >::type
+    mul(const unsigned_int<Width>& a,
+	const unsigned_int<Width>& b) {
+      return bit_vector<Width>::from_wide(a.get_bits().as_wide() * b.get_bits().as_wide());
+    }
+#endif
+
+    static inline
+    unsigned_int<Width>
+    mul_general_width(const unsigned_int<Width>& a,
+		      const unsigned_int<Width>& b) {
+      bit_vector<Width> bits =
+	mul_general_width_bv(a.get_bits(), b.get_bits());
+
+      unsigned_int<Width> c(bits);
+      return c;
+
+    }    
+
+    static inline
+    unsigned_int<Width>
+    sub_general_width(const unsigned_int<Width>& a,
+		      const unsigned_int<Width>& b) {
+      bit_vector<Width> bits =
+	sub_general_width_bv(a.get_bits(), b.get_bits());
 
       unsigned_int<Width> c(bits);
       return c;
@@ -510,7 +1186,7 @@ namespace bsim {
 
     template<int Q = Width>
     static inline
-    typename std::enable_if<Q >= 65, unsigned_int<Q> >::type
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), unsigned_int<Q> >::type
     add(const unsigned_int<Width>& a,
 	const unsigned_int<Width>& b) {
       return add_general_width(a, b);
@@ -518,168 +1194,474 @@ namespace bsim {
 
     template<int Q = Width>
     static inline
-    typename std::enable_if<(33 <= Q) && (Q <= 64), unsigned_int<Q> >::type
+    typename std::enable_if<Q <= 64, unsigned_int<Q> >::type
     add(const unsigned_int<Width>& a,
 	const unsigned_int<Width>& b) {
-
-      //std::cout << "a = " << a.as_native_uint64() << std::endl;
-      //std::cout << "b = " << b.as_native_uint64() << std::endl;
-      bv_uint64 res = a.as_native_uint64() + b.as_native_uint64();
-
-      return unsigned_int<Width>(res);
+      return bit_vector<Width>::from_native(a.as_native() + b.as_native());
     }
 
+#ifdef BV_HAS_UINT128
     template<int Q = Width>
     static inline
-    typename std::enable_if<(17 <= Q) && (Q <= 32), unsigned_int<Q> >::type
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), unsigned_int<Q> >::type
     add(const unsigned_int<Width>& a,
 	const unsigned_int<Width>& b) {
+      return bit_vector<Width>::from_wide(a.get_bits().as_wide() + b.get_bits().as_wide());
+    }
+#endif
+
+    // Limb long division computing the quotient and the remainder
+    // together
+    static inline
+    void
+    div_rem_general_width(const unsigned_int<Width>& a,
+			  const unsigned_int<Width>& b,
+			  unsigned_int<Width>& quotient,
+			  unsigned_int<Width>& remainder) {
+      bv_uint64 a_words[NUM_WORDS(Width)];
+      bv_uint64 b_words[NUM_WORDS(Width)];
+      bit_vector_to_words(a.get_bits(), a_words);
+      bit_vector_to_words(b.get_bits(), b_words);
 
-      //std::cout << "a 32 bit = " << a.as_native_uint32() << std::endl;
-      //std::cout << "b 32 bit = " << b.as_native_uint32() << std::endl;
-      bv_uint32 res = a.as_native_uint32() + b.as_native_uint32();
+      bv_uint64 q_words[NUM_WORDS(Width)];
+      bv_uint64 r_words[NUM_WORDS(Width)];
+      div_rem_limbs(q_words, r_words, a_words, b_words, NUM_WORDS(Width));
 
-      return unsigned_int<Width>(res);
+      quotient = bit_vector_from_words<Width>(q_words);
+      remainder = bit_vector_from_words<Width>(r_words);
     }
-      
+
+    static inline
+    unsigned_int<Width>
+    div_general_width(const unsigned_int<Width>& a,
+		      const unsigned_int<Width>& b) {
+      unsigned_int<Width> quotient;
+      unsigned_int<Width> remainder;
+      div_rem_general_width(a, b, quotient, remainder);
+      return quotient;
+    }
+
+    static inline
+    unsigned_int<Width>
+    rem_general_width(const unsigned_int<Width>& a,
+		      const unsigned_int<Width>& b) {
+      unsigned_int<Width> quotient;
+      unsigned_int<Width> remainder;
+      div_rem_general_width(a, b, quotient, remainder);
+      return remainder;
+    }
+
     template<int Q = Width>
     static inline
-    typename std::enable_if<(9 <= Q) && (Q <= 16), unsigned_int<Q> >::type
-    add(const unsigned_int<Width>& a,
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), unsigned_int<Q> >::type
+    div(const unsigned_int<Width>& a,
 	const unsigned_int<Width>& b) {
+      return div_general_width(a, b);
+    }
 
-      //std::cout << "a 16 bit = " << a.as_native_uint16() << std::endl;
-      //std::cout << "b 16 bit = " << b.as_native_uint16() << std::endl;
-      bv_uint16 res = a.as_native_uint16() + b.as_native_uint16();
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= 64, unsigned_int<Q> >::type
+    div(const unsigned_int<Width>& a,
+	const unsigned_int<Width>& b) {
+      if (b.as_native() == 0) {
+	return bit_vector<Width>::from_native(bit_vector<Width>::native_mask());
+      }
+      return bit_vector<Width>::from_native(a.as_native() / b.as_native());
+    }
 
-      return unsigned_int<Width>(res);
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), unsigned_int<Q> >::type
+    div(const unsigned_int<Width>& a,
+	const unsigned_int<Width>& b) {
+      if (b.get_bits().as_wide() == 0) {
+	return bit_vector<Width>::from_wide(~((bv_uint128) 0));
+      }
+      return bit_vector<Width>::from_wide(a.get_bits().as_wide() / b.get_bits().as_wide());
     }
-      
+#endif
+
     template<int Q = Width>
     static inline
-    typename std::enable_if<(1 <= Q) && (Q <= 8), unsigned_int<Q> >::type
-    add(const unsigned_int<Width>& a,
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), unsigned_int<Q> >::type
+    rem(const unsigned_int<Width>& a,
 	const unsigned_int<Width>& b) {
+      return rem_general_width(a, b);
+    }
 
-      bv_uint8 res = +(a.as_native_uint8()) + +(b.as_native_uint8());
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= 64, unsigned_int<Q> >::type
+    rem(const unsigned_int<Width>& a,
+	const unsigned_int<Width>& b) {
+      if (b.as_native() == 0) {
+	return a;
+      }
+      return bit_vector<Width>::from_native(a.as_native() % b.as_native());
+    }
 
-      return unsigned_int<Width>(res);
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), unsigned_int<Q> >::type
+    rem(const unsigned_int<Width>& a,
+	const unsigned_int<Width>& b) {
+      if (b.get_bits().as_wide() == 0) {
+	return a;
+      }
+      return bit_vector<Width>::from_wide(a.get_bits().as_wide() % b.get_bits().as_wide());
     }
-      
-  };
+#endif
 
-  template<int N>
-  static inline unsigned_int<N> operator+(const unsigned_int<N>& a,
-					  const unsigned_int<N>& b) {
-    return unsigned_int_operations<N>::add(a, b);
-  }
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), void>::type
+    div_rem(const unsigned_int<Width>& a,
+	    const unsigned_int<Width>& b,
+	    unsigned_int<Width>& quotient,
+	    unsigned_int<Width>& remainder) {
+      div_rem_general_width(a, b, quotient, remainder);
+    }
 
-  template<int N>
-  static inline unsigned_int<N> operator-(const unsigned_int<N>& a,
-					  const unsigned_int<N>& b) {
-    return unsigned_int_operations<N>::sub(a, b);
-  }
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= BV_WIDE_NATIVE_BITS, void>::type
+    div_rem(const unsigned_int<Width>& a,
+	    const unsigned_int<Width>& b,
+	    unsigned_int<Width>& quotient,
+	    unsigned_int<Width>& remainder) {
+      quotient = div(a, b);
+      remainder = rem(a, b);
+    }
+
+  };
 
-  template<int N>
-  static inline signed_int<N> operator+(const signed_int<N>& a,
-					const signed_int<N>& b) {
-    return signed_int_operations<N>::add_general_width(a, b);
-  }
-  
-  template<int N>
-  static inline signed_int<N> operator-(const signed_int<N>& a,
-					const signed_int<N>& b) {
-    return signed_int_operations<N>::sub_general_width(a, b);
-  }
-  
   template<int Width>
-  class bit_vector_operations {
+  class signed_int_operations {
   public:
 
+    static inline
+    signed_int<Width>
+    add_general_width(const signed_int<Width>& a,
+		      const signed_int<Width>& b) {
+
+      bit_vector<Width> bits =
+	add_general_width_bv(a.get_bits(), b.get_bits());
+
+      signed_int<Width> c(bits);
+      return c;
+    }
+
+    static inline
+    signed_int<Width>
+    mul_general_width(const signed_int<Width>& a,
+		      const signed_int<Width>& b) {
+
+      bit_vector<Width> bits =
+	mul_general_width_bv(a.get_bits(), b.get_bits());
+
+      signed_int<Width> c(bits);
+      return c;
+    }
+
+    static inline
+    signed_int<Width>
+    sub_general_width(const signed_int<Width>& a,
+		      const signed_int<Width>& b) {
+
+      bit_vector<Width> bits =
+	sub_general_width_bv(a.get_bits(), b.get_bits());
+
+      signed_int<Width> c(bits);
+      return c;
+    }
+
+    // Two's complement addition, subtraction and multiplication produce
+    // the same bits as their unsigned versions
     template<int Q = Width>
     static inline
-    typename std::enable_if<Q >= 65, bit_vector<Q> >::type
-    land(const bit_vector<Width>& a,
-	 const bit_vector<Width>& b) {
-      bit_vector<Width> a_and_b;
-      for (int i = 0; i < Width; i++) {
-	a_and_b.set(i, a.get(i) & b.get(i));
-      }
-      return a_and_b;
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), signed_int<Q> >::type
+    add(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      return add_general_width(a, b);
+    }
 
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= 64, signed_int<Q> >::type
+    add(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      return bit_vector<Width>::from_native(a.as_native() + b.as_native());
     }
 
+#ifdef BV_HAS_UINT128
     template<int Q = Width>
     static inline
-    typename std::enable_if<33 <= Q && Q <= 64, bit_vector<Q> >::type
-    land(const bit_vector<Width>& a,
-	 const bit_vector<Width>& b) {
-      bv_uint64 a_and_b = a.as_native_uint64() & b.as_native_uint64();
-      return bit_vector<Width>(a_and_b);
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), signed_int<Q> >::type
+    add(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      return bit_vector<Width>::from_wide(a.get_bits().as_wide() + b.get_bits().as_wide());
     }
-    
+#endif
+
     template<int Q = Width>
     static inline
-    typename std::enable_if<17 <= Q && Q <= 32, bit_vector<Q> >::type
-    land(const bit_vector<Width>& a,
-	 const bit_vector<Width>& b) {
-      bv_uint32 a_and_b = a.as_native_uint32() & b.as_native_uint32();
-      return bit_vector<Width>(a_and_b);
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), signed_int<Q> >::type
+    sub(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      return sub_general_width(a, b);
     }
-    
+
     template<int Q = Width>
     static inline
-    typename std::enable_if<9 <= Q && Q <= 16, bit_vector<Q> >::type
-    land(const bit_vector<Width>& a,
-	 const bit_vector<Width>& b) {
-      bv_uint16 a_and_b = a.as_native_uint16() & b.as_native_uint16();
-      return bit_vector<Width>(a_and_b);
+    typename std::enable_if<Q <= 64, signed_int<Q> >::type
+    sub(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      return bit_vector<Width>::from_native(a.as_native() - b.as_native());
     }
-    
+
+#ifdef BV_HAS_UINT128
     template<int Q = Width>
     static inline
-    typename std::enable_if<1 <= Q && Q <= 8, bit_vector<Q> >::type
-    land(const bit_vector<Width>& a,
-	 const bit_vector<Width>& b) {
-      bv_uint8 a_and_b = a.as_native_uint8() & b.as_native_uint8();
-      return bit_vector<Width>(a_and_b);
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), signed_int<Q> >::type
+    sub(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      return bit_vector<Width>::from_wide(a.get_bits().as_wide() - b.get_bits().as_wide());
+    }
+#endif
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), signed_int<Q> >::type
+    mul(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      return mul_general_width(a, b);
     }
 
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= 64, signed_int<Q> >::type
+    mul(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      bv_uint64 res = ((bv_uint64) a.as_native()) * ((bv_uint64) b.as_native());
+      return bit_vector<Width>::from_native(res);
+    }
 
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), signed_int<Q> >::type
+    mul(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      return bit_vector<Width>::from_wide(a.get_bits().as_wide() * b.get_bits().as_wide());
+    }
+#endif
 
-    static inline bit_vector<Width> lnot(const bit_vector<Width>& a) {
-      bit_vector<Width> not_a;
-      for (int i = 0; i < Width; i++) {
-	not_a.set(i, ~a.get(i));
+    // Division rounds towards zero and the remainder takes the sign of
+    // the dividend. The magnitudes are divided as unsigned numbers and
+    // the signs are fixed up afterwards.
+    static inline
+    void
+    div_rem_general_width(const signed_int<Width>& a,
+			  const signed_int<Width>& b,
+			  signed_int<Width>& quotient,
+			  signed_int<Width>& remainder) {
+      bv_uint64 a_words[NUM_WORDS(Width)];
+      bv_uint64 b_words[NUM_WORDS(Width)];
+      bit_vector_to_words(a.get_bits(), a_words);
+      bit_vector_to_words(b.get_bits(), b_words);
+
+      bv_uint64 q_words[NUM_WORDS(Width)];
+      bv_uint64 r_words[NUM_WORDS(Width)];
+      signed_div_rem_limbs(q_words, r_words, a_words, b_words, NUM_WORDS(Width), Width);
+
+      quotient = bit_vector_from_words<Width>(q_words);
+      remainder = bit_vector_from_words<Width>(r_words);
+    }
+
+    static inline
+    signed_int<Width>
+    div_general_width(const signed_int<Width>& a,
+		      const signed_int<Width>& b) {
+      signed_int<Width> quotient;
+      signed_int<Width> remainder;
+      div_rem_general_width(a, b, quotient, remainder);
+      return quotient;
+    }
+
+    static inline
+    signed_int<Width>
+    rem_general_width(const signed_int<Width>& a,
+		      const signed_int<Width>& b) {
+      signed_int<Width> quotient;
+      signed_int<Width> remainder;
+      div_rem_general_width(a, b, quotient, remainder);
+      return remainder;
+    }
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), signed_int<Q> >::type
+    div(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      return div_general_width(a, b);
+    }
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= 64, signed_int<Q> >::type
+    div(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      bv_sint64 an = a.as_native_sint64();
+      bv_sint64 bn = b.as_native_sint64();
+
+      if (bn == 0) {
+	return bit_vector<Width>::from_native(bit_vector<Width>::native_mask());
+      }
+
+      // The most negative number divided by -1 overflows, negating in
+      // unsigned arithmetic wraps the way the hardware does
+      if (bn == -1) {
+	return bit_vector<Width>::from_native(-((bv_uint64) an));
       }
-      return not_a;
 
+      return bit_vector<Width>::from_native((bv_uint64) (an / bn));
     }
-      
-    static inline bit_vector<Width> lor(const bit_vector<Width>& a,
-					const bit_vector<Width>& b) {
-      bit_vector<Width> a_or_b;
-      for (int i = 0; i < Width; i++) {
-	a_or_b.set(i, a.get(i) | b.get(i));
+
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), signed_int<Q> >::type
+    div(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      bv_uint128 sign_bit = ((bv_uint128) 1) << (Width - 1);
+      bv_uint128 an = (a.get_bits().as_wide() ^ sign_bit) - sign_bit;
+      bv_uint128 bn = (b.get_bits().as_wide() ^ sign_bit) - sign_bit;
+
+      if (bn == 0) {
+	return bit_vector<Width>::from_wide(~((bv_uint128) 0));
       }
-      return a_or_b;
 
+      // Divide the sign extended magnitudes and fix up the sign
+      bool a_neg = (an >> 127) != 0;
+      bool b_neg = (bn >> 127) != 0;
+      bv_uint128 q = (a_neg ? -an : an) / (b_neg ? -bn : bn);
+
+      return bit_vector<Width>::from_wide(a_neg != b_neg ? -q : q);
     }
+#endif
 
+    template<int Q = Width>
     static inline
-    bit_vector<Width>
-    lxor(const bit_vector<Width>& a,
-	 const bit_vector<Width>& b) {
-      bit_vector<Width> a_or_b;
-      for (int i = 0; i < Width; i++) {
-	a_or_b.set(i, a.get(i) ^ b.get(i));
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), signed_int<Q> >::type
+    rem(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      return rem_general_width(a, b);
+    }
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= 64, signed_int<Q> >::type
+    rem(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      bv_sint64 an = a.as_native_sint64();
+      bv_sint64 bn = b.as_native_sint64();
+
+      if (bn == 0) {
+	return a;
       }
-      return a_or_b;
 
+      // Avoids the overflow of the most negative number % -1
+      if (bn == -1) {
+	return signed_int<Width>();
+      }
+
+      return bit_vector<Width>::from_native((bv_uint64) (an % bn));
+    }
+
+#ifdef BV_HAS_UINT128
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > 64) && (Q <= BV_WIDE_NATIVE_BITS), signed_int<Q> >::type
+    rem(const signed_int<Width>& a,
+	const signed_int<Width>& b) {
+      bv_uint128 sign_bit = ((bv_uint128) 1) << (Width - 1);
+      bv_uint128 an = (a.get_bits().as_wide() ^ sign_bit) - sign_bit;
+      bv_uint128 bn = (b.get_bits().as_wide() ^ sign_bit) - sign_bit;
+
+      if (bn == 0) {
+	return a;
+      }
+
+      bool a_neg = (an >> 127) != 0;
+      bool b_neg = (bn >> 127) != 0;
+      bv_uint128 r = (a_neg ? -an : an) % (b_neg ? -bn : bn);
+
+      return bit_vector<Width>::from_wide(a_neg ? -r : r);
+    }
+#endif
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<(Q > BV_WIDE_NATIVE_BITS), void>::type
+    div_rem(const signed_int<Width>& a,
+	    const signed_int<Width>& b,
+	    signed_int<Width>& quotient,
+	    signed_int<Width>& remainder) {
+      div_rem_general_width(a, b, quotient, remainder);
+    }
+
+    template<int Q = Width>
+    static inline
+    typename std::enable_if<Q <= BV_WIDE_NATIVE_BITS, void>::type
+    div_rem(const signed_int<Width>& a,
+	    const signed_int<Width>& b,
+	    signed_int<Width>& quotient,
+	    signed_int<Width>& remainder) {
+      quotient = div(a, b);
+      remainder = rem(a, b);
     }
     
-  };
+  };  
+
+  template<int N>
+  static inline unsigned_int<N> operator+(const unsigned_int<N>& a,
+					  const unsigned_int<N>& b) {
+    return unsigned_int_operations<N>::add(a, b);
+  }
+
+  template<int N>
+  static inline unsigned_int<N> operator-(const unsigned_int<N>& a,
+					  const unsigned_int<N>& b) {
+    return unsigned_int_operations<N>::sub(a, b);
+  }
+
+  template<int N>
+  static inline unsigned_int<N> operator*(const unsigned_int<N>& a,
+					  const unsigned_int<N>& b) {
+    return unsigned_int_operations<N>::mul(a, b);
+  }
+
+  template<int N>
+  static inline signed_int<N> operator+(const signed_int<N>& a,
+					const signed_int<N>& b) {
+    return signed_int_operations<N>::add(a, b);
+  }
+  
+  template<int N>
+  static inline signed_int<N> operator-(const signed_int<N>& a,
+					const signed_int<N>& b) {
+    return signed_int_operations<N>::sub(a, b);
+  }
 
+  template<int N>
+  static inline signed_int<N> operator*(const signed_int<N>& a,
+					const signed_int<N>& b) {
+    return signed_int_operations<N>::mul(a, b);
+  }
+  
   template<int N>
   static inline bit_vector<N> operator~(const bit_vector<N>& a) {
     return bit_vector_operations<N>::lnot(a);
@@ -703,6 +1685,42 @@ namespace bsim {
     return bit_vector_operations<N>::lxor(a, b);
   }
 
+  template<int N>
+  static inline bit_vector<N>& operator&=(bit_vector<N>& a,
+					  const bit_vector<N>& b) {
+    bit_vector_operations<N>::land_in_place(a, b);
+    return a;
+  }
+
+  template<int N>
+  static inline bit_vector<N>& operator|=(bit_vector<N>& a,
+					  const bit_vector<N>& b) {
+    bit_vector_operations<N>::lor_in_place(a, b);
+    return a;
+  }
+
+  template<int N>
+  static inline bit_vector<N>& operator^=(bit_vector<N>& a,
+					  const bit_vector<N>& b) {
+    bit_vector_operations<N>::lxor_in_place(a, b);
+    return a;
+  }
+
+  template<int N>
+  static inline bit_vector<N>& operator<<=(bit_vector<N>& a,
+					   const int shift) {
+    shift_left_in_place(a, shift);
+    return a;
+  }
+
+  // Logical shift, bit vectors carry no sign
+  template<int N>
+  static inline bit_vector<N>& operator>>=(bit_vector<N>& a,
+					   const int shift) {
+    shift_right_in_place(a, shift, false);
+    return a;
+  }
+
   template<int N>
   static inline bool operator!=(const bit_vector<N>& a,
 				const bit_vector<N>& b) {
@@ -718,7 +1736,7 @@ namespace bsim {
   template<int N>
   static inline bool operator==(const signed_int<N>& a,
 				const signed_int<N>& b) {
-    return a.get_bits() == b.get_bits();
+    return a.equals(b);
   }
 
   template<int N>
@@ -730,25 +1748,13 @@ namespace bsim {
   template<int N>
   static inline bool operator>(const unsigned_int<N>& a,
 			       const unsigned_int<N>& b) {
-    for (int i = N - 1; i >= 0; i--) {
-      if (a.get(i) > b.get(i)) {
-	return true;
-      }
-
-      if (a.get(i) < b.get(i)) {
-	return false;
-      }
-    }
-
-    return false;
+    return bit_vector_operations<N>::unsigned_gt(a.get_bits(), b.get_bits());
   }
 
   template<int N>
   static inline bool operator<(const unsigned_int<N>& a,
 			       const unsigned_int<N>& b) {
-    if (a == b) { return false; }
-
-    return !(a > b);
+    return b > a;
   }
 
   template<int N>
@@ -760,116 +1766,52 @@ namespace bsim {
   template<int N>
   static inline bool operator>=(const unsigned_int<N>& a,
 				const unsigned_int<N>& b) {
-    return (a > b) || (a == b);
+    return !(b > a);
   }
 
+  // Division by zero is defined as in RISC-V rather than trapping like
+  // the native divide: the quotient is all ones and the remainder is the
+  // dividend, for signed and unsigned numbers of every width.
   template<int N>
-  static inline int top_bit_position(const bit_vector<N>& a) {
-    int top_pos = N;
-    while (top_pos >= 0) {
-      if (a.get(top_pos) == 1) {
-	return top_pos;
-      }
-      top_pos--;
-    }
-
-    return top_pos;
+  static inline unsigned_int<N> operator/(const unsigned_int<N>& a,
+					  const unsigned_int<N>& b) {
+    return unsigned_int_operations<N>::div(a, b);
   }
 
   template<int N>
-  static inline bit_vector<N>
-  left_shift(const bit_vector<N>& a,
-	     const int shift_val) {
-    bit_vector<N> res;
-    for (int i = shift_val; i < N; i++) {
-      res.set(i, a.get(i - shift_val));
-    }
-
-    return res;
-  }
+  static inline signed_int<N> operator/(const signed_int<N>& a,
+					const signed_int<N>& b) {
+    return signed_int_operations<N>::div(a, b);
+  }  
 
   template<int N>
-  static inline unsigned_int<N> operator/(const unsigned_int<N>& a,
+  static inline unsigned_int<N> operator%(const unsigned_int<N>& a,
 					  const unsigned_int<N>& b) {
-    unsigned_int<N> quotient;
-    unsigned_int<N> val = a;
-
-    while (b <= val) {
-      int a_high = top_bit_position(a.get_bits());
-      int b_high = top_bit_position(a.get_bits());
-
-      assert(a_high >= b_high);
-
-      int shift_amount = a_high - b_high;
-
-      bit_vector<N> shifted = left_shift(b.get_bits(), shift_amount);
-
-      val = val - unsigned_int<N>(shifted);
-      quotient = quotient + unsigned_int<N>(left_shift(bit_vector<N>(1), shift_amount));
-    }
-
-    return quotient;
+    return unsigned_int_operations<N>::rem(a, b);
   }
 
   template<int N>
-  static inline signed_int<N> operator/(const signed_int<N>& a,
+  static inline signed_int<N> operator%(const signed_int<N>& a,
 					const signed_int<N>& b) {
-
-    signed_int<N> quotient;
-    signed_int<N> val = a;
-
-    while (b <= val) {
-      int a_high = top_bit_position(a.get_bits());
-      int b_high = top_bit_position(a.get_bits());
-
-      assert(a_high >= b_high);
-
-      int shift_amount = a_high - b_high;
-
-      bit_vector<N> shifted = left_shift(b.get_bits(), shift_amount);
-
-      val = val - signed_int<N>(shifted);
-      quotient = quotient + signed_int<N>(left_shift(bit_vector<N>(1), shift_amount));
-    }
-
-    return quotient;
-  }  
+    return signed_int_operations<N>::rem(a, b);
+  }
 
   template<int N>
   static inline bool operator>(const signed_int<N>& a,
 			       const signed_int<N>& b) {
+    return bit_vector_operations<N>::signed_gt(a.get_bits(), b.get_bits());
+  }
 
-    // a negative b non-negative
-    if ((a.get(N - 1) == 1) && (b.get(N - 1) == 0)) {
-      return false;
-    }
-
-    // b negative a non-negative
-    if ((b.get(N - 1) == 1) && (a.get(N - 1) == 0)) {
-      return true;
-    }
-
-    // Both negative or both non-negative
-    //if ((a.get(N - 1) == 1) && (b.get(N - 1) == 1)) {
-
-    for (int i = N - 2; i >= 0; i--) {
-      if (a.get(i) > b.get(i)) {
-	return true;
-      }
-
-      if (a.get(i) < b.get(i)) {
-	return false;
-      }
-    }
-
-    return false;
-
+  template<int N>
+  static inline bool operator<(const signed_int<N>& a,
+			       const signed_int<N>& b) {
+    return b > a;
   }
 
   template<int N>
   static inline bool operator>=(const signed_int<N>& a,
 				const signed_int<N>& b) {
-    return (a > b) || (a == b);
+    return !(b > a);
   }
 
   template<int N>
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "limb_operations.h"
+
+// Bump allocation for the storage of short lived vectors. While an
+// arena_scope is active on a thread, every dynamic_bit_vector and
+// quad_value_bit_vector created on that thread takes its limbs from the
+// scope's arena. An allocation is a pointer bump and freeing is a no-op.
+// reset() then reclaims the whole arena at once, typically at the end of
+// every simulated cycle:
+//
+//   bit_vector_arena arena;
+//   while (running) {
+//     arena_scope scope(arena);
+//     ... evaluate the cycle, assigning results into registers ...
+//     arena.reset();
+//   }
+//
+// Vectors created inside a scope must not outlive the next reset. Moving
+// such a vector never hands its arena memory to a vector that may live
+// longer: move assigning it into one made outside the scope copies the
+// limbs, and move constructing from it while its arena is current, for
+// example by push_back of a temporary into a container, copies them to
+// the heap.
+
+namespace bsim {
+
+  class bit_vector_arena {
+    std::vector<bv_uint64*> blocks;
+    std::vector<bv_uint64*> large_blocks;
+    size_t block_words;
+    size_t current_block;
+    size_t used_words;
+
+    bit_vector_arena(const bit_vector_arena&);
+    bit_vector_arena& operator=(const bit_vector_arena&);
+
+  public:
+
+    explicit bit_vector_arena(const size_t block_bytes = 1 << 16) :
+      block_words((block_bytes + sizeof(bv_uint64) - 1) / sizeof(bv_uint64)),
+      current_block(0),
+      used_words(0) {}
+
+    ~bit_vector_arena() {
+      for (size_t i = 0; i < blocks.size(); i++) {
+        delete[] blocks[i];
+      }
+      for (size_t i = 0; i < large_blocks.size(); i++) {
+        delete[] large_blocks[i];
+      }
+    }
+
+    // Memory aligned for limbs. Requests bigger than a block get a block
+    // of their own.
+    void* allocate(const size_t bytes) {
+      const size_t words = (bytes + sizeof(bv_uint64) - 1) / sizeof(bv_uint64);
+
+      if (words > block_words) {
+        large_blocks.push_back(new bv_uint64[words]);
+        return large_blocks.back();
+      }
+
+      if ((current_block < blocks.size()) &&
+          (used_words + words > block_words)) {
+        current_block++;
+        used_words = 0;
+      }
+
+      if (current_block == blocks.size()) {
+        blocks.push_back(new bv_uint64[block_words]);
+      }
+
+      bv_uint64* p = blocks[current_block] + used_words;
+      used_words += words;
+      return p;
+    }
+
+    // Releases everything allocated so far. Blocks are kept for reuse,
+    // oversized ones are freed.
+    void reset() {
+      for (size_t i = 0; i < large_blocks.size(); i++) {
+        delete[] large_blocks[i];
+      }
+      large_blocks.clear();
+
+      current_block = 0;
+      used_words = 0;
+    }
+
+    size_t bytes_reserved() const {
+      return sizeof(bv_uint64)*block_words*blocks.size();
+    }
+
+    // The arena new vectors on this thread allocate from, or null for the
+    // heap
+    static bit_vector_arena*& current() {
+      static thread_local bit_vector_arena* arena = nullptr;
+      return arena;
+    }
+  };
+
+  // Makes an arena current on this thread for its lifetime, scopes nest
+  class arena_scope {
+    bit_vector_arena* previous;
+
+    arena_scope(const arena_scope&);
+    arena_scope& operator=(const arena_scope&);
+
+  public:
+    explicit arena_scope(bit_vector_arena& arena) :
+      previous(bit_vector_arena::current()) {
+      bit_vector_arena::current() = &arena;
+    }
+
+    ~arena_scope() {
+      bit_vector_arena::current() = previous;
+    }
+  };
+
+  // Standard allocator over an arena, or over the heap when the arena is
+  // null. A default constructed allocator picks the current arena. The
+  // allocator never follows a container on copy or move assignment, so
+  // memory from an arena only ends up in containers created in its scope.
+  template<typename T>
+  class arena_allocator {
+  public:
+    typedef T value_type;
+    typedef std::false_type propagate_on_container_copy_assignment;
+    typedef std::false_type propagate_on_container_move_assignment;
+    typedef std::false_type propagate_on_container_swap;
+
+    bit_vector_arena* arena;
+
+    arena_allocator() : arena(bit_vector_arena::current()) {}
+
+    explicit arena_allocator(bit_vector_arena* arena_) : arena(arena_) {}
+
+    template<typename U>
+    arena_allocator(const arena_allocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(const size_t n) {
+      if (arena != nullptr) {
+        return static_cast<T*>(arena->allocate(n*sizeof(T)));
+      }
+      return static_cast<T*>(::operator new(n*sizeof(T)));
+    }
+
+    void deallocate(T* p, const size_t) {
+      if (arena == nullptr) {
+        ::operator delete(p);
+      }
+    }
+
+    // Copies belong to whatever scope they are made in
+    arena_allocator select_on_container_copy_construction() const {
+      return arena_allocator();
+    }
+  };
+
+  // Whether a allocates from the arena current on this thread, whose
+  // memory the next reset reclaims
+  template<typename T>
+  static inline bool in_current_arena(const arena_allocator<T>& a) {
+    return (a.arena != nullptr) && (a.arena == bit_vector_arena::current());
+  }
+
+  template<typename T, typename U>
+  static inline bool operator==(const arena_allocator<T>& a,
+                                const arena_allocator<U>& b) {
+    return a.arena == b.arena;
+  }
+
+  template<typename T, typename U>
+  static inline bool operator!=(const arena_allocator<T>& a,
+                                const arena_allocator<U>& b) {
+    return a.arena != b.arena;
+  }
+
+}
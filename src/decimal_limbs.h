@@ -0,0 +1,248 @@
+#pragma once
+
+#include <cassert>
+#include <vector>
+
+#include "limb_operations.h"
+
+// Conversion between limbs and decimal digits. Digits are handled 19 at a
+// time, the most that fit in one limb, so a narrow number is converted by
+// dividing or multiplying the whole number by 10^19 once per 19 digits.
+// Numbers wider than BV_DECIMAL_SPLIT_LIMBS limbs are instead split
+// around a power 10^(19*2^k) of about half their size, and the halves
+// are converted on their own. The wide division or multiplication then
+// runs once per level of splitting, not once per 19 digits.
+
+#define BV_DECIMAL_CHUNK 10000000000000000000ULL
+#define BV_DECIMAL_CHUNK_DIGITS 19
+
+#ifndef BV_DECIMAL_SPLIT_LIMBS
+#define BV_DECIMAL_SPLIT_LIMBS 16
+#endif
+
+namespace bsim {
+
+  // powers[k] is 10^(19*2^k) without leading zero limbs
+  typedef std::vector<std::vector<bv_uint64> > decimal_power_table;
+
+  static inline int trimmed_limbs(const bv_uint64* w, int n) {
+    while ((n > 0) && (w[n - 1] == 0)) {
+      n--;
+    }
+    return n;
+  }
+
+  static inline const std::vector<bv_uint64>&
+  decimal_power(decimal_power_table& powers, const int k) {
+    if (powers.empty()) {
+      powers.push_back(std::vector<bv_uint64>(1, BV_DECIMAL_CHUNK));
+    }
+
+    while ((int) powers.size() <= k) {
+      const int n = powers.back().size();
+      std::vector<bv_uint64> square(2*n);
+      mul_limbs_full(&square[0], &powers.back()[0], &powers.back()[0], n);
+      square.resize(trimmed_limbs(&square[0], 2*n));
+      powers.push_back(square);
+    }
+
+    return powers[k];
+  }
+
+  // Enough characters for the decimal digits of any width bit number
+  static inline int decimal_format_length(const int width) {
+    return width / 3 + 1;
+  }
+
+  // Writes w as exactly digits digits, or without leading zeros when
+  // digits is 0
+  static inline char* format_decimal_word(char* out,
+                                          bv_uint64 w,
+                                          const int digits) {
+    char rev[20];
+    int count = 0;
+    do {
+      rev[count++] = '0' + (w % 10);
+      w /= 10;
+    } while (w != 0);
+
+    while (count < digits) {
+      rev[count++] = '0';
+    }
+
+    while (count > 0) {
+      *out++ = rev[--count];
+    }
+    return out;
+  }
+
+  // Writes w[0, n), which is destroyed, as exactly digits digits, or
+  // without leading zeros when digits is 0. digits is always a multiple
+  // of 19.
+  static inline char* format_decimal_split(char* out,
+                                           bv_uint64* w,
+                                           int n,
+                                           const int digits,
+                                           decimal_power_table& powers) {
+    n = trimmed_limbs(w, n);
+
+    if (n > BV_DECIMAL_SPLIT_LIMBS) {
+      int k = 0;
+      while ((int) decimal_power(powers, k + 1).size() <= (n + 1) / 2) {
+        k++;
+      }
+
+      std::vector<bv_uint64> d(n, 0);
+      const std::vector<bv_uint64>& p = decimal_power(powers, k);
+      for (int i = 0; i < (int) p.size(); i++) {
+        d[i] = p[i];
+      }
+
+      std::vector<bv_uint64> q(n), r(n);
+      div_rem_limbs(&q[0], &r[0], w, &d[0], n);
+
+      const int low_digits = BV_DECIMAL_CHUNK_DIGITS << k;
+      out = format_decimal_split(out, &q[0], n,
+                                 digits == 0 ? 0 : digits - low_digits,
+                                 powers);
+      return format_decimal_split(out, &r[0], n, low_digits, powers);
+    }
+
+    bv_uint64 chunks[2*BV_DECIMAL_SPLIT_LIMBS + 2];
+    int count = 0;
+    while (n > 0) {
+      chunks[count++] = div_limbs_word(w, n, BV_DECIMAL_CHUNK);
+      n = trimmed_limbs(w, n);
+    }
+
+    if (digits == 0) {
+      if (count == 0) {
+        return format_decimal_word(out, 0, 0);
+      }
+      count--;
+      out = format_decimal_word(out, chunks[count], 0);
+    } else {
+      for (int i = BV_DECIMAL_CHUNK_DIGITS*count; i < digits; i++) {
+        *out++ = '0';
+      }
+    }
+
+    while (count > 0) {
+      count--;
+      out = format_decimal_word(out, chunks[count], BV_DECIMAL_CHUNK_DIGITS);
+    }
+    return out;
+  }
+
+  // Writes the unsigned number w[0, n) in decimal, with no leading zeros,
+  // and returns the end of the output. out needs room for
+  // decimal_format_length(64*n) characters. Numbers of up to
+  // BV_DECIMAL_SPLIT_LIMBS limbs are converted without allocating.
+  static inline char* format_decimal_limbs(char* out,
+                                           const bv_uint64* w,
+                                           int n) {
+    n = trimmed_limbs(w, n);
+
+    decimal_power_table powers;
+    if (n <= BV_DECIMAL_SPLIT_LIMBS) {
+      bv_uint64 t[BV_DECIMAL_SPLIT_LIMBS];
+      for (int i = 0; i < n; i++) {
+        t[i] = w[i];
+      }
+      return format_decimal_split(out, t, n, 0, powers);
+    }
+
+    std::vector<bv_uint64> t(w, w + n);
+    return format_decimal_split(out, t.data(), n, 0, powers);
+  }
+
+  // w[0, n) = w*10^count + digits, mod B^n, for the decimal digits and
+  // underscores in [p, end)
+  static inline void accumulate_decimal_digits(const char* p,
+                                               const char* end,
+                                               bv_uint64* w,
+                                               const int n) {
+    int active = 1;
+    bv_uint64 chunk = 0;
+    bv_uint64 scale = 1;
+    for (; p < end; p++) {
+      if (*p == '_') {
+        continue;
+      }
+
+      assert(('0' <= *p) && (*p <= '9'));
+
+      chunk = 10*chunk + (*p - '0');
+      scale *= 10;
+      if (scale == BV_DECIMAL_CHUNK) {
+        const bv_uint64 carry = mul_add_limbs_word(w, active, scale, chunk);
+        if ((carry != 0) && (active < n)) {
+          w[active++] = carry;
+        }
+        chunk = 0;
+        scale = 1;
+      }
+    }
+
+    if (scale != 1) {
+      const bv_uint64 carry = mul_add_limbs_word(w, active, scale, chunk);
+      if ((carry != 0) && (active < n)) {
+        w[active] = carry;
+      }
+    }
+  }
+
+  // The exact value of count decimal digits, without separators
+  static inline std::vector<bv_uint64>
+  parse_decimal_split(const char* digits,
+                      const int count,
+                      decimal_power_table& powers) {
+    if (count <= BV_DECIMAL_CHUNK_DIGITS*BV_DECIMAL_SPLIT_LIMBS) {
+      std::vector<bv_uint64> w(count / BV_DECIMAL_CHUNK_DIGITS + 1, 0);
+      accumulate_decimal_digits(digits, digits + count, &w[0], w.size());
+      return w;
+    }
+
+    int k = 0;
+    while ((BV_DECIMAL_CHUNK_DIGITS << (k + 1)) < count) {
+      k++;
+    }
+    const int low_digits = BV_DECIMAL_CHUNK_DIGITS << k;
+
+    const std::vector<bv_uint64> high =
+      parse_decimal_split(digits, count - low_digits, powers);
+    const std::vector<bv_uint64> low =
+      parse_decimal_split(digits + count - low_digits, low_digits, powers);
+    const std::vector<bv_uint64>& p = decimal_power(powers, k);
+
+    // high*10^low_digits + low, with both factors padded to one size
+    const int m = high.size() > p.size() ? high.size() : p.size();
+    std::vector<bv_uint64> a(m, 0), b(m, 0);
+    for (int i = 0; i < (int) high.size(); i++) {
+      a[i] = high[i];
+    }
+    for (int i = 0; i < (int) p.size(); i++) {
+      b[i] = p[i];
+    }
+
+    std::vector<bv_uint64> res(2*m + 1, 0);
+    mul_limbs_full(&res[0], &a[0], &b[0], m);
+    add_limbs_into(&res[0], res.size(), &low[0], low.size());
+
+    res.resize(trimmed_limbs(&res[0], res.size()) + 1);
+    return res;
+  }
+
+  // w[0, n) = the count decimal digits, without separators, mod B^n
+  static inline void parse_decimal_limbs(const char* digits,
+                                         const int count,
+                                         bv_uint64* w,
+                                         const int n) {
+    decimal_power_table powers;
+    const std::vector<bv_uint64> v = parse_decimal_split(digits, count, powers);
+    for (int i = 0; i < n; i++) {
+      w[i] = i < (int) v.size() ? v[i] : 0;
+    }
+  }
+
+}
@@ -2,9 +2,19 @@
 
 #include <bitset>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <stdint.h>
 #include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "bit_span.h"
+#include "bit_vector_arena.h"
+#include "bit_format.h"
+#include "bit_serialization.h"
+#include "limb_operations.h"
+#include "verilog_literal.h"
 
 // This is a comment
 
@@ -21,175 +31,189 @@ typedef uint64_t bv_uint64;
 
 namespace bsim {
 
-  static std::string hex_digit_to_binary(const char hex_digit) {
-    switch (hex_digit) {
-    case '0':
-      return "0000";
-    case '1':
-      return "0001";
-    case '2':
-      return "0010";
-    case '3':
-      return "0011";
-    case '4':
-      return "0100";
-    case '5':
-      return "0101";
-    case '6':
-      return "0110";
-    case '7':
-      return "0111";
-    case '8':
-      return "1000";
-    case '9':
-      return "1001";
-    case 'a':
-      return "1010";
-    case 'b':
-      return "1011";
-    case 'c':
-      return "1100";
-    case 'd':
-      return "1101";
-    case 'e':
-      return "1110";
-    case 'f':
-      return "1111";
-      
-    default:
-      assert(false);
-    }
+#ifndef BV_DYNAMIC_INLINE_BITS
+#define BV_DYNAMIC_INLINE_BITS 128
+#endif
 
-    assert(false);
-  }
+#define BV_DYNAMIC_INLINE_WORDS NUM_WORDS(BV_DYNAMIC_INLINE_BITS)
+
+  // See dynamic_bit_vector_expressions.h
+  template<typename Derived>
+  class dynamic_bit_vector_expression;
 
+  // Vectors of up to BV_DYNAMIC_INLINE_BITS bits keep their limbs inside
+  // the object, so building and copying them never touches the heap. Only
+  // wider vectors allocate, from the arena that was current when the
+  // vector was created (see bit_vector_arena.h) or from the heap.
   class dynamic_bit_vector {
-    std::vector<unsigned char> bits;
+    bv_uint64 inline_words[BV_DYNAMIC_INLINE_WORDS];
+    bv_uint64* words;
     int N;
+    arena_allocator<bv_uint64> alloc;
 
-  public:
+    static inline bool fits_inline(const int width) {
+      return NUM_WORDS(width) <= BV_DYNAMIC_INLINE_WORDS;
+    }
 
-    dynamic_bit_vector() : N(0) {}
+    inline bool is_inline() const {
+      return words == inline_words;
+    }
 
-    dynamic_bit_vector(const int N_) : N(N_) {
-      bits.resize(NUM_BYTES(N));
-      for (uint i = 0; i < bits.size(); i++) {
-	bits[i] = 0;
-      }
-      
-      for (int i = 0; i < N; i++) {
-	set(i, 0);
+    // Points words at zeroed storage for width bits
+    inline void allocate(const int width) {
+      N = width;
+      words = fits_inline(width) ?
+        inline_words : alloc.allocate(NUM_WORDS(width));
+      memset(words, 0, sizeof(bv_uint64)*NUM_WORDS(width));
+    }
+
+    inline void release() {
+      if (!is_inline()) {
+        alloc.deallocate(words, num_words());
       }
+      words = inline_words;
+      N = 0;
     }
 
-    dynamic_bit_vector(const std::string& str_raw) : N(0) {
-      std::string bv_size = "";
-      int ind = 0;
-      while (str_raw[ind] != '\'') {
-        assert(isdigit(str_raw[ind]));
-        bv_size += str_raw[ind];
-        ind++;
+    // Takes the limbs of other, which is left as a zero width vector.
+    // Both vectors must allocate from the same place.
+    inline void steal(dynamic_bit_vector& other) {
+      N = other.N;
+      if (other.is_inline()) {
+        words = inline_words;
+        memcpy(words, other.words, sizeof(bv_uint64)*num_words());
+      } else {
+        words = other.words;
       }
+      other.words = other.inline_words;
+      other.N = 0;
+    }
 
-      assert (str_raw[ind] == '\'');
+  public:
 
-      ind++;
+    dynamic_bit_vector() : words(inline_words), N(0) {}
 
-      char format = str_raw[ind];
+    dynamic_bit_vector(const int N_) : words(inline_words), N(0) {
+      allocate(N_);
+    }
 
-      assert((format == 'b') ||
-             (format == 'h') ||
-             (format == 'd'));
+    ~dynamic_bit_vector() {
+      release();
+    }
 
-      ind++;
+    // A Verilog literal such as 16'hbeef, see verilog_literal.h. x and z
+    // digits read as zero.
+    dynamic_bit_vector(const std::string& str) :
+      words(inline_words), N(0) {
+      const verilog_literal lit = parse_verilog_literal(str);
+      allocate(lit.width);
+      decode_verilog_literal(lit, words, nullptr);
+    }
 
-      std::string digits = "";
-      while (ind < ((int) str_raw.size())) {
-        digits += str_raw[ind];
-        ind++;
-      }
+    // Binary digits, most significant first, zero extended to N_ bits
+    dynamic_bit_vector(const int N_, const std::string& str) :
+      words(inline_words), N(0) {
+      allocate(N_);
+      decode_verilog_literal(binary_digits_literal(N_, str), words, nullptr);
+    }
 
-      int num_bits = stoi(bv_size);
-      N = num_bits;
-      bits.resize(NUM_BYTES(num_bits));
-      for (int i = 0; i < ((int) bits.size()); i++) {
-        bits[i] = 0;
+    // Only the low 32 bits of val are used, the rest of the vector is
+    // zero filled
+    dynamic_bit_vector(const int N_, const int val) :
+      words(inline_words), N(0) {
+      allocate(N_);
+      if (N > 0) {
+        words[0] = (bv_uint64) ((bv_uint32) val);
+        clear_tail();
       }
+    }
 
-      // TODO: Check that digits are not too long
-
-      assert(format == 'h');
+    // The N binary digits, most significant first, into out, which is
+    // not null terminated. Returns the end of the output.
+    inline char* format_to(char* out) const {
+      return format_binary_limbs(out, words, nullptr, 0, N);
+    }
 
-      int bit_ind = 0;
-      for (int i = digits.size() - 1; i >= 0; i--) {
-        char hex_digit = digits[i];
-        std::string hex_to_binary = hex_digit_to_binary(hex_digit);
+    // The literal of hex_string, into hex_format_length(N) characters of
+    // out
+    inline char* format_hex_to(char* out) const {
+      return format_hex_limbs(format_width_prefix(out, N, 'h'), words, nullptr, N);
+    }
 
-        assert(hex_to_binary.size() == 4);
+    std::string hex_string() const {
+      std::string hex(hex_format_length(N), '0');
+      format_hex_to(&hex[0]);
+      return hex;
+    }
 
-        int k = 0;
-        for (int j = hex_to_binary.size() - 1; j >= 0; j--) {
-          // Dont add past the end
-          if ((bit_ind + k) < bitLength()) {
-            set(bit_ind + k, hex_to_binary[j]);
-            k++;
-          } else {
-            assert(hex_to_binary[j] == '0');
-          }
-        }
-        bit_ind += 4;
-      }
+    // The unsigned value in decimal, into at most
+    // decimal_format_length(N) characters of out
+    inline char* format_decimal_to(char* out) const {
+      return format_decimal_limbs(out, words, num_words());
+    }
 
+    std::string to_decimal_string() const {
+      std::string str(decimal_format_length(N), '0');
+      str.resize(format_decimal_to(&str[0]) - &str[0]);
+      return str;
     }
 
-    dynamic_bit_vector(const int N_, const std::string& str_raw) : N(N_) {
-      int num_digits = 0;
-      std::string str;
-      for (int i = 0; i < ((int) str_raw.size()); i++) {
-	if (isdigit(str_raw[i])) {
-	  num_digits++;
-	  str += str_raw[i];
-	} else {
-	  assert(str_raw[i] == '_');
-	}
-      }
-      assert(num_digits <= N);
-
-      int len = str.size();      
-      bits.resize(NUM_BYTES(N));
-      for (int i = len - 1; i >= 0; i--) {
-        unsigned char val = (str[i] == '0') ? 0 : 1;
-        int ind = len - i - 1;
-        set(ind, val);
-      }
-      for (int i = N-1; i>=len; i--) {
-        set(i,0);
-      }
+    // Binary records, see bit_serialization.h
+    inline size_t serialized_size() const {
+      return serialized_record_size(N, false);
     }
 
-    dynamic_bit_vector(const int N_, const int val) : N(N_) {
-      bits.resize(NUM_BYTES(N));
-      *((int*) (&(bits[0]))) = val;
+    // Writes serialized_size() bytes to out and returns their end
+    inline unsigned char* serialize_to(unsigned char* out) const {
+      return write_serial_record(out, N, words, nullptr);
     }
 
-    std::string hex_string() {
-      std::string hex = std::to_string(N) + "'h";
+    inline void serialize_to(std::vector<unsigned char>& buffer) const {
+      const size_t start = buffer.size();
+      buffer.resize(start + serialized_size());
+      serialize_to(&buffer[start]);
+    }
 
-      for (int i = bits.size() - 1; i >= 0; i--) {
-        char bit_h = bits[i] & 0x0f;
-        char bit_l = (bits[i] >> 4) & 0x0f;
+    // Reads the record at the front of in, taking its width, and consumes
+    // it. Fails, leaving both unchanged, unless the record is complete
+    // and has no x/z plane.
+    inline bool deserialize_from(byte_span& in) {
+      int width;
+      bool has_unknown;
+      if (!read_serial_header(in, &width, &has_unknown) || has_unknown) {
+        return false;
+      }
 
-        hex += bit_l > 9 ? bit_l + 87 : bit_l + 48;
-        hex += bit_h > 9 ? bit_h + 87 : bit_h + 48;
+      if (width != N) {
+        *this = dynamic_bit_vector(width);
       }
-      return hex;
+      read_serial_limbs(words, in.data + BV_SERIAL_HEADER_BYTES, num_words());
+      clear_tail();
+
+      in.advance(serialized_size());
+      return true;
     }
     
-    dynamic_bit_vector(const dynamic_bit_vector& other) {
-      bits.resize(other.bits.size());
-      N = other.bitLength();
-      for (int i = 0; i < NUM_BYTES(N); i++) {
-	bits[i] = other.bits[i];
+    dynamic_bit_vector(const dynamic_bit_vector& other) :
+      words(inline_words), N(0) {
+      allocate(other.N);
+      memcpy(words, other.words, sizeof(bv_uint64)*num_words());
+    }
+
+    // Moving steals the limbs, leaving other as an empty zero width
+    // vector. Limbs from the current arena are copied to the heap
+    // instead, the new vector may be an element of a container that
+    // outlives the next reset. Running out of memory in that copy
+    // terminates, like any other failure in a noexcept move.
+    dynamic_bit_vector(dynamic_bit_vector&& other) noexcept :
+      words(inline_words), N(0), alloc(other.alloc) {
+      if (in_current_arena(other.alloc)) {
+        alloc = arena_allocator<bv_uint64>(nullptr);
+        allocate(other.N);
+        memcpy(words, other.words, sizeof(bv_uint64)*num_words());
+        other.release();
+      } else {
+        steal(other);
       }
     }
 
@@ -198,44 +222,119 @@ namespace bsim {
     	return *this;
       }
 
-      bits.resize(other.bits.size());
+      // Reuse the storage we already have when the limb counts match
+      if (num_words() != other.num_words()) {
+        release();
+        allocate(other.N);
+      }
+      N = other.N;
+      memcpy(words, other.words, sizeof(bv_uint64)*num_words());
+
+      return *this;
+    }
+
+    // Limbs are only stolen from a vector with the same allocator, so a
+    // vector never ends up holding memory from an arena it was not
+    // created in. Otherwise the limbs are copied, reusing this vector's
+    // storage when the limb counts match. As with move construction,
+    // running out of memory in that copy terminates.
+    dynamic_bit_vector& operator=(dynamic_bit_vector&& other) noexcept {
+      if (&other == this) {
+    	return *this;
+      }
 
-      N = other.bitLength();
-      for (int i = 0; i < NUM_BYTES(N); i++) {
-        bits[i] = other.bits[i];
+      if (alloc != other.alloc) {
+        return *this = other;
       }
 
+      release();
+      steal(other);
 
       return *this;
     }
 
+    // Evaluates a lazy expression into the existing limbs, see
+    // dynamic_bit_vector_expressions.h
+    template<typename Derived>
+    dynamic_bit_vector& operator=(const dynamic_bit_vector_expression<Derived>& e);
+
     inline void set(const int ind, const unsigned char val) {
-      int byte_num = ind / 8;
-      int bit_num = ind % 8;
+      int word_num = ind / BV_WORD_BITS;
+      int bit_num = ind % BV_WORD_BITS;
 
-      unsigned char old = bits[byte_num];
+      bv_uint64 old = words[word_num];
       // The & 0x01 only seems to be needed for logical not
-      old ^= (-(val & 0x01) ^ old) & (1 << bit_num);
+      old ^= (-((bv_uint64) (val & 0x01)) ^ old) & (((bv_uint64) 1) << bit_num);
 
-      bits[byte_num] = old;
+      words[word_num] = old;
     }
 
     unsigned char get(const int ind) const {
-      int byte_num = ind / 8;
-      int bit_num = ind % 8;
+      int word_num = ind / BV_WORD_BITS;
+      int bit_num = ind % BV_WORD_BITS;
+
+      return 0x01 & (words[word_num] >> bit_num);
+    }
+
+    inline int num_words() const {
+      return NUM_WORDS(N);
+    }
+
+    inline bv_uint64 get_word(const int i) const {
+      return words[i];
+    }
+
+    // Note: Callers writing the top word are responsible for keeping
+    // the bits past the end of the vector at zero, see clear_tail
+    inline void set_word(const int i, const bv_uint64 w) {
+      words[i] = w;
+    }
+
+    // The limbs, least significant first, for the kernels in
+    // limb_operations.h
+    inline const bv_uint64* word_data() const {
+      return words;
+    }
+
+    inline bv_uint64* word_data() {
+      return words;
+    }
 
-      unsigned char target_byte = bits[byte_num];
-      return 0x01 & (target_byte >> bit_num);
+    inline void clear_tail() {
+      if (N > 0) {
+        words[num_words() - 1] &= top_word_mask(N);
+      }
     }
 
+#ifdef BV_HAS_UINT128
+    // Only valid for vectors of 128 bits or less
+    inline bv_uint128 get_wide() const {
+      if (num_words() == 0) {
+        return 0;
+      }
+      return make_wide(words[0], num_words() > 1 ? words[1] : 0);
+    }
+
+    // Stores the low bits of w, bits past the end of the vector are dropped
+    inline void set_wide(const bv_uint128 w) {
+      if (num_words() > 0) {
+        words[0] = wide_low(w);
+      }
+      if (num_words() > 1) {
+        words[1] = wide_high(w);
+      }
+      clear_tail();
+    }
+#endif
+
     inline bool equals(const dynamic_bit_vector& other) const {
 
       if (other.bitLength() != this->bitLength()) {
         return false;
       }
 
-      for (int i = 0; i < N; i++) {
-	if (get(i) != other.get(i)) {
+      for (int i = 0; i < num_words(); i++) {
+	if (words[i] != other.words[i]) {
 	  return false;
 	}
       }
@@ -245,10 +344,10 @@ namespace bsim {
 
     template<typename ConvType>
     ConvType to_type() const {
-      ConvType tmp = *(const_cast<ConvType*>((const ConvType*) (&(bits[0]))));
-      //TODO FIXME I am a sketchy hack.
-      ConvType mask = sizeof(ConvType) > bits.size() ? (1<<N)-1 : -1; 
-      return tmp & mask;
+      if (N == 0) {
+        return 0;
+      }
+      return (ConvType) words[0];
     }
 
     inline bv_uint64 as_native_int32() const {
@@ -279,18 +378,7 @@ namespace bsim {
 
   static inline std::ostream& operator<<(std::ostream& out,
 					 const dynamic_bit_vector& a) {
-    const int N = a.bitLength();
-    for (int i = N - 1; i >= 0; i--) {
-      if (a.get(i) == 0) {
-	out << "0";
-      } else if (a.get(i) == 1) {
-	out << "1";
-      } else {
-	assert(false);
-      }
-    }
-
-    return out;
+    return write_binary_limbs(out, a.word_data(), nullptr, a.bitLength());
   }
 
   static inline bool operator==(const dynamic_bit_vector& a,
@@ -450,95 +538,89 @@ namespace bsim {
     
   // };
 
+  // Vectors of up to BV_WIDE_NATIVE_BITS bits are computed on one or two
+  // limbs as a single native integer
+  static inline bool fits_wide_native(const dynamic_bit_vector& a) {
+    return (0 < a.bitLength()) && (a.bitLength() <= BV_WIDE_NATIVE_BITS);
+  }
+
+  // Limb at a time add with carry
   static inline
   dynamic_bit_vector
   add_general_width_bv(const dynamic_bit_vector& a,
   		       const dynamic_bit_vector& b) {
 
     dynamic_bit_vector res(a.bitLength());
-    unsigned char carry = 0;
-    for (int i = 0; i < ((int) a.bitLength()); i++) {
-      unsigned char sum = a.get(i) + b.get(i) + carry;
-
-      carry = 0;
-
-      unsigned char z_i = sum & 0x01; //sum % 2;
-      res.set(i, z_i);
-      if (sum >= 2) {
-  	carry = 1;
-      }
-
+    bv_uint64 carry = 0;
+    for (int i = 0; i < a.num_words(); i++) {
+      bv_uint64 sum;
+      carry = add_with_carry(a.get_word(i), b.get_word(i), carry, &sum);
+      res.set_word(i, sum);
     }
+    res.clear_tail();
 
     return res;
   }
 
+  // Limb at a time subtract with borrow
   static inline
   dynamic_bit_vector
   sub_general_width_bv(const dynamic_bit_vector& a,
   		       const dynamic_bit_vector& b) {
-    int Width = a.bitLength();
-    dynamic_bit_vector diff(a.bitLength());
-    dynamic_bit_vector a_cpy = a;
-
-    for (int i = 0; i < Width; i++) {
 
-      if ((a_cpy.get(i) == 0) &&
-  	  (b.get(i) == 1)) {
-
-  	int j = i + 1;
+    dynamic_bit_vector diff(a.bitLength());
+    bv_uint64 borrow = 0;
+    for (int i = 0; i < a.num_words(); i++) {
+      bv_uint64 d;
+      borrow = sub_with_borrow(a.get_word(i), b.get_word(i), borrow, &d);
+      diff.set_word(i, d);
+    }
+    diff.clear_tail();
 
-  	diff.set(i, 1);	  
+    return diff;
+  }    
 
-  	// Modify to carry
-  	while ((j < Width) && (a_cpy.get(j) != 1)) {
-  	  a_cpy.set(j, 1);
-  	  j++;
-  	}
+  // In place updates of a, these back the compound assignment operators
+  // and reuse a's limbs instead of building a new vector
+  static inline void add_in_place(dynamic_bit_vector& a,
+                                  const dynamic_bit_vector& b) {
+    assert(a.bitLength() == b.bitLength());
 
-  	if (j >= Width) {
-  	} else {
-  	  a_cpy.set(j, 0);
-  	}
+    add_limbs_into(a.word_data(), a.num_words(), b.word_data(), b.num_words());
+    a.clear_tail();
+  }
 
-      } else if (a_cpy.get(i) == b.get(i)) {
-  	diff.set(i, 0);
-      } else if ((a_cpy.get(i) == 1) &&
-  		 (b.get(i) == 0)) {
-  	diff.set(i, 1);
-      } else {
-  	assert(false);
-      }
-    }
+  static inline void sub_in_place(dynamic_bit_vector& a,
+                                  const dynamic_bit_vector& b) {
+    assert(a.bitLength() == b.bitLength());
 
-    return diff;
-  }    
+    sub_limbs_from(a.word_data(), a.num_words(), b.word_data(), b.num_words());
+    a.clear_tail();
+  }
 
+  // Schoolbook multiplication of the limbs, switching to Karatsuba for
+  // very wide operands. The product is truncated to the operand width.
   static inline
   dynamic_bit_vector
   mul_general_width_bv(const dynamic_bit_vector& a,
   		       const dynamic_bit_vector& b) {
-    int Width = a.bitLength();
-    dynamic_bit_vector full_len(2*Width);
-
-    for (int i = 0; i < Width; i++) {
-      if (b.get(i) == 1) {
-
-  	dynamic_bit_vector shifted_a(2*Width);
-
-  	for (int j = 0; j < Width; j++) {
-  	  shifted_a.set(j + i, a.get(j));
-  	}
+    const int n = a.num_words();
+    dynamic_bit_vector res(a.bitLength());
 
-  	full_len =
-  	  add_general_width_bv(full_len, shifted_a);
-      }
+    if (n == 0) {
+      return res;
     }
 
-    dynamic_bit_vector res(Width);
-    for (int i = 0; i < Width; i++) {
-      res.set(i, full_len.get(i));
+#ifdef BV_HAS_UINT128
+    if (fits_wide_native(a)) {
+      res.set_wide(a.get_wide() * b.get_wide());
+      return res;
     }
+#endif
+
+    mul_limbs_low(res.word_data(), a.word_data(), b.word_data(), n);
+    res.clear_tail();
+
     return res;
   }    
   
@@ -550,8 +632,8 @@ namespace bsim {
     land(const dynamic_bit_vector& a,
   	 const dynamic_bit_vector& b) {
       dynamic_bit_vector a_and_b(a.bitLength());
-      for (int i = 0; i < a.bitLength(); i++) {
-  	a_and_b.set(i, a.get(i) & b.get(i));
+      for (int i = 0; i < a.num_words(); i++) {
+  	a_and_b.set_word(i, a.get_word(i) & b.get_word(i));
       }
       return a_and_b;
 
@@ -597,9 +679,10 @@ namespace bsim {
 
     static inline dynamic_bit_vector lnot(const dynamic_bit_vector& a) {
       dynamic_bit_vector not_a(a.bitLength());
-      for (int i = 0; i < a.bitLength(); i++) {
-  	not_a.set(i, ~a.get(i));
+      for (int i = 0; i < a.num_words(); i++) {
+  	not_a.set_word(i, ~a.get_word(i));
       }
+      not_a.clear_tail();
       return not_a;
 
     }
@@ -607,8 +690,8 @@ namespace bsim {
     static inline dynamic_bit_vector lor(const dynamic_bit_vector& a,
 					 const dynamic_bit_vector& b) {
       dynamic_bit_vector a_or_b(a.bitLength());
-      for (int i = 0; i < a.bitLength(); i++) {
-  	a_or_b.set(i, a.get(i) | b.get(i));
+      for (int i = 0; i < a.num_words(); i++) {
+  	a_or_b.set_word(i, a.get_word(i) | b.get_word(i));
       }
       return a_or_b;
     }
@@ -618,12 +701,36 @@ namespace bsim {
     lxor(const dynamic_bit_vector& a,
   	 const dynamic_bit_vector& b) {
       dynamic_bit_vector a_or_b(a.bitLength());
-      for (int i = 0; i < a.bitLength(); i++) {
-  	a_or_b.set(i, a.get(i) ^ b.get(i));
+      for (int i = 0; i < a.num_words(); i++) {
+  	a_or_b.set_word(i, a.get_word(i) ^ b.get_word(i));
       }
       return a_or_b;
 
     }
+
+    static inline void land_in_place(dynamic_bit_vector& a,
+                                     const dynamic_bit_vector& b) {
+      assert(a.bitLength() == b.bitLength());
+      for (int i = 0; i < a.num_words(); i++) {
+  	a.set_word(i, a.get_word(i) & b.get_word(i));
+      }
+    }
+
+    static inline void lor_in_place(dynamic_bit_vector& a,
+                                    const dynamic_bit_vector& b) {
+      assert(a.bitLength() == b.bitLength());
+      for (int i = 0; i < a.num_words(); i++) {
+  	a.set_word(i, a.get_word(i) | b.get_word(i));
+      }
+    }
+
+    static inline void lxor_in_place(dynamic_bit_vector& a,
+                                     const dynamic_bit_vector& b) {
+      assert(a.bitLength() == b.bitLength());
+      for (int i = 0; i < a.num_words(); i++) {
+  	a.set_word(i, a.get_word(i) ^ b.get_word(i));
+      }
+    }
     
   };
 
@@ -646,6 +753,36 @@ namespace bsim {
     return dynamic_bit_vector_operations::lxor(a, b);
   }
 
+  static inline dynamic_bit_vector& operator&=(dynamic_bit_vector& a,
+					       const dynamic_bit_vector& b) {
+    dynamic_bit_vector_operations::land_in_place(a, b);
+    return a;
+  }
+
+  static inline dynamic_bit_vector& operator|=(dynamic_bit_vector& a,
+					       const dynamic_bit_vector& b) {
+    dynamic_bit_vector_operations::lor_in_place(a, b);
+    return a;
+  }
+
+  static inline dynamic_bit_vector& operator^=(dynamic_bit_vector& a,
+					       const dynamic_bit_vector& b) {
+    dynamic_bit_vector_operations::lxor_in_place(a, b);
+    return a;
+  }
+
+  static inline dynamic_bit_vector& operator+=(dynamic_bit_vector& a,
+					       const dynamic_bit_vector& b) {
+    add_in_place(a, b);
+    return a;
+  }
+
+  static inline dynamic_bit_vector& operator-=(dynamic_bit_vector& a,
+					       const dynamic_bit_vector& b) {
+    sub_in_place(a, b);
+    return a;
+  }
+
   static inline bool operator!=(const dynamic_bit_vector& a,
   				const dynamic_bit_vector& b) {
     return !a.equals(b);
@@ -671,13 +808,12 @@ namespace bsim {
   
   static inline bool operator>(const dynamic_bit_vector& a,
   			       const dynamic_bit_vector& b) {
-    int N = a.bitLength();
-    for (int i = N - 1; i >= 0; i--) {
-      if (a.get(i) > b.get(i)) {
+    for (int i = a.num_words() - 1; i >= 0; i--) {
+      if (a.get_word(i) > b.get_word(i)) {
   	return true;
       }
 
-      if (a.get(i) < b.get(i)) {
+      if (a.get_word(i) < b.get_word(i)) {
   	return false;
       }
     }
@@ -697,42 +833,63 @@ namespace bsim {
     return !(a > b);
   }
 
+  // The 1 bit results of the reductions, built once instead of on
+  // every call
+  static inline const dynamic_bit_vector& dynamic_bit_constant(const bool b) {
+    static const dynamic_bit_vector zero(1, 0);
+    static const dynamic_bit_vector one(1, 1);
+    return b ? one : zero;
+  }
+
+  static inline int popcount(const dynamic_bit_vector& a) {
+    return popcount_limbs(a.word_data(), a.num_words());
+  }
+
+  // Index of the lowest set bit at or above from, or -1 if there is none
+  static inline int find_next_set(const dynamic_bit_vector& a, const int from) {
+    return find_next_set_limbs(a.word_data(), a.num_words(), from);
+  }
+
+  // Index of the lowest set bit, or -1 if no bit is set
+  static inline int find_first_set(const dynamic_bit_vector& a) {
+    return find_next_set(a, 0);
+  }
+
+  // Index of the highest set bit, or -1 if no bit is set
+  static inline int find_last_set(const dynamic_bit_vector& a) {
+    return find_last_set_limbs(a.word_data(), a.num_words());
+  }
+
+  // Zeros above the highest set bit, the width if no bit is set
+  static inline int count_leading_zeros(const dynamic_bit_vector& a) {
+    return a.bitLength() - 1 - find_last_set(a);
+  }
+
+  // Zeros below the lowest set bit, the width if no bit is set
+  static inline int count_trailing_zeros(const dynamic_bit_vector& a) {
+    int first = find_first_set(a);
+    return first < 0 ? a.bitLength() : first;
+  }
+
   static inline dynamic_bit_vector
   andr(const dynamic_bit_vector& a) {
-    for (int i = 0; i < a.bitLength(); i++) {
-      if (a.get(i) != 1) {
-	return dynamic_bit_vector(1, "0");
-      }
-    }
-
-    return dynamic_bit_vector(1, "1");
+    return dynamic_bit_constant(popcount(a) == a.bitLength());
   }
 
   static inline dynamic_bit_vector
   orr(const dynamic_bit_vector& a) {
-    for (int i = 0; i < a.bitLength(); i++) {
-      if (a.get(i) == 1) {
-	return dynamic_bit_vector(1, "1");
+    for (int i = 0; i < a.num_words(); i++) {
+      if (a.get_word(i) != 0) {
+	return dynamic_bit_constant(true);
       }
     }
 
-    return dynamic_bit_vector(1, "0");
+    return dynamic_bit_constant(false);
   }
 
   static inline dynamic_bit_vector
   xorr(const dynamic_bit_vector& a) {
-    int numSet = 0;
-    for (int i = 0; i < a.bitLength(); i++) {
-      if (a.get(i) == 1) {
-	numSet++;
-      }
-    }
-
-    if ((numSet % 2) == 0) {
-      return dynamic_bit_vector(1, "0");
-    }
-
-    return dynamic_bit_vector(1, "1");
+    return dynamic_bit_constant((popcount(a) & 1) == 1);
   }
   
   // template<int N>
@@ -778,20 +935,9 @@ namespace bsim {
       return true;
     }
 
-    // Both negative or both non-negative
-    //if ((a.get(N - 1) == 1) && (b.get(N - 1) == 1)) {
-
-    for (int i = N - 2; i >= 0; i--) {
-      if (a.get(i) > b.get(i)) {
-  	return true;
-      }
-
-      if (a.get(i) < b.get(i)) {
-  	return false;
-      }
-    }
-
-    return false;
+    // Both negative or both non-negative, the sign bits match so an
+    // unsigned comparison of the limbs gives the answer
+    return a > b;
 
   }
 
@@ -800,52 +946,29 @@ namespace bsim {
     return (signed_gt(a, b)) || (a == b);
   }
 
+  // Shift distances too large for 64 bits saturate, they move every bit
+  // out of the vector anyway
   static inline
   bv_uint64 get_shift_int(const dynamic_bit_vector& shift_amount) {
-    bv_uint64 shift_int = 0;
-    if (shift_amount.bitLength() > 64) {
-      assert(false);
-    }
-
-    else if (shift_amount.bitLength() > 32) {
-      shift_int = shift_amount.to_type<bv_uint64>();
-    }
-
-    else if (shift_amount.bitLength() > 16) {
-      shift_int = (bv_uint64) (shift_amount.to_type<bv_uint32>());
-    }
-
-    else if (shift_amount.bitLength() > 8) {
-      shift_int = (bv_uint64) (shift_amount.to_type<bv_uint16>());
-    } else {
-      shift_int = (bv_uint64) (shift_amount.to_type<bv_uint8>());
+    for (int i = 1; i < shift_amount.num_words(); i++) {
+      if (shift_amount.get_word(i) != 0) {
+        return ~((bv_uint64) 0);
+      }
     }
 
-    //std::cout << "shift_int = " << shift_int << std::endl;
-    assert(shift_int < 65);
-
-    return shift_int;
+    return shift_amount.num_words() == 0 ? 0 : shift_amount.get_word(0);
   }
 
   static inline dynamic_bit_vector
   lshr(const dynamic_bit_vector& a,
        const dynamic_bit_vector& shift_amount) {
     dynamic_bit_vector res(a.bitLength());
-
-    bv_uint64 shift_int = get_shift_int(shift_amount);
-
-    if (shift_int == 0) {
-      return a;
-    }
-
-    //unsigned char sign_bit = a.get(a.bitLength() - 1);
-    for (uint i = a.bitLength() - 1; i >= shift_int; i--) {
-      res.set(i - shift_int, a.get(i));
+    if (a.bitLength() == 0) {
+      return res;
     }
 
-    for (uint i = a.bitLength() - 1; i >= (a.bitLength() - shift_int); i--) {
-      res.set(i, 0);
-    }
+    shift_right_limbs(res.word_data(), a.word_data(), a.num_words(),
+                      get_shift_int(shift_amount), 0);
 
     return res;
   }
@@ -855,24 +978,23 @@ namespace bsim {
   dynamic_bit_vector
   ashr(const dynamic_bit_vector& a,
        const dynamic_bit_vector& shift_amount) {
-
-    if (shift_amount == dynamic_bit_vector(shift_amount.bitLength(), 0)) {
-      return a;
+    dynamic_bit_vector res(a);
+    if (a.bitLength() == 0) {
+      return res;
     }
 
-    dynamic_bit_vector res(a.bitLength());
-
-    bv_uint64 shift_int = get_shift_int(shift_amount);
-
-    unsigned char sign_bit = a.get(a.bitLength() - 1);
-    for (uint i = a.bitLength() - 1; i >= shift_int; i--) {
-      res.set(i - shift_int, a.get(i));
+    // Sign extend through the top limb of the copy so the funnel shift
+    // pulls in copies of the sign bit
+    const int n = a.num_words();
+    const bool negative = a.get(a.bitLength() - 1) == 1;
+    if (negative) {
+      res.word_data()[n - 1] |= ~top_word_mask(a.bitLength());
     }
 
-    int last_index = (int)a.bitLength() - shift_int;
-    for (int i = a.bitLength() - 1; i >= last_index && i >= 0; i--) {
-      res.set(i, sign_bit);
-    }
+    shift_right_limbs(res.word_data(), res.word_data(), n,
+                      get_shift_int(shift_amount),
+                      negative ? ~((bv_uint64) 0) : 0);
+    res.clear_tail();
 
     return res;
   }
@@ -882,12 +1004,131 @@ namespace bsim {
   shl(const dynamic_bit_vector& a,
       const dynamic_bit_vector& shift_amount) {
     dynamic_bit_vector res(a.bitLength());
+    if (a.bitLength() == 0) {
+      return res;
+    }
+
+    shift_left_limbs(res.word_data(), a.word_data(), a.num_words(),
+                     get_shift_int(shift_amount));
+    res.clear_tail();
 
-    bv_uint64 shift_int = get_shift_int(shift_amount);    
-    for (int i = shift_int; i < a.bitLength(); i++) {
-      res.set(i, a.get(i - shift_int));
+    return res;
+  }
+
+  static inline void shl_in_place(dynamic_bit_vector& a,
+                                  const bv_uint64 shift) {
+    shift_left_limbs(a.word_data(), a.word_data(), a.num_words(), shift);
+    a.clear_tail();
+  }
+
+  static inline void lshr_in_place(dynamic_bit_vector& a,
+                                   const bv_uint64 shift) {
+    shift_right_limbs(a.word_data(), a.word_data(), a.num_words(), shift, 0);
+  }
+
+  // Shift amounts may be given as vectors, like shl and lshr, or as plain
+  // ints. The shifts are logical, dynamic vectors carry no sign.
+  static inline dynamic_bit_vector& operator<<=(dynamic_bit_vector& a,
+						const dynamic_bit_vector& shift_amount) {
+    shl_in_place(a, get_shift_int(shift_amount));
+    return a;
+  }
+
+  static inline dynamic_bit_vector& operator<<=(dynamic_bit_vector& a,
+						const int shift) {
+    assert(shift >= 0);
+    shl_in_place(a, shift);
+    return a;
+  }
+
+  static inline dynamic_bit_vector& operator>>=(dynamic_bit_vector& a,
+						const dynamic_bit_vector& shift_amount) {
+    lshr_in_place(a, get_shift_int(shift_amount));
+    return a;
+  }
+
+  static inline dynamic_bit_vector& operator>>=(dynamic_bit_vector& a,
+						const int shift) {
+    assert(shift >= 0);
+    lshr_in_place(a, shift);
+    return a;
+  }
+
+  static inline
+  dynamic_bit_vector
+  rotate_left_by(const dynamic_bit_vector& a, const bv_uint64 rot) {
+    const int n = a.num_words();
+    dynamic_bit_vector res(a.bitLength());
+
+    shift_left_limbs(res.word_data(), a.word_data(), n, rot);
+    for (int i = 0; i < n; i++) {
+      res.word_data()[i] |= shifted_right_limb(a.word_data(), n, a.bitLength() - rot, i);
+    }
+    res.clear_tail();
+
+    return res;
+  }
+
+  // Rotates by any distance, the distance is reduced modulo the width
+  static inline
+  dynamic_bit_vector
+  rotate_left(const dynamic_bit_vector& a,
+              const dynamic_bit_vector& rotate_amount) {
+    if ((a.bitLength() == 0) || (rotate_amount.bitLength() == 0)) {
+      return a;
+    }
+
+    bv_uint64 rot = mod_limbs_word(rotate_amount.word_data(),
+                                   rotate_amount.num_words(),
+                                   a.bitLength());
+    return rotate_left_by(a, rot);
+  }
+
+  static inline
+  dynamic_bit_vector
+  rotate_right(const dynamic_bit_vector& a,
+               const dynamic_bit_vector& rotate_amount) {
+    if ((a.bitLength() == 0) || (rotate_amount.bitLength() == 0)) {
+      return a;
     }
 
+    bv_uint64 rot = mod_limbs_word(rotate_amount.word_data(),
+                                   rotate_amount.num_words(),
+                                   a.bitLength());
+    return rotate_left_by(a, rot == 0 ? 0 : a.bitLength() - rot);
+  }
+
+  // Views of bits [start, end) of a, see bit_span.h
+  static inline bit_span span(dynamic_bit_vector& a,
+                              const int start,
+                              const int end) {
+    assert((0 <= start) && (start <= end) && (end <= a.bitLength()));
+    return bit_span((unsigned char*) a.word_data(), 8*a.num_words(),
+                    start, end - start);
+  }
+
+  static inline bit_span span(dynamic_bit_vector& a) {
+    return span(a, 0, a.bitLength());
+  }
+
+  static inline const_bit_span const_span(const dynamic_bit_vector& a,
+                                          const int start,
+                                          const int end) {
+    assert((0 <= start) && (start <= end) && (end <= a.bitLength()));
+    return const_bit_span((const unsigned char*) a.word_data(),
+                          8*a.num_words(), start, end - start);
+  }
+
+  static inline const_bit_span const_span(const dynamic_bit_vector& a) {
+    return const_span(a, 0, a.bitLength());
+  }
+
+  static inline dynamic_bit_vector
+  to_dynamic_bit_vector(const const_bit_span& field) {
+    dynamic_bit_vector res(field.bitLength());
+    for (int i = 0; i < res.num_words(); i++) {
+      res.set_word(i, field.get_word(i));
+    }
     return res;
   }
 
@@ -896,12 +1137,8 @@ namespace bsim {
   concat(const dynamic_bit_vector& a,
 	 const dynamic_bit_vector& b) {
     dynamic_bit_vector res(a.bitLength() + b.bitLength());
-    for (int i = 0; i < a.bitLength(); i++) {
-      res.set(i, a.get(i));
-    }
-    for (int i = 0; i < ((int) b.bitLength()); i++) {
-      res.set(i + a.bitLength(), b.get(i));
-    }
+    span(res, 0, a.bitLength()).assign(const_span(a));
+    span(res, a.bitLength(), res.bitLength()).assign(const_span(b));
 
     return res;
   }
@@ -911,12 +1148,7 @@ namespace bsim {
   slice(const dynamic_bit_vector& a,
 	const int start,
 	const int end) {
-    dynamic_bit_vector res(end - start);
-
-    for (int i = 0; i < res.bitLength(); i++) {
-      res.set(i, a.get(i + start));
-    }
-    return res;
+    return to_dynamic_bit_vector(const_span(a, start, end));
   }
   
 
@@ -924,13 +1156,93 @@ namespace bsim {
   dynamic_bit_vector
   extend(const dynamic_bit_vector& a, const int extra_bits) {
     dynamic_bit_vector res(a.bitLength() + extra_bits);
-    for (uint i = 0; i < ((uint) a.bitLength()); i++) {
-      res.set(i, a.get(i));
-    }
+    span(res, 0, a.bitLength()).assign(const_span(a));
 
     return res;
   }
 
+  // Long division of the limbs, computing the quotient and the remainder
+  // together. Dividing by zero gives a quotient of all ones and leaves
+  // the remainder equal to the dividend, as RISC-V does.
+  static inline void
+  div_rem_bv(const dynamic_bit_vector& a,
+	     const dynamic_bit_vector& b,
+	     const bool is_signed,
+	     dynamic_bit_vector& quotient,
+	     dynamic_bit_vector& remainder) {
+    assert(a.bitLength() == b.bitLength());
+
+    // The quotient and remainder may be the operands, so divide into
+    // fresh vectors and move them into place afterwards
+    const int n = a.num_words();
+    dynamic_bit_vector q(a.bitLength());
+    dynamic_bit_vector r(a.bitLength());
+
+    if (is_signed) {
+      signed_div_rem_limbs(q.word_data(), r.word_data(), a.word_data(), b.word_data(), n, a.bitLength());
+    } else {
+      div_rem_limbs(q.word_data(), r.word_data(), a.word_data(), b.word_data(), n);
+      q.clear_tail();
+    }
+
+    quotient = std::move(q);
+    remainder = std::move(r);
+  }
+
+  static inline void
+  unsigned_div_rem(const dynamic_bit_vector& a,
+		   const dynamic_bit_vector& b,
+		   dynamic_bit_vector& quotient,
+		   dynamic_bit_vector& remainder) {
+    div_rem_bv(a, b, false, quotient, remainder);
+  }
+
+  static inline
+  dynamic_bit_vector
+  unsigned_divide(const dynamic_bit_vector& a,
+		  const dynamic_bit_vector& b) {
+    dynamic_bit_vector quotient, remainder;
+    div_rem_bv(a, b, false, quotient, remainder);
+    return quotient;
+  }
+
+  static inline
+  dynamic_bit_vector
+  unsigned_rem(const dynamic_bit_vector& a,
+	       const dynamic_bit_vector& b) {
+    dynamic_bit_vector quotient, remainder;
+    div_rem_bv(a, b, false, quotient, remainder);
+    return remainder;
+  }
+
+  // Signed division rounds toward zero, the remainder takes the sign of
+  // the dividend
+  static inline void
+  signed_div_rem(const dynamic_bit_vector& a,
+		 const dynamic_bit_vector& b,
+		 dynamic_bit_vector& quotient,
+		 dynamic_bit_vector& remainder) {
+    div_rem_bv(a, b, true, quotient, remainder);
+  }
+
+  static inline
+  dynamic_bit_vector
+  signed_divide(const dynamic_bit_vector& a,
+		const dynamic_bit_vector& b) {
+    dynamic_bit_vector quotient, remainder;
+    div_rem_bv(a, b, true, quotient, remainder);
+    return quotient;
+  }
+
+  static inline
+  dynamic_bit_vector
+  signed_rem(const dynamic_bit_vector& a,
+	     const dynamic_bit_vector& b) {
+    dynamic_bit_vector quotient, remainder;
+    div_rem_bv(a, b, true, quotient, remainder);
+    return remainder;
+  }
+
   // static inline
   // dynamic_bit_vector
   // set_ops(const dynamic_bit_vector& a_exp,
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cassert>
+#include <type_traits>
+
+#include "dynamic_bit_vector.h"
+
+// Opt-in lazy evaluation of bitwise expressions on dynamic_bit_vector.
+// Wrapping any operand in lazy() makes &, |, ^ and ~ build an expression
+// tree instead of a vector per operator. The whole tree is evaluated in a
+// single pass over the limbs when it is assigned to a vector:
+//
+//   dynamic_bit_vector r = (lazy(a) & b) | (~lazy(c) ^ d);
+//   r = lazy(a) ^ b;
+//
+// Assigning to an existing vector of the same width writes its limbs in
+// place, as evaluate_into does.
+//
+// Expressions refer to their operands, so they have to be evaluated
+// before the operands go away. Do not store them in auto variables that
+// outlive the statement.
+
+namespace bsim {
+
+  template<typename Derived>
+  class dynamic_bit_vector_expression {
+  public:
+
+    inline const Derived& self() const {
+      return static_cast<const Derived&>(*this);
+    }
+
+    // Bits past the end of the top limb are not masked here, see
+    // evaluate_into
+    inline bv_uint64 word(const int i) const {
+      return self().word(i);
+    }
+
+    inline int bitLength() const {
+      return self().bitLength();
+    }
+
+    operator dynamic_bit_vector() const;
+  };
+
+  class dynamic_bit_vector_leaf :
+    public dynamic_bit_vector_expression<dynamic_bit_vector_leaf> {
+    const dynamic_bit_vector& v;
+
+  public:
+    explicit dynamic_bit_vector_leaf(const dynamic_bit_vector& v_) : v(v_) {}
+
+    inline bv_uint64 word(const int i) const {
+      return v.get_word(i);
+    }
+
+    inline int bitLength() const {
+      return v.bitLength();
+    }
+  };
+
+  template<typename Arg>
+  class dynamic_bit_vector_not :
+    public dynamic_bit_vector_expression<dynamic_bit_vector_not<Arg> > {
+    Arg a;
+
+  public:
+    explicit dynamic_bit_vector_not(const Arg& a_) : a(a_) {}
+
+    inline bv_uint64 word(const int i) const {
+      return ~a.word(i);
+    }
+
+    inline int bitLength() const {
+      return a.bitLength();
+    }
+  };
+
+  struct expression_and {
+    static inline bv_uint64 apply(const bv_uint64 a, const bv_uint64 b) {
+      return a & b;
+    }
+  };
+
+  struct expression_or {
+    static inline bv_uint64 apply(const bv_uint64 a, const bv_uint64 b) {
+      return a | b;
+    }
+  };
+
+  struct expression_xor {
+    static inline bv_uint64 apply(const bv_uint64 a, const bv_uint64 b) {
+      return a ^ b;
+    }
+  };
+
+  template<typename Left, typename Right, typename Op>
+  class dynamic_bit_vector_binary :
+    public dynamic_bit_vector_expression<dynamic_bit_vector_binary<Left, Right, Op> > {
+    Left a;
+    Right b;
+
+  public:
+    dynamic_bit_vector_binary(const Left& a_, const Right& b_) : a(a_), b(b_) {
+      assert(a.bitLength() == b.bitLength());
+    }
+
+    inline bv_uint64 word(const int i) const {
+      return Op::apply(a.word(i), b.word(i));
+    }
+
+    inline int bitLength() const {
+      return a.bitLength();
+    }
+  };
+
+  static inline dynamic_bit_vector_leaf lazy(const dynamic_bit_vector& a) {
+    return dynamic_bit_vector_leaf(a);
+  }
+
+  // Writes the value of e into dst a limb at a time, reusing dst's
+  // storage when the widths match. dst may also appear in e, each limb
+  // of the result depends only on the same limb of the operands.
+  template<typename Derived>
+  static inline void
+  evaluate_into(dynamic_bit_vector& dst,
+                const dynamic_bit_vector_expression<Derived>& e) {
+    if (dst.bitLength() != e.bitLength()) {
+      dst = dynamic_bit_vector(e.bitLength());
+    }
+
+    bv_uint64* out = dst.word_data();
+    for (int i = 0; i < dst.num_words(); i++) {
+      out[i] = e.word(i);
+    }
+    dst.clear_tail();
+  }
+
+  template<typename Derived>
+  dynamic_bit_vector_expression<Derived>::operator dynamic_bit_vector() const {
+    dynamic_bit_vector res(bitLength());
+    evaluate_into(res, *this);
+    return res;
+  }
+
+  template<typename Derived>
+  inline dynamic_bit_vector&
+  dynamic_bit_vector::operator=(const dynamic_bit_vector_expression<Derived>& e) {
+    evaluate_into(*this, e);
+    return *this;
+  }
+
+  // Maps an operand of the lazy operators to its node type. Plain vectors
+  // become leaves, expressions are used as they are.
+  template<typename T, typename Enable = void>
+  struct expression_operand {
+    static const bool is_expression = false;
+    static const bool is_operand = false;
+  };
+
+  template<>
+  struct expression_operand<dynamic_bit_vector> {
+    typedef dynamic_bit_vector_leaf type;
+
+    static const bool is_expression = false;
+    static const bool is_operand = true;
+
+    static inline type wrap(const dynamic_bit_vector& a) {
+      return dynamic_bit_vector_leaf(a);
+    }
+  };
+
+  template<typename T>
+  struct expression_operand<T, typename std::enable_if<std::is_base_of<dynamic_bit_vector_expression<T>, T>::value>::type> {
+    typedef T type;
+
+    static const bool is_expression = true;
+    static const bool is_operand = true;
+
+    static inline const type& wrap(const T& a) {
+      return a;
+    }
+  };
+
+  // The lazy operators only take part when one side is already an
+  // expression, so plain vector operators are unchanged
+  template<typename Left, typename Right>
+  struct lazy_operands {
+    static const bool value =
+      expression_operand<Left>::is_operand &&
+      expression_operand<Right>::is_operand &&
+      (expression_operand<Left>::is_expression ||
+       expression_operand<Right>::is_expression);
+  };
+
+  template<typename Left, typename Right, typename Op>
+  struct lazy_result {
+    typedef dynamic_bit_vector_binary<typename expression_operand<Left>::type,
+                                      typename expression_operand<Right>::type,
+                                      Op> type;
+  };
+
+  template<typename Left, typename Right>
+  static inline
+  typename std::enable_if<lazy_operands<Left, Right>::value,
+                          typename lazy_result<Left, Right, expression_and>::type>::type
+  operator&(const Left& a, const Right& b) {
+    return typename lazy_result<Left, Right, expression_and>::type(expression_operand<Left>::wrap(a),
+                                                                   expression_operand<Right>::wrap(b));
+  }
+
+  template<typename Left, typename Right>
+  static inline
+  typename std::enable_if<lazy_operands<Left, Right>::value,
+                          typename lazy_result<Left, Right, expression_or>::type>::type
+  operator|(const Left& a, const Right& b) {
+    return typename lazy_result<Left, Right, expression_or>::type(expression_operand<Left>::wrap(a),
+                                                                  expression_operand<Right>::wrap(b));
+  }
+
+  template<typename Left, typename Right>
+  static inline
+  typename std::enable_if<lazy_operands<Left, Right>::value,
+                          typename lazy_result<Left, Right, expression_xor>::type>::type
+  operator^(const Left& a, const Right& b) {
+    return typename lazy_result<Left, Right, expression_xor>::type(expression_operand<Left>::wrap(a),
+                                                                   expression_operand<Right>::wrap(b));
+  }
+
+  template<typename Derived>
+  static inline dynamic_bit_vector_not<Derived>
+  operator~(const dynamic_bit_vector_expression<Derived>& a) {
+    return dynamic_bit_vector_not<Derived>(a.self());
+  }
+
+}
@@ -0,0 +1,683 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_addcll) && __has_builtin(__builtin_subcll)
+#define BV_HAS_BUILTIN_ADDC 1
+#endif
+#endif
+
+#if !defined(BV_HAS_BUILTIN_ADDC) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>
+#define BV_HAS_ADDCARRY_U64 1
+#endif
+
+typedef uint64_t bv_uint64;
+
+// Wide vectors are stored as arrays of 64 bit limbs, least significant
+// limb first. Bits past the end of the vector in the top limb are always
+// kept at zero so that limbs can be compared and combined directly.
+#define BV_WORD_BITS 64
+#define NUM_WORDS(N) (((N) + BV_WORD_BITS - 1) / BV_WORD_BITS)
+
+// Vectors of up to BV_WIDE_NATIVE_BITS bits are computed on a single
+// native integer. Compilers that provide a 128 bit integer extend this
+// from one limb to two, defining BV_NO_UINT128 turns that off.
+#if defined(__SIZEOF_INT128__) && !defined(BV_NO_UINT128)
+__extension__ typedef unsigned __int128 bv_uint128;
+#define BV_HAS_UINT128 1
+#define BV_WIDE_NATIVE_BITS 128
+#else
+#define BV_WIDE_NATIVE_BITS 64
+#endif
+
+namespace bsim {
+
+  // Mask selecting the bits of the top limb of an N bit vector that
+  // are part of the vector
+  static inline bv_uint64 top_word_mask(const int N) {
+    const int rem = N % BV_WORD_BITS;
+    if (rem == 0) {
+      return ~((bv_uint64) 0);
+    }
+    return (((bv_uint64) 1) << rem) - 1;
+  }
+
+  // Number of zero bits above the highest set bit of a non-zero limb
+  static inline int count_leading_zeros_word(const bv_uint64 w) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(w);
+#else
+    int n = 0;
+    for (bv_uint64 probe = ((bv_uint64) 1) << (BV_WORD_BITS - 1);
+	 (probe & w) == 0;
+	 probe >>= 1) {
+      n++;
+    }
+    return n;
+#endif
+  }
+
+  // Number of zero bits below the lowest set bit of a non-zero limb
+  static inline int count_trailing_zeros_word(const bv_uint64 w) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(w);
+#else
+    int n = 0;
+    for (bv_uint64 probe = 1; (probe & w) == 0; probe <<= 1) {
+      n++;
+    }
+    return n;
+#endif
+  }
+
+  static inline int popcount_word(const bv_uint64 w) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(w);
+#else
+    bv_uint64 v = w - ((w >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int) ((v * 0x0101010101010101ULL) >> 56);
+#endif
+  }
+
+  static inline int popcount_limbs(const bv_uint64* w, const int n) {
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+      count += popcount_word(w[i]);
+    }
+    return count;
+  }
+
+  // Index of the lowest set bit at or above from in w[0, n), or -1
+  static inline int find_next_set_limbs(const bv_uint64* w,
+					const int n,
+					const int from) {
+    if (from < 0) {
+      return find_next_set_limbs(w, n, 0);
+    }
+
+    int i = from / BV_WORD_BITS;
+    if (i >= n) {
+      return -1;
+    }
+
+    bv_uint64 word = w[i] & (~((bv_uint64) 0) << (from % BV_WORD_BITS));
+    while (word == 0) {
+      i++;
+      if (i == n) {
+	return -1;
+      }
+      word = w[i];
+    }
+
+    return i*BV_WORD_BITS + count_trailing_zeros_word(word);
+  }
+
+  // Index of the highest set bit in w[0, n), or -1
+  static inline int find_last_set_limbs(const bv_uint64* w, const int n) {
+    for (int i = n - 1; i >= 0; i--) {
+      if (w[i] != 0) {
+	return i*BV_WORD_BITS + (BV_WORD_BITS - 1) - count_leading_zeros_word(w[i]);
+      }
+    }
+    return -1;
+  }
+
+  // Adds two limbs and a carry in of 0 or 1, stores the low limb of the
+  // sum and returns the carry out
+  static inline bv_uint64 add_with_carry(const bv_uint64 a,
+					 const bv_uint64 b,
+					 const bv_uint64 carry_in,
+					 bv_uint64* sum) {
+#if defined(BV_HAS_BUILTIN_ADDC)
+    unsigned long long carry_out;
+    *sum = __builtin_addcll(a, b, carry_in, &carry_out);
+    return carry_out;
+#elif defined(BV_HAS_ADDCARRY_U64)
+    unsigned long long s;
+    unsigned char carry_out = _addcarry_u64((unsigned char) carry_in, a, b, &s);
+    *sum = s;
+    return carry_out;
+#else
+    bv_uint64 s = a + b;
+    bv_uint64 carry_out = s < a;
+    *sum = s + carry_in;
+    return carry_out | (*sum < s);
+#endif
+  }
+
+  // Subtracts b and a borrow in of 0 or 1 from a, stores the low limb of
+  // the difference and returns the borrow out
+  static inline bv_uint64 sub_with_borrow(const bv_uint64 a,
+					  const bv_uint64 b,
+					  const bv_uint64 borrow_in,
+					  bv_uint64* diff) {
+#if defined(BV_HAS_BUILTIN_ADDC)
+    unsigned long long borrow_out;
+    *diff = __builtin_subcll(a, b, borrow_in, &borrow_out);
+    return borrow_out;
+#elif defined(BV_HAS_ADDCARRY_U64)
+    unsigned long long d;
+    unsigned char borrow_out = _subborrow_u64((unsigned char) borrow_in, a, b, &d);
+    *diff = d;
+    return borrow_out;
+#else
+    bv_uint64 d = a - b;
+    bv_uint64 borrow_out = a < b;
+    *diff = d - borrow_in;
+    return borrow_out | (d < borrow_in);
+#endif
+  }
+
+  // Full 128 bit product of two limbs, returns the low limb and stores
+  // the high limb
+  static inline bv_uint64 mul_word(const bv_uint64 a,
+				   const bv_uint64 b,
+				   bv_uint64* high) {
+#ifdef BV_HAS_UINT128
+    bv_uint128 p = ((bv_uint128) a) * b;
+    *high = (bv_uint64) (p >> BV_WORD_BITS);
+    return (bv_uint64) p;
+#else
+    const bv_uint64 mask = 0xffffffffULL;
+    bv_uint64 a_lo = a & mask, a_hi = a >> 32;
+    bv_uint64 b_lo = b & mask, b_hi = b >> 32;
+
+    bv_uint64 lo_lo = a_lo * b_lo;
+    bv_uint64 hi_lo = a_hi * b_lo;
+    bv_uint64 lo_hi = a_lo * b_hi;
+    bv_uint64 hi_hi = a_hi * b_hi;
+
+    bv_uint64 cross = (lo_lo >> 32) + (hi_lo & mask) + lo_hi;
+    *high = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    return (cross << 32) | (lo_lo & mask);
+#endif
+  }
+
+  // a * b + addend + carry_in, which always fits in two limbs
+  static inline bv_uint64 mul_add_word(const bv_uint64 a,
+				       const bv_uint64 b,
+				       const bv_uint64 addend,
+				       const bv_uint64 carry_in,
+				       bv_uint64* carry_out) {
+#ifdef BV_HAS_UINT128
+    bv_uint128 p = ((bv_uint128) a) * b + addend + carry_in;
+    *carry_out = (bv_uint64) (p >> BV_WORD_BITS);
+    return (bv_uint64) p;
+#else
+    bv_uint64 high;
+    bv_uint64 low = mul_word(a, b, &high);
+    high += add_with_carry(low, addend, 0, &low);
+    high += add_with_carry(low, carry_in, 0, &low);
+    *carry_out = high;
+    return low;
+#endif
+  }
+
+  // dst[0, dn) += src[0, sn) with sn <= dn, returns the carry out of dst
+  static inline bv_uint64 add_limbs_into(bv_uint64* dst, const int dn,
+					 const bv_uint64* src, const int sn) {
+    bv_uint64 carry = 0;
+    for (int i = 0; i < dn; i++) {
+      if ((i >= sn) && (carry == 0)) {
+	break;
+      }
+      carry = add_with_carry(dst[i], i < sn ? src[i] : 0, carry, &dst[i]);
+    }
+    return carry;
+  }
+
+  // dst[0, dn) -= src[0, sn) with sn <= dn, returns the borrow out of dst
+  static inline bv_uint64 sub_limbs_from(bv_uint64* dst, const int dn,
+					 const bv_uint64* src, const int sn) {
+    bv_uint64 borrow = 0;
+    for (int i = 0; i < dn; i++) {
+      if ((i >= sn) && (borrow == 0)) {
+	break;
+      }
+      borrow = sub_with_borrow(dst[i], i < sn ? src[i] : 0, borrow, &dst[i]);
+    }
+    return borrow;
+  }
+
+  // Operands of at least this many limbs are multiplied with Karatsuba,
+  // below it schoolbook multiplication is faster
+#ifndef BV_KARATSUBA_THRESHOLD
+#define BV_KARATSUBA_THRESHOLD 48
+#endif
+
+  // res[0, na + nb) = a[0, na) * b[0, nb)
+  static inline void mul_limbs_schoolbook(bv_uint64* res,
+					  const bv_uint64* a, const int na,
+					  const bv_uint64* b, const int nb) {
+    for (int i = 0; i < na + nb; i++) {
+      res[i] = 0;
+    }
+
+    for (int i = 0; i < na; i++) {
+      bv_uint64 carry = 0;
+      for (int j = 0; j < nb; j++) {
+	res[i + j] = mul_add_word(a[i], b[j], res[i + j], carry, &carry);
+      }
+      res[i + nb] = carry;
+    }
+  }
+
+  // res[0, 2n) = a[0, n) * b[0, n)
+  static inline void mul_limbs_full(bv_uint64* res,
+				    const bv_uint64* a,
+				    const bv_uint64* b,
+				    const int n) {
+    if (n < BV_KARATSUBA_THRESHOLD) {
+      mul_limbs_schoolbook(res, a, n, b, n);
+      return;
+    }
+
+    // Karatsuba: with a = a1*B^h + a0 and b = b1*B^h + b0,
+    // a*b = a1*b1*B^2h + ((a0 + a1)(b0 + b1) - a0*b0 - a1*b1)*B^h + a0*b0
+    const int h = n / 2;
+    const int m = n - h;
+
+    mul_limbs_full(res, a, b, h);
+    mul_limbs_full(res + 2*h, a + h, b + h, m);
+
+    std::vector<bv_uint64> a_sum(a + h, a + n);
+    std::vector<bv_uint64> b_sum(b + h, b + n);
+    a_sum.push_back(add_limbs_into(&a_sum[0], m, a, h));
+    b_sum.push_back(add_limbs_into(&b_sum[0], m, b, h));
+
+    std::vector<bv_uint64> middle(2*(m + 1));
+    mul_limbs_full(&middle[0], &a_sum[0], &b_sum[0], m + 1);
+    sub_limbs_from(&middle[0], 2*(m + 1), res, 2*h);
+    sub_limbs_from(&middle[0], 2*(m + 1), res + 2*h, 2*m);
+
+    // The middle term is less than B^(2m + 1), its top limb is zero
+    const int middle_len = 2*m + 1 < 2*n - h ? 2*m + 1 : 2*n - h;
+    add_limbs_into(res + h, 2*n - h, &middle[0], middle_len);
+  }
+
+  // res[0, n) = a[0, n) * b[0, n) mod B^n, the product truncated to the
+  // width of the operands
+  static inline void mul_limbs_low(bv_uint64* res,
+				   const bv_uint64* a,
+				   const bv_uint64* b,
+				   const int n) {
+    if (n < BV_KARATSUBA_THRESHOLD) {
+      for (int i = 0; i < n; i++) {
+	res[i] = 0;
+      }
+
+      for (int i = 0; i < n; i++) {
+	bv_uint64 carry = 0;
+	for (int j = 0; i + j < n; j++) {
+	  res[i + j] = mul_add_word(a[i], b[j], res[i + j], carry, &carry);
+	}
+      }
+      return;
+    }
+
+    // With h >= n / 2 the a1*b1*B^2h term vanishes modulo B^n, and the
+    // cross terms are only needed modulo B^(n - h)
+    const int h = (n + 1) / 2;
+    const int m = n - h;
+
+    std::vector<bv_uint64> low(2*h);
+    mul_limbs_full(&low[0], a, b, h);
+    for (int i = 0; i < n; i++) {
+      res[i] = low[i];
+    }
+
+    std::vector<bv_uint64> cross(m);
+    mul_limbs_low(&cross[0], a + h, b, m);
+    add_limbs_into(res + h, m, &cross[0], m);
+    mul_limbs_low(&cross[0], a, b + h, m);
+    add_limbs_into(res + h, m, &cross[0], m);
+  }
+
+  // Divides the two limb number (high, low) by d, high < d. Returns the
+  // quotient limb and stores the remainder.
+  static inline bv_uint64 div_word(const bv_uint64 high,
+				   const bv_uint64 low,
+				   const bv_uint64 d,
+				   bv_uint64* rem) {
+#ifdef BV_HAS_UINT128
+    bv_uint128 n = (((bv_uint128) high) << BV_WORD_BITS) | low;
+    *rem = (bv_uint64) (n % d);
+    return (bv_uint64) (n / d);
+#else
+    bv_uint64 r = high;
+    bv_uint64 l = low;
+    bv_uint64 q = 0;
+    for (int i = 0; i < BV_WORD_BITS; i++) {
+      bv_uint64 top = r >> (BV_WORD_BITS - 1);
+      r = (r << 1) | (l >> (BV_WORD_BITS - 1));
+      l <<= 1;
+      q <<= 1;
+      if (top || (r >= d)) {
+	r -= d;
+	q |= 1;
+      }
+    }
+    *rem = r;
+    return q;
+#endif
+  }
+
+  // Two's complement negation of the width bit number in w[0, n)
+  static inline void negate_limbs(bv_uint64* w, const int n, const int width) {
+    bv_uint64 carry = 1;
+    for (int i = 0; i < n; i++) {
+      carry = add_with_carry(~w[i], 0, carry, &w[i]);
+    }
+    w[n - 1] &= top_word_mask(width);
+  }
+
+  // Divides the n limb numbers a and b, storing the quotient in q[0, n)
+  // and the remainder in r[0, n). Knuth's Algorithm D (TAOCP vol. 2,
+  // 4.3.1): the divisor is normalized so that its top bit is set, after
+  // which each quotient limb estimated from the top two limbs of the
+  // running remainder is at most one too large. As in RISC-V, dividing
+  // by zero sets every limb of q and leaves r equal to a, so callers
+  // mask the top limb of q to their width. q and r must not overlap a
+  // or b.
+  static inline void div_rem_limbs(bv_uint64* q,
+				   bv_uint64* r,
+				   const bv_uint64* a,
+				   const bv_uint64* b,
+				   const int n) {
+    int nb = n;
+    while ((nb > 0) && (b[nb - 1] == 0)) {
+      nb--;
+    }
+
+    int na = n;
+    while ((na > 0) && (a[na - 1] == 0)) {
+      na--;
+    }
+
+    if (nb == 0) {
+      for (int i = 0; i < n; i++) {
+	q[i] = ~((bv_uint64) 0);
+	r[i] = a[i];
+      }
+      return;
+    }
+
+    for (int i = 0; i < n; i++) {
+      q[i] = 0;
+      r[i] = 0;
+    }
+
+    if (na < nb) {
+      for (int i = 0; i < na; i++) {
+	r[i] = a[i];
+      }
+      return;
+    }
+
+    if (nb == 1) {
+      bv_uint64 rem = 0;
+      for (int j = na - 1; j >= 0; j--) {
+	q[j] = div_word(rem, a[j], b[0], &rem);
+      }
+      r[0] = rem;
+      return;
+    }
+
+    const int s = count_leading_zeros_word(b[nb - 1]);
+
+    std::vector<bv_uint64> vn(nb);
+    std::vector<bv_uint64> un(na + 1);
+    for (int i = nb - 1; i > 0; i--) {
+      vn[i] = (b[i] << s) | (s == 0 ? 0 : b[i - 1] >> (BV_WORD_BITS - s));
+    }
+    vn[0] = b[0] << s;
+
+    un[na] = s == 0 ? 0 : a[na - 1] >> (BV_WORD_BITS - s);
+    for (int i = na - 1; i > 0; i--) {
+      un[i] = (a[i] << s) | (s == 0 ? 0 : a[i - 1] >> (BV_WORD_BITS - s));
+    }
+    un[0] = a[0] << s;
+
+    const bv_uint64 v_top = vn[nb - 1];
+    const bv_uint64 v_next = vn[nb - 2];
+
+    for (int j = na - nb; j >= 0; j--) {
+      bv_uint64 qhat;
+      bv_uint64 rhat;
+      bool rhat_overflow = false;
+
+      if (un[j + nb] >= v_top) {
+	qhat = ~((bv_uint64) 0);
+	rhat_overflow = add_with_carry(un[j + nb - 1], v_top, 0, &rhat) != 0;
+      } else {
+	qhat = div_word(un[j + nb], un[j + nb - 1], v_top, &rhat);
+      }
+
+      // Correct the estimate while qhat * v_next > (rhat, un[j + nb - 2])
+      while (!rhat_overflow) {
+	bv_uint64 p_high;
+	bv_uint64 p_low = mul_word(qhat, v_next, &p_high);
+	if ((p_high < rhat) ||
+	    ((p_high == rhat) && (p_low <= un[j + nb - 2]))) {
+	  break;
+	}
+	qhat--;
+	rhat_overflow = add_with_carry(rhat, v_top, 0, &rhat) != 0;
+      }
+
+      // Multiply and subtract qhat * vn from the running remainder
+      bv_uint64 carry = 0;
+      bv_uint64 borrow = 0;
+      for (int i = 0; i < nb; i++) {
+	bv_uint64 p = mul_add_word(qhat, vn[i], 0, carry, &carry);
+	borrow = sub_with_borrow(un[i + j], p, borrow, &un[i + j]);
+      }
+      borrow = sub_with_borrow(un[j + nb], carry, borrow, &un[j + nb]);
+
+      // The estimate was one too large, add the divisor back
+      if (borrow != 0) {
+	qhat--;
+	un[j + nb] += add_limbs_into(&un[j], nb, &vn[0], nb);
+      }
+
+      q[j] = qhat;
+    }
+
+    for (int i = 0; i < nb; i++) {
+      r[i] = (un[i] >> s) | (s == 0 ? 0 : un[i + 1] << (BV_WORD_BITS - s));
+    }
+  }
+
+  // Signed division of the width bit two's complement numbers in
+  // a[0, n) and b[0, n). The quotient rounds toward zero and the
+  // remainder takes the sign of the dividend. Dividing by zero gives a
+  // quotient of -1 and a remainder equal to a.
+  static inline void signed_div_rem_limbs(bv_uint64* q,
+					  bv_uint64* r,
+					  const bv_uint64* a,
+					  const bv_uint64* b,
+					  const int n,
+					  const int width) {
+    if (find_last_set_limbs(b, n) < 0) {
+      div_rem_limbs(q, r, a, b, n);
+      q[n - 1] &= top_word_mask(width);
+      return;
+    }
+
+    const bv_uint64 sign_bit = ((bv_uint64) 1) << ((width - 1) % BV_WORD_BITS);
+    const bool a_neg = (a[n - 1] & sign_bit) != 0;
+    const bool b_neg = (b[n - 1] & sign_bit) != 0;
+
+    std::vector<bv_uint64> a_mag(a, a + n);
+    std::vector<bv_uint64> b_mag(b, b + n);
+    if (a_neg) {
+      negate_limbs(&a_mag[0], n, width);
+    }
+    if (b_neg) {
+      negate_limbs(&b_mag[0], n, width);
+    }
+
+    div_rem_limbs(q, r, &a_mag[0], &b_mag[0], n);
+
+    if (a_neg != b_neg) {
+      negate_limbs(q, n, width);
+    }
+    if (a_neg) {
+      negate_limbs(r, n, width);
+    }
+  }
+
+  // dst[0, n) = src[0, n) << shift, bits moved past the top limb are
+  // dropped. A limb move followed by a funnel shift of neighboring limbs.
+  // dst may be src for an in place shift, otherwise they must not overlap.
+  static inline void shift_left_limbs(bv_uint64* dst,
+				      const bv_uint64* src,
+				      const int n,
+				      const bv_uint64 shift) {
+    if (shift >= ((bv_uint64) n) * BV_WORD_BITS) {
+      for (int i = 0; i < n; i++) {
+	dst[i] = 0;
+      }
+      return;
+    }
+
+    const int limb_shift = (int) (shift / BV_WORD_BITS);
+    const int bit_shift = (int) (shift % BV_WORD_BITS);
+    for (int i = n - 1; i >= 0; i--) {
+      const int s = i - limb_shift;
+      if (s < 0) {
+	dst[i] = 0;
+	continue;
+      }
+
+      bv_uint64 w = src[s] << bit_shift;
+      if ((bit_shift != 0) && (s > 0)) {
+	w |= src[s - 1] >> (BV_WORD_BITS - bit_shift);
+      }
+      dst[i] = w;
+    }
+  }
+
+  // dst[0, n) = src[0, n) >> shift, with the vacated high bits taken
+  // from fill, which is 0 for a logical shift and all ones to extend a
+  // negative number. dst may be src for an in place shift, otherwise
+  // they must not overlap.
+  static inline void shift_right_limbs(bv_uint64* dst,
+				       const bv_uint64* src,
+				       const int n,
+				       const bv_uint64 shift,
+				       const bv_uint64 fill) {
+    if (shift >= ((bv_uint64) n) * BV_WORD_BITS) {
+      for (int i = 0; i < n; i++) {
+	dst[i] = fill;
+      }
+      return;
+    }
+
+    const int limb_shift = (int) (shift / BV_WORD_BITS);
+    const int bit_shift = (int) (shift % BV_WORD_BITS);
+    for (int i = 0; i < n; i++) {
+      const int s = i + limb_shift;
+      bv_uint64 low = s < n ? src[s] : fill;
+      if (bit_shift == 0) {
+	dst[i] = low;
+	continue;
+      }
+
+      bv_uint64 high = s + 1 < n ? src[s + 1] : fill;
+      dst[i] = (low >> bit_shift) | (high << (BV_WORD_BITS - bit_shift));
+    }
+  }
+
+  // Limb i of src[0, n) >> shift, with zeros shifted in
+  static inline bv_uint64 shifted_right_limb(const bv_uint64* src,
+					     const int n,
+					     const bv_uint64 shift,
+					     const int i) {
+    if (shift >= ((bv_uint64) n) * BV_WORD_BITS) {
+      return 0;
+    }
+
+    const int s = i + (int) (shift / BV_WORD_BITS);
+    const int bit_shift = (int) (shift % BV_WORD_BITS);
+    const bv_uint64 low = s < n ? src[s] : 0;
+    if (bit_shift == 0) {
+      return low;
+    }
+
+    const bv_uint64 high = s + 1 < n ? src[s + 1] : 0;
+    return (low >> bit_shift) | (high << (BV_WORD_BITS - bit_shift));
+  }
+
+  // w[0, n) mod d for d != 0
+  static inline bv_uint64 mod_limbs_word(const bv_uint64* w,
+					 const int n,
+					 const bv_uint64 d) {
+    bv_uint64 rem = 0;
+    for (int i = n - 1; i >= 0; i--) {
+      div_word(rem, w[i], d, &rem);
+    }
+    return rem;
+  }
+
+  // w[0, n) = w / d in place for d != 0, returns the remainder
+  static inline bv_uint64 div_limbs_word(bv_uint64* w,
+					 const int n,
+					 const bv_uint64 d) {
+    bv_uint64 rem = 0;
+    for (int i = n - 1; i >= 0; i--) {
+      w[i] = div_word(rem, w[i], d, &rem);
+    }
+    return rem;
+  }
+
+  // w[0, n) = w*m + a, returns the limb carried out of the top
+  static inline bv_uint64 mul_add_limbs_word(bv_uint64* w,
+					     const int n,
+					     const bv_uint64 m,
+					     const bv_uint64 a) {
+    bv_uint64 carry = a;
+    for (int i = 0; i < n; i++) {
+      w[i] = mul_add_word(w[i], m, 0, carry, &carry);
+    }
+    return carry;
+  }
+
+#ifdef BV_HAS_UINT128
+
+  static inline bv_uint128 make_wide(const bv_uint64 low, const bv_uint64 high) {
+    return (((bv_uint128) high) << BV_WORD_BITS) | low;
+  }
+
+  static inline bv_uint64 wide_low(const bv_uint128 w) {
+    return (bv_uint64) w;
+  }
+
+  static inline bv_uint64 wide_high(const bv_uint128 w) {
+    return (bv_uint64) (w >> BV_WORD_BITS);
+  }
+
+  // Mask selecting the low N bits of a wide integer, 0 < N <= 128
+  static inline bv_uint128 wide_mask(const int N) {
+    return ~((bv_uint128) 0) >> (2*BV_WORD_BITS - N);
+  }
+
+  // Index of the highest set bit, or -1 if no bit is set
+  static inline int top_bit_position_wide(const bv_uint128 w) {
+    if (wide_high(w) != 0) {
+      return (2*BV_WORD_BITS - 1) - count_leading_zeros_word(wide_high(w));
+    }
+    if (wide_low(w) != 0) {
+      return (BV_WORD_BITS - 1) - count_leading_zeros_word(wide_low(w));
+    }
+    return -1;
+  }
+
+#endif
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A read only memory mapping of a whole file
+
+namespace bsim {
+
+  class mapped_file {
+    const unsigned char* bytes;
+    size_t length;
+
+    mapped_file(const mapped_file&);
+    mapped_file& operator=(const mapped_file&);
+
+  public:
+
+    mapped_file() : bytes(nullptr), length(0) {}
+
+    ~mapped_file() {
+      close();
+    }
+
+    // Returns false when the file can't be opened or mapped. An empty file
+    // opens with a null data().
+    bool open(const std::string& path) {
+      close();
+
+      const int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) {
+        return false;
+      }
+
+      struct stat st;
+      if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+      }
+
+      if (st.st_size == 0) {
+        ::close(fd);
+        return true;
+      }
+
+      void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (mapped == MAP_FAILED) {
+        return false;
+      }
+
+      bytes = (const unsigned char*) mapped;
+      length = st.st_size;
+      return true;
+    }
+
+    void close() {
+      if (bytes != nullptr) {
+        munmap((void*) bytes, length);
+      }
+      bytes = nullptr;
+      length = 0;
+    }
+
+    inline const unsigned char* data() const {
+      return bytes;
+    }
+
+    inline size_t size() const {
+      return length;
+    }
+  };
+
+}
@@ -0,0 +1,519 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "limb_operations.h"
+#include "mapped_file.h"
+#include "verilog_literal.h"
+
+// Memories held as one packed array of limbs, and a loader for the memory
+// image files read by Verilog's $readmemh and $readmemb:
+//
+//   // boot rom
+//   @0000  dead_beef 00000001
+//   @0100  xxxxxxxx  1234zzzz   /* not programmed */
+//
+// Words are separated by white space and comments, and @ followed by hex
+// digits moves the next word to that address. Words may use x, z and ?
+// digits, which go into the x/z plane of the memory, and underscores.
+//
+// The loader maps the file and splits it into chunks at word boundaries.
+// Chunks are parsed on their own threads in two passes. The first counts
+// the words of each chunk after its last address directive, which gives
+// the address every chunk starts at, and the second decodes the words
+// straight into the limbs of the memory. When directives make two chunks
+// write the same addresses, the second pass runs the chunks one after
+// another in file order instead, so the last word in the file wins.
+
+#ifndef BV_READMEM_CHUNK_BYTES
+#define BV_READMEM_CHUNK_BYTES (1 << 20)
+#endif
+
+namespace bsim {
+
+  class packed_memory {
+    int width;
+    size_t depth;
+    std::vector<bv_uint64> values;
+
+    // Empty until a word with x or z bits is stored
+    std::vector<bv_uint64> unknowns;
+
+  public:
+    packed_memory(const int width_, const size_t depth_) :
+      width(width_), depth(depth_), values(depth_*NUM_WORDS(width_), 0) {
+      assert(width > 0);
+    }
+
+    inline int word_width() const {
+      return width;
+    }
+
+    inline size_t size() const {
+      return depth;
+    }
+
+    inline bool has_unknown_plane() const {
+      return !unknowns.empty();
+    }
+
+    // Adds an x/z plane with every bit known
+    void add_unknown_plane() {
+      if (unknowns.empty()) {
+        unknowns.assign(values.size(), 0);
+      }
+    }
+
+    // The NUM_WORDS(word_width()) limbs of the word at addr. The unknown
+    // limbs are null without an x/z plane.
+    inline bv_uint64* value_data(const size_t addr) {
+      assert(addr < depth);
+      return &values[addr*NUM_WORDS(width)];
+    }
+
+    inline bv_uint64* unknown_data(const size_t addr) {
+      assert(addr < depth);
+      return unknowns.empty() ? nullptr : &unknowns[addr*NUM_WORDS(width)];
+    }
+
+    inline bv_uint64 get_value_word(const size_t addr, const int i) const {
+      assert(addr < depth);
+      return values[addr*NUM_WORDS(width) + i];
+    }
+
+    inline bv_uint64 get_unknown_word(const size_t addr, const int i) const {
+      assert(addr < depth);
+      return unknowns.empty() ? 0 : unknowns[addr*NUM_WORDS(width) + i];
+    }
+
+    // Reads the word at addr into a two valued vector, x and z bits read
+    // as 0
+    template<typename Vector>
+    auto read(const size_t addr, Vector& v) const ->
+      decltype(v.set_word(0, 0), void()) {
+      assert(v.bitLength() == width);
+      for (int i = 0; i < NUM_WORDS(width); i++) {
+        v.set_word(i, get_value_word(addr, i) & ~get_unknown_word(addr, i));
+      }
+    }
+
+    template<typename Vector>
+    auto read(const size_t addr, Vector& v) const ->
+      decltype(v.set_unknown_word(0, 0), void()) {
+      assert(v.bitLength() == width);
+      for (int i = 0; i < NUM_WORDS(width); i++) {
+        v.set_value_word(i, get_value_word(addr, i));
+        v.set_unknown_word(i, get_unknown_word(addr, i));
+      }
+    }
+
+    template<typename Vector>
+    auto write(const size_t addr, const Vector& v) ->
+      decltype(v.get_word(0), void()) {
+      assert(v.bitLength() == width);
+      bv_uint64* value = value_data(addr);
+      bv_uint64* unknown = unknown_data(addr);
+      for (int i = 0; i < NUM_WORDS(width); i++) {
+        value[i] = v.get_word(i);
+        if (unknown != nullptr) {
+          unknown[i] = 0;
+        }
+      }
+    }
+
+    template<typename Vector>
+    auto write(const size_t addr, const Vector& v) ->
+      decltype(v.get_unknown_word(0), void()) {
+      assert(v.bitLength() == width);
+      for (int i = 0; i < NUM_WORDS(width); i++) {
+        if (v.get_unknown_word(i) != 0) {
+          add_unknown_plane();
+        }
+      }
+
+      bv_uint64* value = value_data(addr);
+      bv_uint64* unknown = unknown_data(addr);
+      for (int i = 0; i < NUM_WORDS(width); i++) {
+        value[i] = v.get_value_word(i);
+        if (unknown != nullptr) {
+          unknown[i] = v.get_unknown_word(i);
+        }
+      }
+    }
+  };
+
+  static inline bool is_readmem_space(const char c) {
+    return (c == ' ') || (c == '\t') || (c == '\n') ||
+      (c == '\r') || (c == '\f') || (c == '\v');
+  }
+
+  static inline bool is_readmem_comment(const char* p, const char* end) {
+    return (p + 1 < end) && (p[0] == '/') && ((p[1] == '/') || (p[1] == '*'));
+  }
+
+  // The end of the comment starting at p
+  static inline const char* skip_readmem_comment(const char* p,
+                                                 const char* end) {
+    if (p[1] == '/') {
+      const char* newline = (const char*) memchr(p, '\n', end - p);
+      return newline == nullptr ? end : newline + 1;
+    }
+
+    const char* q = p + 2;
+    while (q < end) {
+      q = (const char*) memchr(q, '*', end - q);
+      if (q == nullptr) {
+        return end;
+      }
+      if ((q + 1 < end) && (q[1] == '/')) {
+        return q + 2;
+      }
+      q++;
+    }
+    return end;
+  }
+
+  // Finds the next word or address directive in [*p, end). On success the
+  // token is [*begin, *p).
+  static inline bool next_readmem_token(const char** p,
+                                        const char* end,
+                                        const char** begin) {
+    const char* q = *p;
+    while (q < end) {
+      if (is_readmem_space(*q)) {
+        q++;
+      } else if (is_readmem_comment(q, end)) {
+        q = skip_readmem_comment(q, end);
+      } else {
+        break;
+      }
+    }
+
+    *begin = q;
+    while ((q < end) && !is_readmem_space(*q) && !is_readmem_comment(q, end)) {
+      q++;
+    }
+    *p = q;
+
+    return *begin < end;
+  }
+
+  // The hex digits of an address directive, after the @
+  static inline bool parse_readmem_address(const char* p,
+                                           const char* end,
+                                           bv_uint64* address) {
+    const unsigned char* table = literal_digits();
+
+    bool any = false;
+    *address = 0;
+    for (; p < end; p++) {
+      const unsigned char d = table[(unsigned char) *p];
+      if (d == LITERAL_SEPARATOR) {
+        continue;
+      }
+      if (d >= 16) {
+        return false;
+      }
+      *address = (*address << 4) | d;
+      any = true;
+    }
+    return any;
+  }
+
+  // Splits [begin, end) into at most count chunks. Chunks start between
+  // tokens and outside comments. Returns the chunk starts followed by end.
+  static inline std::vector<const char*>
+  split_readmem_chunks(const char* begin, const char* end, const int count) {
+    std::vector<const char*> starts(1, begin);
+
+    // Comments are skipped whole, so p never stops inside one
+    const char* p = begin;
+    for (int k = 1; k < count; k++) {
+      const char* target = begin + ((size_t) (end - begin))*k / count;
+      while (p < target) {
+        const char* slash = (const char*) memchr(p, '/', target - p);
+        if (slash == nullptr) {
+          p = target;
+        } else if (is_readmem_comment(slash, end)) {
+          p = skip_readmem_comment(slash, end);
+        } else {
+          p = slash + 1;
+        }
+      }
+
+      while ((p < end) && !is_readmem_space(*p) && !is_readmem_comment(p, end)) {
+        p++;
+      }
+
+      if (p == end) {
+        break;
+      }
+      if (p > starts.back()) {
+        starts.push_back(p);
+      }
+    }
+
+    starts.push_back(end);
+    return starts;
+  }
+
+  struct readmem_chunk {
+    const char* begin;
+    const char* end;
+    bool ok;
+
+    // From the first pass, the last address directive in the chunk and
+    // the number of words after it, or after the start of the chunk when
+    // it has no directive
+    bool has_address;
+    bv_uint64 address;
+    bv_uint64 words;
+    bool has_unknown;
+
+    // Words before the first directive, whose addresses are only known
+    // once start_address is set
+    bv_uint64 lead_words;
+
+    // The lowest and highest address written, when has_range is set
+    bool has_range;
+    bv_uint64 low;
+    bv_uint64 high;
+
+    // The address of the first word, set between the passes
+    bv_uint64 start_address;
+  };
+
+  // Adds the count words from first to the addresses c writes
+  static inline void add_readmem_range(readmem_chunk& c,
+                                       const bv_uint64 first,
+                                       const bv_uint64 count) {
+    if (count == 0) {
+      return;
+    }
+
+    const bv_uint64 last = first + count - 1;
+    if (!c.has_range || (first < c.low)) {
+      c.low = first;
+    }
+    if (!c.has_range || (last > c.high)) {
+      c.high = last;
+    }
+    c.has_range = true;
+  }
+
+  // Whether any two chunks write a common address
+  static inline bool readmem_chunks_overlap(const std::vector<readmem_chunk>& chunks) {
+    std::vector<std::pair<bv_uint64, bv_uint64> > ranges;
+    for (size_t i = 0; i < chunks.size(); i++) {
+      if (chunks[i].has_range) {
+        ranges.push_back(std::make_pair(chunks[i].low, chunks[i].high));
+      }
+    }
+
+    std::sort(ranges.begin(), ranges.end());
+    for (size_t i = 1; i < ranges.size(); i++) {
+      if (ranges[i].first <= ranges[i - 1].second) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static inline void count_readmem_chunk(readmem_chunk& c) {
+    const unsigned char* table = literal_digits();
+
+    const char* p = c.begin;
+    const char* token;
+    while (next_readmem_token(&p, c.end, &token)) {
+      if (*token == '@') {
+        if (c.has_address) {
+          add_readmem_range(c, c.address, c.words);
+        } else {
+          c.lead_words = c.words;
+        }
+
+        if (!parse_readmem_address(token + 1, p, &c.address)) {
+          c.ok = false;
+          return;
+        }
+        c.has_address = true;
+        c.words = 0;
+        continue;
+      }
+
+      c.words++;
+      for (const char* q = token; (q < p) && !c.has_unknown; q++) {
+        const unsigned char d = table[(unsigned char) *q];
+        c.has_unknown = (d == LITERAL_DIGIT_X) || (d == LITERAL_DIGIT_Z);
+      }
+    }
+
+    if (c.has_address) {
+      add_readmem_range(c, c.address, c.words);
+    } else {
+      c.lead_words = c.words;
+    }
+  }
+
+  static inline void decode_readmem_chunk(readmem_chunk& c,
+                                          const int bits,
+                                          packed_memory& mem) {
+    verilog_literal lit;
+    lit.width = mem.word_width();
+    lit.is_signed = false;
+    lit.base = bits == 1 ? 'b' : 'h';
+
+    bv_uint64 addr = c.start_address;
+    const char* p = c.begin;
+    const char* token;
+    while (next_readmem_token(&p, c.end, &token)) {
+      if (*token == '@') {
+        parse_readmem_address(token + 1, p, &addr);
+        continue;
+      }
+
+      if (addr >= mem.size()) {
+        c.ok = false;
+        return;
+      }
+
+      lit.digits = token;
+      lit.digits_end = p;
+      bool has_unknown;
+      if (!decode_verilog_literal_checked(lit,
+                                          mem.value_data(addr),
+                                          mem.unknown_data(addr),
+                                          &has_unknown)) {
+        c.ok = false;
+        return;
+      }
+      addr++;
+    }
+  }
+
+  // Runs f on every chunk, each on its own thread
+  template<typename F>
+  static inline void run_readmem_chunks(std::vector<readmem_chunk>& chunks,
+                                        F f) {
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunks.size(); i++) {
+      readmem_chunk* c = &chunks[i];
+      workers.push_back(std::thread([&f, c]() { f(*c); }));
+    }
+
+    f(chunks[0]);
+
+    for (size_t i = 0; i < workers.size(); i++) {
+      workers[i].join();
+    }
+  }
+
+  // Loads a memory image with bits bits per digit, 4 for $readmemh and 1
+  // for $readmemb. Words without an address directive go to consecutive
+  // addresses from start. threads is the most threads to parse with, 0
+  // for one per core. Returns false when the file can't be read, has a
+  // bad digit or address, or puts a word past the end of the memory.
+  static inline bool load_readmem(const std::string& path,
+                                  const int bits,
+                                  packed_memory& mem,
+                                  const size_t start = 0,
+                                  int threads = 0) {
+    assert((bits == 1) || (bits == 4));
+
+    mapped_file file;
+    if (!file.open(path)) {
+      return false;
+    }
+
+    const char* begin = (const char*) file.data();
+    const char* end = begin + file.size();
+
+    if (threads <= 0) {
+      threads = std::thread::hardware_concurrency();
+    }
+    if (threads <= 0) {
+      threads = 1;
+    }
+
+    // Small files aren't worth starting threads for
+    const size_t max_chunks = file.size() / BV_READMEM_CHUNK_BYTES + 1;
+    if ((size_t) threads > max_chunks) {
+      threads = max_chunks;
+    }
+
+    const std::vector<const char*> starts = split_readmem_chunks(begin, end, threads);
+
+    std::vector<readmem_chunk> chunks(starts.size() - 1);
+    for (size_t i = 0; i < chunks.size(); i++) {
+      readmem_chunk& c = chunks[i];
+      c.begin = starts[i];
+      c.end = starts[i + 1];
+      c.ok = true;
+      c.has_address = false;
+      c.address = 0;
+      c.words = 0;
+      c.has_unknown = false;
+      c.lead_words = 0;
+      c.has_range = false;
+      c.low = 0;
+      c.high = 0;
+      c.start_address = 0;
+    }
+
+    run_readmem_chunks(chunks, count_readmem_chunk);
+
+    bv_uint64 addr = start;
+    bool has_unknown = false;
+    for (size_t i = 0; i < chunks.size(); i++) {
+      readmem_chunk& c = chunks[i];
+      if (!c.ok) {
+        return false;
+      }
+
+      c.start_address = addr;
+      add_readmem_range(c, addr, c.lead_words);
+      addr = (c.has_address ? c.address : addr) + c.words;
+      has_unknown = has_unknown || c.has_unknown;
+    }
+
+    if (has_unknown) {
+      mem.add_unknown_plane();
+    }
+
+    if (readmem_chunks_overlap(chunks)) {
+      for (size_t i = 0; (i < chunks.size()) && ((i == 0) || chunks[i - 1].ok); i++) {
+        decode_readmem_chunk(chunks[i], bits, mem);
+      }
+    } else {
+      run_readmem_chunks(chunks, [bits, &mem](readmem_chunk& c) {
+          decode_readmem_chunk(c, bits, mem);
+        });
+    }
+
+    for (size_t i = 0; i < chunks.size(); i++) {
+      if (!chunks[i].ok) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static inline bool load_readmemh(const std::string& path,
+                                   packed_memory& mem,
+                                   const size_t start = 0) {
+    return load_readmem(path, 4, mem, start);
+  }
+
+  static inline bool load_readmemb(const std::string& path,
+                                   packed_memory& mem,
+                                   const size_t start = 0) {
+    return load_readmem(path, 1, mem, start);
+  }
+
+}
@@ -1,11 +1,21 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <bitset>
 #include <cassert>
 #include <iostream>
 #include <stdint.h>
 #include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "bit_vector_arena.h"
+#include "bit_format.h"
+#include "bit_span.h"
+#include "bit_serialization.h"
+#include "limb_operations.h"
+#include "verilog_literal.h"
 
 // This is a comment
 
@@ -22,52 +32,6 @@ typedef uint64_t bv_uint64;
 
 namespace bsim {
 
-  static std::string hex_digit_to_binary(const char hex_digit) {
-    switch (hex_digit) {
-    case '0':
-      return "0000";
-    case '1':
-      return "0001";
-    case '2':
-      return "0010";
-    case '3':
-      return "0011";
-    case '4':
-      return "0100";
-    case '5':
-      return "0101";
-    case '6':
-      return "0110";
-    case '7':
-      return "0111";
-    case '8':
-      return "1000";
-    case '9':
-      return "1001";
-    case 'a':
-      return "1010";
-    case 'b':
-      return "1011";
-    case 'c':
-      return "1100";
-    case 'd':
-      return "1101";
-    case 'e':
-      return "1110";
-    case 'f':
-      return "1111";
-    case 'x':
-      return "xxxx";
-    case 'z':
-      return "zzzz";
-      
-    default:
-      assert(false);
-    }
-
-    assert(false);
-  }
-
   class quad_value {
   protected:
     unsigned char value;
@@ -274,197 +238,201 @@ namespace bsim {
     return out;
   }
 
+  // Each bit is stored as one bit in a value plane and one bit in an
+  // unknown plane, using the quad_value encoding split across the planes:
+  //
+  //   value  unknown
+  //     0       0     -> 0
+  //     1       0     -> 1
+  //     0       1     -> x
+  //     1       1     -> z
+  //
+  // Both planes keep the bits past the end of the vector at zero. The
+  // planes come from the arena that was current when the vector was
+  // created, see bit_vector_arena.h, or from the heap.
   class quad_value_bit_vector {
-    std::vector<quad_value> bits;
+    // Value plane limbs followed by unknown plane limbs
+    std::vector<bv_uint64, arena_allocator<bv_uint64> > planes;
     int N;
 
-  public:
+    // Whether the unknown plane has any bit set, so that is_binary is a
+    // branch. Writes that may clear the last unknown bit mark the summary
+    // stale and the next is_binary rescans the plane. is_binary is const
+    // and may be called on a shared vector from several threads, so the
+    // summary it caches is a relaxed atomic.
+    enum plane_summary { SUMMARY_STALE, SUMMARY_BINARY, SUMMARY_UNKNOWN };
+    mutable std::atomic<plane_summary> summary{SUMMARY_BINARY};
 
-    quad_value_bit_vector() : N(0) {}
+    inline plane_summary load_summary() const {
+      return summary.load(std::memory_order_relaxed);
+    }
 
-    quad_value_bit_vector(const int N_) : N(N_) {
-      //bits.resize(NUM_BYTES(N));
-      bits.resize(N);
-      for (uint i = 0; i < ((uint) bits.size()); i++) {
-	bits[i] = quad_value(0);
-      }
-      
-      // for (int i = 0; i < N; i++) {
-      //   set(i, 0);
-      // }
+    inline void store_summary(const plane_summary s) const {
+      summary.store(s, std::memory_order_relaxed);
     }
 
-    quad_value_bit_vector(const std::string& str_raw) : N(0) {
-      std::string bv_size = "";
-      int ind = 0;
-      while (str_raw[ind] != '\'') {
-        assert(isdigit(str_raw[ind]));
-        bv_size += str_raw[ind];
-        ind++;
+    // The planes for a vector move constructed from one with planes p
+    static inline std::vector<bv_uint64, arena_allocator<bv_uint64> >
+    take_planes(std::vector<bv_uint64, arena_allocator<bv_uint64> >& p) {
+      if (in_current_arena(p.get_allocator())) {
+        return std::vector<bv_uint64, arena_allocator<bv_uint64> >(p, arena_allocator<bv_uint64>(nullptr));
       }
+      return std::move(p);
+    }
 
-      assert (str_raw[ind] == '\'');
-
-      ind++;
-
-      char format = str_raw[ind];
+    inline void decode_literal(const verilog_literal& lit) {
+      const bool has_unknown =
+        decode_verilog_literal(lit, planes.data(), planes.data() + NUM_WORDS(N));
+      store_summary(has_unknown ? SUMMARY_UNKNOWN : SUMMARY_BINARY);
+    }
 
-      assert((format == 'b') ||
-             (format == 'h') ||
-             (format == 'd'));
+    inline void note_unknown_write(const bv_uint64 old_bits,
+                                   const bv_uint64 new_bits) {
+      if (new_bits != 0) {
+        store_summary(SUMMARY_UNKNOWN);
+      } else if (old_bits != 0) {
+        store_summary(SUMMARY_STALE);
+      }
+    }
 
-      ind++;
+  public:
 
-      std::string digits = "";
-      while (ind < ((int) str_raw.size())) {
-        digits += str_raw[ind];
-        ind++;
-      }
+    quad_value_bit_vector() : N(0) {}
 
-      int num_bits = stoi(bv_size);
-      N = num_bits;
-      //bits.resize(NUM_BYTES(num_bits));
-      bits.resize(num_bits);
-      for (int i = 0; i < ((int) bits.size()); i++) {
-        bits[i] = 0;
+    quad_value_bit_vector(const int N_) : planes(2*NUM_WORDS(N_), 0), N(N_) {}
+
+    // A Verilog literal such as 8'b10xz_zz01, see verilog_literal.h
+    quad_value_bit_vector(const std::string& str) : N(0) {
+      const verilog_literal lit = parse_verilog_literal(str);
+      N = lit.width;
+      planes.resize(2*num_words());
+      decode_literal(lit);
+    }
+
+    // Binary, x and z digits, most significant first, zero extended to
+    // N_ bits
+    quad_value_bit_vector(const int N_, const std::string& str) : N(N_) {
+      planes.resize(2*num_words());
+      decode_literal(binary_digits_literal(N_, str));
+    }
+
+    // Only the low 32 bits of val are used, the rest of the vector is
+    // zero filled
+    quad_value_bit_vector(const int N_, const int val) :
+      quad_value_bit_vector(N_, val, arena_allocator<bv_uint64>()) {}
+
+    // As above with the planes from alloc rather than the current arena,
+    // arena_allocator<bv_uint64>(nullptr) for vectors that must outlive
+    // any arena
+    quad_value_bit_vector(const int N_,
+                          const int val,
+                          const arena_allocator<bv_uint64>& alloc) :
+      planes(2*NUM_WORDS(N_), 0, alloc), N(N_) {
+      if (N > 0) {
+        set_value_word(0, (bv_uint64) ((bv_uint32) val));
+        clear_tail();
       }
+    }
 
-      // TODO: Check that digits are not too long
-
-      assert(format == 'h');
-
-      int bit_ind = 0;
-      for (int i = digits.size() - 1; i >= 0; i--) {
-        char hex_digit = digits[i];
-        std::string hex_to_binary = hex_digit_to_binary(hex_digit);
-
-        assert(hex_to_binary.size() == 4);
-
-        int k = 0;
-        for (int j = hex_to_binary.size() - 1; j >= 0; j--) {
-          // Dont add past the end
-          if ((bit_ind + k) < bitLength()) {
-            //std::cout << "setting digit = " << hex_to_binary[j] << std::endl;
-            if (hex_to_binary[j] == '1') {
-              set(bit_ind + k, quad_value(1));
-            } else if (hex_to_binary[j] == '0') {
-              set(bit_ind + k, quad_value(0));
-            } else if (hex_to_binary[j] == 'x') {
-              set(bit_ind + k, quad_value(QBV_UNKNOWN_VALUE));
-            } else if (hex_to_binary[j] == 'z') {
-              set(bit_ind + k, quad_value(QBV_HIGH_IMPEDANCE_VALUE));
-            } else {
-              assert(false);
-            }
-            k++;
-          } else {
-            //assert(hex_to_binary[j] == '0');
-          }
-        }
-        bit_ind += 4;
-      }
+    // The binary digits, most significant first, as in binary_string.
+    // out needs room for binary_format_length(bitLength()) characters and
+    // is not null terminated. Returns the end of the output.
+    inline char* format_to(char* out) const {
+      return format_binary_limbs(out, value_data(), value_data() + num_words(), 0, N);
+    }
 
+    // The literal of hex_string, out needs room for
+    // hex_format_length(bitLength()) characters
+    inline char* format_hex_to(char* out) const {
+      return format_hex_limbs(format_width_prefix(out, N, 'h'),
+                              value_data(),
+                              value_data() + num_words(),
+                              N);
     }
 
-    quad_value_bit_vector(const int N_, const std::string& str_raw) : N(N_) {
-      int num_digits = 0;
-      std::string str;
-      for (int i = 0; i < ((int) str_raw.size()); i++) {
-	if (isdigit(str_raw[i])) {
-	  num_digits++;
-	  str += str_raw[i];
-	} else if (str_raw[i] == 'z') {
-          str += str_raw[i];
-        } else if (str_raw[i] == 'x') {
-          str += str_raw[i];
-        } else {
-	  assert(str_raw[i] == '_');
-	}
+    std::string hex_string() const {
+      std::string hex(hex_format_length(N), '0');
+      format_hex_to(&hex[0]);
+      return hex;
+    }
+
+    // The unsigned value in decimal, or one of x, X, z and Z when any bit
+    // is unknown, see unknown_decimal_char. out needs room for
+    // decimal_format_length(bitLength()) characters.
+    inline char* format_decimal_to(char* out) const {
+      if (!is_binary()) {
+        *out++ = unknown_decimal_char(value_data(), value_data() + num_words(), N);
+        return out;
       }
-      assert(num_digits <= N);
-
-      int len = str.size();      
+      return format_decimal_limbs(out, value_data(), num_words());
+    }
 
-      bits.resize(N);
-      for (int i = len - 1; i >= 0; i--) {
-        unsigned char val = (str[i] == '0') ? 0 : 1;
-        if (str[i] == 'x') {
-          val = QBV_UNKNOWN_VALUE;
-        }
-        if (str[i] == 'z') {
-          val = QBV_HIGH_IMPEDANCE_VALUE;
-        }
+    std::string to_decimal_string() const {
+      std::string str(decimal_format_length(N), '0');
+      str.resize(format_decimal_to(&str[0]) - &str[0]);
+      return str;
+    }
 
-        int ind = len - i - 1;
-        set(ind, val);
-      }
-      for (int i = N - 1; i >= len; i--) {
-        set(i,0);
-      }
+    // Binary records, see bit_serialization.h. The x/z plane is only
+    // written when the vector has unknown bits.
+    inline size_t serialized_size() const {
+      return serialized_record_size(N, !is_binary());
     }
 
-    quad_value_bit_vector(const int N_, const int val) : N(N_) {
-      //bits.resize(NUM_BYTES(N));
-      bits.resize(N);
+    // Writes serialized_size() bytes to out and returns their end
+    inline unsigned char* serialize_to(unsigned char* out) const {
+      return write_serial_record(out, N, value_data(),
+                                 is_binary() ? nullptr : value_data() + num_words());
+    }
 
-      for (int i = 0; i < N; i++) {
-        if (i < ((int) sizeof(int)*8)) {
-          set(i, quad_value((val >> i) & 0x01));
-        } else {
-          set(i, quad_value(0));
-        }
-      }
+    inline void serialize_to(std::vector<unsigned char>& buffer) const {
+      const size_t start = buffer.size();
+      buffer.resize(start + serialized_size());
+      serialize_to(&buffer[start]);
     }
 
-    // Note: Need to check that all digits in each clump that
-    // contain 'x' or 'z' values are 'x' or 'z' values
-    std::string hex_string() const {
-      std::string hex = std::to_string(N) + "'h";
-
-      std::string hex_digits = "";
-
-      for (int i = 0; i < ((int) bits.size()); i += 4) {
-        unsigned char bit_l = 0;
-        bool found_abnormal = false;
-
-        for (int j = 0; j < 4; j++) {
-          int index = i + j;
-          if (index >= ((int) bits.size())) {
-          } else {
-            if (bits[index].is_binary()) {
-              bit_l |= (bits[index].binary_value() & 0x01) << j;
-            } else if (bits[index].is_unknown()) {
-              bit_l = 'x';
-              found_abnormal = true;
-              break;
-            } else {
-              assert(bits[index].is_high_impedance());
-              bit_l = 'z';
-              found_abnormal = true;
-              break;
-            }
-          }
-        }
+    // Reads the record at the front of in, taking its width, and consumes
+    // it. Fails, leaving both unchanged, when the record is incomplete.
+    inline bool deserialize_from(byte_span& in) {
+      int width;
+      bool has_unknown;
+      if (!read_serial_header(in, &width, &has_unknown)) {
+        return false;
+      }
 
-        if (!found_abnormal) {
-          hex_digits += bit_l > 9 ? bit_l + 87 : bit_l + 48;
-        } else {
-          hex_digits += bit_l;
-        }
+      if (width != N) {
+        planes.assign(2*NUM_WORDS(width), 0);
+        N = width;
+      }
 
+      const unsigned char* limbs = in.data + BV_SERIAL_HEADER_BYTES;
+      read_serial_limbs(value_data(), limbs, num_words());
+      if (has_unknown) {
+        read_serial_limbs(value_data() + num_words(),
+                          limbs + sizeof(bv_uint64)*num_words(),
+                          num_words());
+        store_summary(SUMMARY_STALE);
+      } else {
+        std::fill(planes.begin() + num_words(), planes.end(), 0);
+        store_summary(SUMMARY_BINARY);
       }
+      clear_tail();
 
-      std::reverse(std::begin(hex_digits), std::end(hex_digits));
-      return hex + hex_digits;
+      in.advance(serialized_record_size(width, has_unknown));
+      return true;
     }
     
-    quad_value_bit_vector(const quad_value_bit_vector& other) {
-      bits.resize(other.bits.size());
-      N = other.bitLength();
+    quad_value_bit_vector(const quad_value_bit_vector& other) :
+      planes(other.planes), N(other.N), summary(other.load_summary()) {}
 
-      for (int i = 0; i < other.bitLength(); i++) {
-	bits[i] = other.bits[i];
-      }
+    // Moving steals the limbs, leaving other as an empty zero width
+    // vector. Planes from the current arena are copied to the heap
+    // instead, as for dynamic_bit_vector.
+    quad_value_bit_vector(quad_value_bit_vector&& other) noexcept :
+      planes(take_planes(other.planes)), N(other.N), summary(other.load_summary()) {
+      other.planes.clear();
+      other.N = 0;
+      other.store_summary(SUMMARY_BINARY);
     }
 
     quad_value_bit_vector& operator=(const quad_value_bit_vector& other) {
@@ -472,33 +440,54 @@ namespace bsim {
     	return *this;
       }
 
-      bits.resize(other.bits.size());
-
+      planes = other.planes;
       N = other.bitLength();
+      store_summary(other.load_summary());
 
-      for (int i = 0; i < other.bitLength(); i++) {
-        bits[i] = other.bits[i];
+      return *this;
+    }
+
+    // Planes are only stolen from a vector with the same allocator,
+    // otherwise they are copied, which terminates if it runs out of
+    // memory, as for dynamic_bit_vector
+    quad_value_bit_vector& operator=(quad_value_bit_vector&& other) noexcept {
+      if (&other == this) {
+    	return *this;
+      }
+
+      if (planes.get_allocator() != other.planes.get_allocator()) {
+        return *this = other;
       }
 
+      planes.swap(other.planes);
+      N = other.N;
+      store_summary(other.load_summary());
+
+      other.planes.clear();
+      other.N = 0;
+      other.store_summary(SUMMARY_BINARY);
+
       return *this;
     }
 
     bool is_binary() const {
-      for (int i = 0; i < ((int) bitLength()); i++) {
-        if (!get(i).is_binary()) {
-          return false;
+      plane_summary s = load_summary();
+      if (s == SUMMARY_STALE) {
+        s = SUMMARY_BINARY;
+        for (int i = 0; i < num_words(); i++) {
+          if (get_unknown_word(i) != 0) {
+            s = SUMMARY_UNKNOWN;
+            break;
+          }
         }
+        store_summary(s);
       }
-      return true;
+      return s == SUMMARY_BINARY;
     }
     
     std::string binary_string() const {
-      std::string str = "";
-      const int N = bitLength();
-      for (int i = N - 1; i >= 0; i--) {
-        str += get(i).binary_string();
-      }
-
+      std::string str(binary_format_length(N), '0');
+      format_to(&str[0]);
       return str;
     }
     
@@ -508,29 +497,86 @@ namespace bsim {
       // }
       // assert((v == 0) || (v == 1));
 
-      bits[ind] = quad_value(v);
+      set(ind, quad_value(v));
     }
 
     inline void set(const int ind, const quad_value val) {
-      //const unsigned char val) {
-      // int byte_num = ind / 8;
-      // int bit_num = ind % 8;
+      const int word_num = ind / BV_WORD_BITS;
+      const bv_uint64 bit = ((bv_uint64) 1) << (ind % BV_WORD_BITS);
+      const unsigned char c = val.get_char();
 
-      // unsigned char old = bits[byte_num];
-      // // The & 0x01 only seems to be needed for logical not
-      // old ^= (-(val & 0x01) ^ old) & (1 << bit_num);
+      bv_uint64& v = planes[word_num];
+      bv_uint64& u = planes[num_words() + word_num];
 
-      //bits[byte_num] = old;
-      bits[ind] = val;
+      note_unknown_write(u & bit, c & 0x02);
+
+      v = (c & 0x01) ? (v | bit) : (v & ~bit);
+      u = (c & 0x02) ? (u | bit) : (u & ~bit);
     }
 
     quad_value get(const int ind) const {
-      return bits[ind];
-      // int byte_num = ind / 8;
-      // int bit_num = ind % 8;
+      const int word_num = ind / BV_WORD_BITS;
+      const int bit_num = ind % BV_WORD_BITS;
+
+      unsigned char v = (get_value_word(word_num) >> bit_num) & 0x01;
+      unsigned char u = (get_unknown_word(word_num) >> bit_num) & 0x01;
+      return quad_value(v | (u << 1));
+    }
 
-      // unsigned char target_byte = bits[byte_num];
-      // return 0x01 & (target_byte >> bit_num);
+    inline int num_words() const {
+      return NUM_WORDS(N);
+    }
+
+    inline bv_uint64 get_value_word(const int i) const {
+      return planes[i];
+    }
+
+    inline bv_uint64 get_unknown_word(const int i) const {
+      return planes[num_words() + i];
+    }
+
+    // Note: Callers writing the top word are responsible for keeping
+    // the bits past the end of the vector at zero, see clear_tail
+    inline void set_value_word(const int i, const bv_uint64 w) {
+      planes[i] = w;
+    }
+
+    inline void set_unknown_word(const int i, const bv_uint64 w) {
+      note_unknown_write(planes[num_words() + i], w);
+      planes[num_words() + i] = w;
+    }
+
+    // The value plane limbs, least significant first, for the kernels in
+    // limb_operations.h
+    inline const bv_uint64* value_data() const {
+      return planes.data();
+    }
+
+    inline bv_uint64* value_data() {
+      return planes.data();
+    }
+
+    inline const bv_uint64* unknown_data() const {
+      return planes.data() + num_words();
+    }
+
+    // Overwrites every bit with x, keeping the storage
+    inline void set_unknown() {
+      for (int i = 0; i < num_words(); i++) {
+        set_value_word(i, 0);
+        set_unknown_word(i, ~((bv_uint64) 0));
+      }
+      clear_tail();
+    }
+
+    inline void clear_tail() {
+      if (N > 0) {
+        const bv_uint64 mask = top_word_mask(N);
+        planes[num_words() - 1] &= mask;
+        bv_uint64& u = planes[2*num_words() - 1];
+        note_unknown_write(u, u & mask);
+        u &= mask;
+      }
     }
 
     inline bool equals(const quad_value_bit_vector& other) const {
@@ -539,8 +585,18 @@ namespace bsim {
         return false;
       }
 
-      for (int i = 0; i < N; i++) {
-	if (get(i) != other.get(i)) {
+      for (int i = 0; i < num_words(); i++) {
+        bv_uint64 a_u = get_unknown_word(i);
+        bv_uint64 b_u = other.get_unknown_word(i);
+
+        // Unknown values are never equal to anything
+        if (((a_u & ~get_value_word(i)) != 0) ||
+            ((b_u & ~other.get_value_word(i)) != 0)) {
+          return false;
+        }
+
+	if ((a_u != b_u) ||
+            (get_value_word(i) != other.get_value_word(i))) {
 	  return false;
 	}
       }
@@ -548,19 +604,18 @@ namespace bsim {
       return true;
     }
 
+    bool same_representation(const quad_value_bit_vector& other) const {
+      return (N == other.N) && (planes == other.planes);
+    }
+
     template<typename ConvType>
     ConvType to_type() const {
-      ConvType tmp = 0;
-      ConvType exp = 1;
-      for (int i = 0; i < bitLength(); i++) {
-        tmp += exp*get(i).binary_value();
-        exp *= 2;
+      assert(is_binary());
+
+      if (N == 0) {
+        return 0;
       }
-      return tmp;
-      // ConvType tmp = *(const_cast<ConvType*>((const ConvType*) (&(bits[0]))));
-      // //TODO FIXME I am a sketchy hack.
-      // ConvType mask = sizeof(ConvType) > bits.size() ? (1<<N)-1 : -1; 
-      // return tmp & mask;
+      return (ConvType) get_value_word(0);
     }
 
     inline bv_uint64 as_native_int32() const {
@@ -591,33 +646,24 @@ namespace bsim {
 
   static inline bool same_representation(const quad_value_bit_vector& a,
                            const quad_value_bit_vector& b) {
-    if (a.bitLength() != b.bitLength()) {
-      return false;
-    }
-
-    for (int i = 0; i < ((int) a.bitLength()); i++) {
-      quad_value av = a.get(i);
-      quad_value bv = b.get(i);
-      if (!av.same_representation(bv)) {
-        return false;
-      }
-    }
-    return true;
+    return a.same_representation(b);
   }
 
   static inline quad_value_bit_vector unknown_bv(const int len) {
-    std::string str = "";
-    for (int i = 0; i < len; i++) {
-      str += "x";
+    quad_value_bit_vector res(len);
+    for (int i = 0; i < res.num_words(); i++) {
+      res.set_unknown_word(i, ~((bv_uint64) 0));
     }
-    return quad_value_bit_vector(len, str);
+    res.clear_tail();
+    return res;
   }
 
   static inline std::ostream& operator<<(std::ostream& out,
 					 const quad_value_bit_vector& a) {
-    out << a.binary_string();
-
-    return out;
+    return write_binary_limbs(out,
+                              a.value_data(),
+                              a.value_data() + a.num_words(),
+                              a.bitLength());
   }
 
   static inline bool operator==(const quad_value_bit_vector& a,
@@ -634,32 +680,32 @@ namespace bsim {
     return a.get(a.bitLength() - 1);
   }
 
+  // The arithmetic operations scan the unknown planes first. Any x or z
+  // bit in an operand makes the whole result x, otherwise the value planes
+  // go through the same limb kernels as two state vectors.
+  static inline bool binary_operands(const quad_value_bit_vector& a,
+                                     const quad_value_bit_vector& b) {
+    return a.is_binary() && b.is_binary();
+  }
+
   static inline
   quad_value_bit_vector
   add_general_width_bv(const quad_value_bit_vector& a,
   		       const quad_value_bit_vector& b) {
+    assert(a.bitLength() == b.bitLength());
 
-    quad_value_bit_vector res(a.bitLength());
-    unsigned char carry = 0;
-    for (int i = 0; i < ((int) a.bitLength()); i++) {
-
-      if (!a.get(i).is_binary() ||
-          !b.get(i).is_binary()) {
-        return unknown_bv(a.bitLength());
-      }
-
-      unsigned char sum = a.get(i).binary_value() + b.get(i).binary_value() + carry;
-
-      carry = 0;
-
-      unsigned char z_i = sum & 0x01;
-      res.set(i, quad_value(z_i));
-
-      if (sum >= 2) {
-  	carry = 1;
-      }
+    if (!binary_operands(a, b)) {
+      return unknown_bv(a.bitLength());
+    }
 
+    quad_value_bit_vector res(a.bitLength());
+    bv_uint64 carry = 0;
+    for (int i = 0; i < a.num_words(); i++) {
+      bv_uint64 sum;
+      carry = add_with_carry(a.get_value_word(i), b.get_value_word(i), carry, &sum);
+      res.set_value_word(i, sum);
     }
+    res.clear_tail();
 
     return res;
   }
@@ -668,71 +714,73 @@ namespace bsim {
   quad_value_bit_vector
   sub_general_width_bv(const quad_value_bit_vector& a,
   		       const quad_value_bit_vector& b) {
-    int Width = a.bitLength();
-    quad_value_bit_vector diff(a.bitLength());
-    quad_value_bit_vector a_cpy = a;
+    assert(a.bitLength() == b.bitLength());
 
-    for (int i = 0; i < Width; i++) {
+    if (!binary_operands(a, b)) {
+      return unknown_bv(a.bitLength());
+    }
 
-      if ((a_cpy.get(i) == 0) &&
-  	  (b.get(i) == 1)) {
+    quad_value_bit_vector diff(a.bitLength());
+    bv_uint64 borrow = 0;
+    for (int i = 0; i < a.num_words(); i++) {
+      bv_uint64 d;
+      borrow = sub_with_borrow(a.get_value_word(i), b.get_value_word(i), borrow, &d);
+      diff.set_value_word(i, d);
+    }
+    diff.clear_tail();
 
-  	int j = i + 1;
+    return diff;
+  }    
 
-  	diff.set(i, 1);	  
+  // In place updates of a, these back the compound assignment operators
+  // and reuse a's planes. Like add and sub, any unknown bit in either
+  // operand makes the whole result unknown.
+  static inline void add_in_place(quad_value_bit_vector& a,
+                                  const quad_value_bit_vector& b) {
+    assert(a.bitLength() == b.bitLength());
 
-  	// Modify to carry
-  	while ((j < Width) && (a_cpy.get(j) != 1)) {
-  	  a_cpy.set(j, 1);
-  	  j++;
-  	}
+    if (!binary_operands(a, b)) {
+      a.set_unknown();
+      return;
+    }
 
-  	if (j >= Width) {
-  	} else {
-  	  a_cpy.set(j, 0);
-  	}
+    add_limbs_into(a.value_data(), a.num_words(), b.value_data(), b.num_words());
+    a.clear_tail();
+  }
 
-      } else if (a_cpy.get(i) == b.get(i)) {
-  	diff.set(i, 0);
-      } else if ((a_cpy.get(i) == 1) &&
-  		 (b.get(i) == 0)) {
-  	diff.set(i, 1);
-      } else {
-        return unknown_bv(a.bitLength());
-      }
+  static inline void sub_in_place(quad_value_bit_vector& a,
+                                  const quad_value_bit_vector& b) {
+    assert(a.bitLength() == b.bitLength());
+
+    if (!binary_operands(a, b)) {
+      a.set_unknown();
+      return;
     }
 
-    return diff;
-  }    
+    sub_limbs_from(a.value_data(), a.num_words(), b.value_data(), b.num_words());
+    a.clear_tail();
+  }
 
   static inline
   quad_value_bit_vector
   mul_general_width_bv(const quad_value_bit_vector& a,
   		       const quad_value_bit_vector& b) {
-    int Width = a.bitLength();
-    quad_value_bit_vector full_len(2*Width);
-
-    for (int i = 0; i < Width; i++) {
-      if (b.get(i) == 1) {
-
-  	quad_value_bit_vector shifted_a(2*Width);
-
-  	for (int j = 0; j < Width; j++) {
-  	  shifted_a.set(j + i, a.get(j));
-  	}
+    assert(a.bitLength() == b.bitLength());
 
-  	full_len =
-  	  add_general_width_bv(full_len, shifted_a);
-      }
+    if (!binary_operands(a, b)) {
+      return unknown_bv(a.bitLength());
     }
 
-    quad_value_bit_vector res(Width);
-    for (int i = 0; i < Width; i++) {
-      res.set(i, full_len.get(i));
+    quad_value_bit_vector res(a.bitLength());
+    if (res.num_words() > 0) {
+      mul_limbs_low(res.value_data(), a.value_data(), b.value_data(), a.num_words());
+      res.clear_tail();
     }
     return res;
   }    
   
+  // The logic operations treat high impedance inputs like unknowns, so
+  // any bit they cannot decide comes out as x
   class quad_value_bit_vector_operations {
   public:
 
@@ -741,18 +789,33 @@ namespace bsim {
     land(const quad_value_bit_vector& a,
   	 const quad_value_bit_vector& b) {
       quad_value_bit_vector a_and_b(a.bitLength());
-      for (int i = 0; i < a.bitLength(); i++) {
-  	a_and_b.set(i, a.get(i) & b.get(i));
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 av = a.get_value_word(i);
+        bv_uint64 au = a.get_unknown_word(i);
+        bv_uint64 bv = b.get_value_word(i);
+        bv_uint64 bu = b.get_unknown_word(i);
+
+        // A known zero on either side forces a known zero
+        bv_uint64 zeros = (~av & ~au) | (~bv & ~bu);
+        bv_uint64 unk = (au | bu) & ~zeros;
+
+  	a_and_b.set_value_word(i, av & bv & ~(au | bu));
+  	a_and_b.set_unknown_word(i, unk);
       }
+      a_and_b.clear_tail();
       return a_and_b;
 
     }
 
     static inline quad_value_bit_vector lnot(const quad_value_bit_vector& a) {
       quad_value_bit_vector not_a(a.bitLength());
-      for (int i = 0; i < a.bitLength(); i++) {
-  	not_a.set(i, ~a.get(i));
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 au = a.get_unknown_word(i);
+
+  	not_a.set_value_word(i, ~a.get_value_word(i) & ~au);
+  	not_a.set_unknown_word(i, au);
       }
+      not_a.clear_tail();
       return not_a;
 
     }
@@ -760,8 +823,15 @@ namespace bsim {
     static inline quad_value_bit_vector lor(const quad_value_bit_vector& a,
 					 const quad_value_bit_vector& b) {
       quad_value_bit_vector a_or_b(a.bitLength());
-      for (int i = 0; i < a.bitLength(); i++) {
-  	a_or_b.set(i, a.get(i) | b.get(i));
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 au = a.get_unknown_word(i);
+        bv_uint64 bu = b.get_unknown_word(i);
+
+        // A known one on either side forces a known one
+        bv_uint64 ones = (a.get_value_word(i) & ~au) | (b.get_value_word(i) & ~bu);
+
+  	a_or_b.set_value_word(i, ones);
+  	a_or_b.set_unknown_word(i, (au | bu) & ~ones);
       }
       return a_or_b;
     }
@@ -771,12 +841,59 @@ namespace bsim {
     lxor(const quad_value_bit_vector& a,
   	 const quad_value_bit_vector& b) {
       quad_value_bit_vector a_or_b(a.bitLength());
-      for (int i = 0; i < a.bitLength(); i++) {
-  	a_or_b.set(i, a.get(i) ^ b.get(i));
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 unk = a.get_unknown_word(i) | b.get_unknown_word(i);
+
+  	a_or_b.set_value_word(i, (a.get_value_word(i) ^ b.get_value_word(i)) & ~unk);
+  	a_or_b.set_unknown_word(i, unk);
       }
       return a_or_b;
 
     }
+
+    static inline void land_in_place(quad_value_bit_vector& a,
+                                     const quad_value_bit_vector& b) {
+      assert(a.bitLength() == b.bitLength());
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 av = a.get_value_word(i);
+        bv_uint64 au = a.get_unknown_word(i);
+        bv_uint64 bv = b.get_value_word(i);
+        bv_uint64 bu = b.get_unknown_word(i);
+
+        // A known zero on either side forces a known zero
+        bv_uint64 zeros = (~av & ~au) | (~bv & ~bu);
+
+  	a.set_value_word(i, av & bv & ~(au | bu));
+  	a.set_unknown_word(i, (au | bu) & ~zeros);
+      }
+      a.clear_tail();
+    }
+
+    static inline void lor_in_place(quad_value_bit_vector& a,
+                                    const quad_value_bit_vector& b) {
+      assert(a.bitLength() == b.bitLength());
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 au = a.get_unknown_word(i);
+        bv_uint64 bu = b.get_unknown_word(i);
+
+        // A known one on either side forces a known one
+        bv_uint64 ones = (a.get_value_word(i) & ~au) | (b.get_value_word(i) & ~bu);
+
+  	a.set_value_word(i, ones);
+  	a.set_unknown_word(i, (au | bu) & ~ones);
+      }
+    }
+
+    static inline void lxor_in_place(quad_value_bit_vector& a,
+                                     const quad_value_bit_vector& b) {
+      assert(a.bitLength() == b.bitLength());
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 unk = a.get_unknown_word(i) | b.get_unknown_word(i);
+
+  	a.set_value_word(i, (a.get_value_word(i) ^ b.get_value_word(i)) & ~unk);
+  	a.set_unknown_word(i, unk);
+      }
+    }
     
   };
 
@@ -806,6 +923,36 @@ namespace bsim {
     return quad_value_bit_vector_operations::lxor(a, b);
   }
 
+  static inline quad_value_bit_vector& operator&=(quad_value_bit_vector& a,
+						  const quad_value_bit_vector& b) {
+    quad_value_bit_vector_operations::land_in_place(a, b);
+    return a;
+  }
+
+  static inline quad_value_bit_vector& operator|=(quad_value_bit_vector& a,
+						  const quad_value_bit_vector& b) {
+    quad_value_bit_vector_operations::lor_in_place(a, b);
+    return a;
+  }
+
+  static inline quad_value_bit_vector& operator^=(quad_value_bit_vector& a,
+						  const quad_value_bit_vector& b) {
+    quad_value_bit_vector_operations::lxor_in_place(a, b);
+    return a;
+  }
+
+  static inline quad_value_bit_vector& operator+=(quad_value_bit_vector& a,
+						  const quad_value_bit_vector& b) {
+    add_in_place(a, b);
+    return a;
+  }
+
+  static inline quad_value_bit_vector& operator-=(quad_value_bit_vector& a,
+						  const quad_value_bit_vector& b) {
+    sub_in_place(a, b);
+    return a;
+  }
+
   static inline bool operator!=(const quad_value_bit_vector& a,
   				const quad_value_bit_vector& b) {
     // if (!a.is_binary() || !b.is_binary()) {
@@ -821,13 +968,12 @@ namespace bsim {
       return false;
     }
 
-    int N = a.bitLength();
-    for (int i = N - 1; i >= 0; i--) {
-      if (a.get(i) > b.get(i)) {
+    for (int i = a.num_words() - 1; i >= 0; i--) {
+      if (a.get_value_word(i) > b.get_value_word(i)) {
   	return true;
       }
 
-      if (a.get(i) < b.get(i)) {
+      if (a.get_value_word(i) < b.get_value_word(i)) {
   	return false;
       }
     }
@@ -855,42 +1001,95 @@ namespace bsim {
     return !(a > b);
   }
 
-  static inline quad_value_bit_vector
-  andr(const quad_value_bit_vector& a) {
-    for (int i = 0; i < a.bitLength(); i++) {
-      if (a.get(i) != 1) {
-	return quad_value_bit_vector(1, "0");
+  // The 1 bit results of the reductions, built once instead of on
+  // every call. They live on the heap, the first call may be inside an
+  // arena_scope.
+  static inline const quad_value_bit_vector& quad_bit_constant(const bool b) {
+    static const quad_value_bit_vector zero(1, 0, arena_allocator<bv_uint64>(nullptr));
+    static const quad_value_bit_vector one(1, 1, arena_allocator<bv_uint64>(nullptr));
+    return b ? one : zero;
+  }
+
+  // The bit scans look at the known ones, x and z bits count as unset
+  static inline bv_uint64 known_ones_word(const quad_value_bit_vector& a,
+                                          const int i) {
+    return a.get_value_word(i) & ~a.get_unknown_word(i);
+  }
+
+  static inline int popcount(const quad_value_bit_vector& a) {
+    int count = 0;
+    for (int i = 0; i < a.num_words(); i++) {
+      count += popcount_word(known_ones_word(a, i));
+    }
+    return count;
+  }
+
+  // Index of the lowest known one at or above from, or -1
+  static inline int find_next_set(const quad_value_bit_vector& a, int from) {
+    if (from < 0) {
+      from = 0;
+    }
+
+    int i = from / BV_WORD_BITS;
+    if (i >= a.num_words()) {
+      return -1;
+    }
+
+    bv_uint64 word = known_ones_word(a, i) & (~((bv_uint64) 0) << (from % BV_WORD_BITS));
+    while (word == 0) {
+      i++;
+      if (i == a.num_words()) {
+        return -1;
       }
+      word = known_ones_word(a, i);
     }
 
-    return quad_value_bit_vector(1, "1");
+    return i*BV_WORD_BITS + count_trailing_zeros_word(word);
   }
 
-  static inline quad_value_bit_vector
-  orr(const quad_value_bit_vector& a) {
-    for (int i = 0; i < a.bitLength(); i++) {
-      if (a.get(i) == 1) {
-	return quad_value_bit_vector(1, "1");
+  static inline int find_first_set(const quad_value_bit_vector& a) {
+    return find_next_set(a, 0);
+  }
+
+  static inline int find_last_set(const quad_value_bit_vector& a) {
+    for (int i = a.num_words() - 1; i >= 0; i--) {
+      const bv_uint64 word = known_ones_word(a, i);
+      if (word != 0) {
+        return i*BV_WORD_BITS + (BV_WORD_BITS - 1) - count_leading_zeros_word(word);
       }
     }
+    return -1;
+  }
+
+  static inline int count_leading_zeros(const quad_value_bit_vector& a) {
+    return a.bitLength() - 1 - find_last_set(a);
+  }
 
-    return quad_value_bit_vector(1, "0");
+  static inline int count_trailing_zeros(const quad_value_bit_vector& a) {
+    int first = find_first_set(a);
+    return first < 0 ? a.bitLength() : first;
   }
 
+  // Reductions only count bits that are known ones
   static inline quad_value_bit_vector
-  xorr(const quad_value_bit_vector& a) {
-    int numSet = 0;
-    for (int i = 0; i < a.bitLength(); i++) {
-      if (a.get(i) == 1) {
-	numSet++;
+  andr(const quad_value_bit_vector& a) {
+    return quad_bit_constant(popcount(a) == a.bitLength());
+  }
+
+  static inline quad_value_bit_vector
+  orr(const quad_value_bit_vector& a) {
+    for (int i = 0; i < a.num_words(); i++) {
+      if (known_ones_word(a, i) != 0) {
+	return quad_bit_constant(true);
       }
     }
 
-    if ((numSet % 2) == 0) {
-      return quad_value_bit_vector(1, "0");
-    }
+    return quad_bit_constant(false);
+  }
 
-    return quad_value_bit_vector(1, "1");
+  static inline quad_value_bit_vector
+  xorr(const quad_value_bit_vector& a) {
+    return quad_bit_constant((popcount(a) & 1) == 1);
   }
   
   static inline bool
@@ -915,20 +1114,9 @@ namespace bsim {
       return true;
     }
 
-    // Both negative or both non-negative
-    //if ((a.get(N - 1) == 1) && (b.get(N - 1) == 1)) {
-
-    for (int i = N - 2; i >= 0; i--) {
-      if (a.get(i) > b.get(i)) {
-  	return true;
-      }
-
-      if (a.get(i) < b.get(i)) {
-  	return false;
-      }
-    }
-
-    return false;
+    // Both negative or both non-negative, the sign bits match so an
+    // unsigned comparison of the limbs gives the answer
+    return a > b;
 
   }
 
@@ -937,108 +1125,237 @@ namespace bsim {
     return (signed_gt(a, b)) || (a == b);
   }
 
+  // Shift distances too large for 64 bits saturate, they move every bit
+  // out of the vector anyway
   static inline
   bv_uint64 get_shift_int(const quad_value_bit_vector& shift_amount) {
-    bv_uint64 shift_int = 0;
-    if (shift_amount.bitLength() > 64) {
-      assert(false);
+    for (int i = 1; i < shift_amount.num_words(); i++) {
+      if (shift_amount.get_value_word(i) != 0) {
+        return ~((bv_uint64) 0);
+      }
     }
 
-    else if (shift_amount.bitLength() > 32) {
-      shift_int = shift_amount.to_type<bv_uint64>();
-    }
+    return shift_amount.num_words() == 0 ? 0 : shift_amount.get_value_word(0);
+  }
 
-    else if (shift_amount.bitLength() > 16) {
-      shift_int = (bv_uint64) (shift_amount.to_type<bv_uint32>());
+  // The shifts write the value plane of the result straight from the
+  // operand's limbs, an operand with unknown bits gives all unknown
+  static inline
+  quad_value_bit_vector
+  lshr(const quad_value_bit_vector& a,
+       const quad_value_bit_vector& shift_amount) {
+
+    if (!a.is_binary() || !shift_amount.is_binary()) {
+      return unknown_bv(a.bitLength());
     }
 
-    else if (shift_amount.bitLength() > 8) {
-      shift_int = (bv_uint64) (shift_amount.to_type<bv_uint16>());
-    } else {
-      shift_int = (bv_uint64) (shift_amount.to_type<bv_uint8>());
+    quad_value_bit_vector res(a.bitLength());
+    if (a.bitLength() == 0) {
+      return res;
     }
 
-    //std::cout << "shift_int = " << shift_int << std::endl;
-    assert(shift_int < 65);
+    shift_right_limbs(res.value_data(), a.value_data(), a.num_words(),
+                      get_shift_int(shift_amount), 0);
 
-    return shift_int;
+    return res;
   }
 
-  static inline quad_value_bit_vector
-  lshr(const quad_value_bit_vector& a,
+  // Arithmetic shift right
+  static inline
+  quad_value_bit_vector
+  ashr(const quad_value_bit_vector& a,
        const quad_value_bit_vector& shift_amount) {
 
     if (!a.is_binary() || !shift_amount.is_binary()) {
       return unknown_bv(a.bitLength());
     }
     
-    quad_value_bit_vector res(a.bitLength());
-
-    bv_uint64 shift_int = get_shift_int(shift_amount);
-
-    if (shift_int == 0) {
+    if (a.bitLength() == 0) {
       return a;
     }
 
-    //unsigned char sign_bit = a.get(a.bitLength() - 1);
-    for (int i = a.bitLength() - 1; i >= (int) shift_int; i--) {
-      res.set(i - shift_int, a.get(i));
+    // Sign extend through the top limb of a copy so the funnel shift
+    // pulls in copies of the sign bit
+    const int n = a.num_words();
+    const bool negative = a.get(a.bitLength() - 1) == quad_value(1);
+    quad_value_bit_vector res(a);
+    if (negative) {
+      res.value_data()[n - 1] |= ~top_word_mask(a.bitLength());
     }
 
-    for (int i = a.bitLength() - 1; i >= (((int) a.bitLength()) - ((int) shift_int)); i--) {
-      res.set(i, 0);
-    }
+    shift_right_limbs(res.value_data(), res.value_data(), n,
+                      get_shift_int(shift_amount),
+                      negative ? ~((bv_uint64) 0) : 0);
+    res.clear_tail();
 
     return res;
   }
-
-  // Arithmetic shift right
+  
   static inline
   quad_value_bit_vector
-  ashr(const quad_value_bit_vector& a,
-       const quad_value_bit_vector& shift_amount) {
+  shl(const quad_value_bit_vector& a,
+      const quad_value_bit_vector& shift_amount) {
 
     if (!a.is_binary() || !shift_amount.is_binary()) {
       return unknown_bv(a.bitLength());
     }
-    
-    if (shift_amount == quad_value_bit_vector(shift_amount.bitLength(), 0)) {
+
+    quad_value_bit_vector res(a.bitLength());
+    if (a.bitLength() == 0) {
+      return res;
+    }
+
+    shift_left_limbs(res.value_data(), a.value_data(), a.num_words(),
+                     get_shift_int(shift_amount));
+    res.clear_tail();
+
+    return res;
+  }
+
+  // In place shifts of the value plane, an operand with unknown bits
+  // becomes all unknown
+  static inline void shl_in_place(quad_value_bit_vector& a,
+                                  const bv_uint64 shift) {
+    if (!a.is_binary()) {
+      a.set_unknown();
+      return;
+    }
+
+    shift_left_limbs(a.value_data(), a.value_data(), a.num_words(), shift);
+    a.clear_tail();
+  }
+
+  static inline void lshr_in_place(quad_value_bit_vector& a,
+                                   const bv_uint64 shift) {
+    if (!a.is_binary()) {
+      a.set_unknown();
+      return;
+    }
+
+    shift_right_limbs(a.value_data(), a.value_data(), a.num_words(), shift, 0);
+  }
+
+  static inline quad_value_bit_vector& operator<<=(quad_value_bit_vector& a,
+						   const quad_value_bit_vector& shift_amount) {
+    if (!shift_amount.is_binary()) {
+      a.set_unknown();
       return a;
     }
 
-    quad_value_bit_vector res(a.bitLength());
+    shl_in_place(a, get_shift_int(shift_amount));
+    return a;
+  }
 
-    bv_uint64 shift_int = get_shift_int(shift_amount);
+  static inline quad_value_bit_vector& operator<<=(quad_value_bit_vector& a,
+						   const int shift) {
+    assert(shift >= 0);
+    shl_in_place(a, shift);
+    return a;
+  }
 
-    quad_value sign_bit = a.get(a.bitLength() - 1);
-    for (uint i = a.bitLength() - 1; i >= shift_int; i--) {
-      res.set(i - shift_int, a.get(i));
+  static inline quad_value_bit_vector& operator>>=(quad_value_bit_vector& a,
+						   const quad_value_bit_vector& shift_amount) {
+    if (!shift_amount.is_binary()) {
+      a.set_unknown();
+      return a;
     }
 
-    int last_index = (int)a.bitLength() - shift_int;
-    for (int i = a.bitLength() - 1; i >= last_index && i >= 0; i--) {
-      res.set(i, sign_bit);
+    lshr_in_place(a, get_shift_int(shift_amount));
+    return a;
+  }
+
+  static inline quad_value_bit_vector& operator>>=(quad_value_bit_vector& a,
+						   const int shift) {
+    assert(shift >= 0);
+    lshr_in_place(a, shift);
+    return a;
+  }
+
+  // a rotated left by rot < width bits, a must be binary
+  static inline
+  quad_value_bit_vector
+  rotate_left_by(const quad_value_bit_vector& a, const bv_uint64 rot) {
+    const int n = a.num_words();
+    quad_value_bit_vector res(a.bitLength());
+
+    shift_left_limbs(res.value_data(), a.value_data(), n, rot);
+    for (int i = 0; i < n; i++) {
+      res.value_data()[i] |= shifted_right_limb(a.value_data(), n, a.bitLength() - rot, i);
     }
+    res.clear_tail();
 
     return res;
   }
-  
+
+  // Rotates by any distance, the distance is reduced modulo the width
   static inline
   quad_value_bit_vector
-  shl(const quad_value_bit_vector& a,
-      const quad_value_bit_vector& shift_amount) {
+  rotate_left(const quad_value_bit_vector& a,
+              const quad_value_bit_vector& rotate_amount) {
 
-    if (!a.is_binary() || !shift_amount.is_binary()) {
+    if (!a.is_binary() || !rotate_amount.is_binary()) {
       return unknown_bv(a.bitLength());
     }
 
-    quad_value_bit_vector res(a.bitLength());
+    if ((a.bitLength() == 0) || (rotate_amount.bitLength() == 0)) {
+      return a;
+    }
+
+    return rotate_left_by(a, mod_limbs_word(rotate_amount.value_data(),
+                                            rotate_amount.num_words(),
+                                            a.bitLength()));
+  }
 
-    bv_uint64 shift_int = get_shift_int(shift_amount);    
-    for (int i = shift_int; i < a.bitLength(); i++) {
-      res.set(i, a.get(i - shift_int));
+  static inline
+  quad_value_bit_vector
+  rotate_right(const quad_value_bit_vector& a,
+               const quad_value_bit_vector& rotate_amount) {
+
+    if (!a.is_binary() || !rotate_amount.is_binary()) {
+      return unknown_bv(a.bitLength());
+    }
+
+    if ((a.bitLength() == 0) || (rotate_amount.bitLength() == 0)) {
+      return a;
     }
 
+    const bv_uint64 rot = mod_limbs_word(rotate_amount.value_data(),
+                                         rotate_amount.num_words(),
+                                         a.bitLength());
+    return rotate_left_by(a, rot == 0 ? 0 : a.bitLength() - rot);
+  }
+
+  // Views of bits [start, end) of both planes of a, see bit_span.h
+  static inline quad_bit_span<quad_value_bit_vector>
+  span(quad_value_bit_vector& a, const int start, const int end) {
+    assert((0 <= start) && (start <= end) && (end <= a.bitLength()));
+    return quad_bit_span<quad_value_bit_vector>(a, start, end - start);
+  }
+
+  static inline quad_bit_span<quad_value_bit_vector>
+  span(quad_value_bit_vector& a) {
+    return span(a, 0, a.bitLength());
+  }
+
+  static inline const_quad_bit_span const_span(const quad_value_bit_vector& a,
+                                               const int start,
+                                               const int end) {
+    assert((0 <= start) && (start <= end) && (end <= a.bitLength()));
+    return const_quad_bit_span(a.value_data(), a.unknown_data(),
+                               a.num_words(), start, end - start);
+  }
+
+  static inline const_quad_bit_span const_span(const quad_value_bit_vector& a) {
+    return const_span(a, 0, a.bitLength());
+  }
+
+  static inline quad_value_bit_vector
+  to_quad_value_bit_vector(const const_quad_bit_span& field) {
+    quad_value_bit_vector res(field.bitLength());
+    for (int i = 0; i < res.num_words(); i++) {
+      res.set_value_word(i, field.get_value_word(i));
+      res.set_unknown_word(i, field.get_unknown_word(i));
+    }
     return res;
   }
 
@@ -1047,12 +1364,8 @@ namespace bsim {
   concat(const quad_value_bit_vector& a,
 	 const quad_value_bit_vector& b) {
     quad_value_bit_vector res(a.bitLength() + b.bitLength());
-    for (int i = 0; i < a.bitLength(); i++) {
-      res.set(i, a.get(i));
-    }
-    for (int i = 0; i < ((int) b.bitLength()); i++) {
-      res.set(i + a.bitLength(), b.get(i));
-    }
+    span(res, 0, a.bitLength()).assign(const_span(a));
+    span(res, a.bitLength(), res.bitLength()).assign(const_span(b));
 
     return res;
   }
@@ -1062,12 +1375,7 @@ namespace bsim {
   slice(const quad_value_bit_vector& a,
 	const int start,
 	const int end) {
-    quad_value_bit_vector res(end - start);
-
-    for (int i = 0; i < res.bitLength(); i++) {
-      res.set(i, a.get(i + start));
-    }
-    return res;
+    return to_quad_value_bit_vector(const_span(a, start, end));
   }
   
 
@@ -1075,9 +1383,7 @@ namespace bsim {
   quad_value_bit_vector
   extend(const quad_value_bit_vector& a, const int extra_bits) {
     quad_value_bit_vector res(a.bitLength() + extra_bits);
-    for (int i = 0; i < a.bitLength(); i++) {
-      res.set(i, a.get(i));
-    }
+    span(res, 0, a.bitLength()).assign(const_span(a));
 
     return res;
   }
@@ -1093,38 +1399,91 @@ namespace bsim {
     return res;
   }
 
-  static inline
-  bsim::quad_value_bit_vector unsigned_divide(const bsim::quad_value_bit_vector& a,
-                                              const bsim::quad_value_bit_vector& b) {
+  // Long division of the value planes, computing the quotient and the
+  // remainder together. As in Verilog, an unknown bit in either operand
+  // or a zero divisor makes both results all x.
+  static inline void
+  div_rem_bv(const quad_value_bit_vector& a,
+	     const quad_value_bit_vector& b,
+	     const bool is_signed,
+	     quad_value_bit_vector& quotient,
+	     quad_value_bit_vector& remainder) {
     assert(a.bitLength() == b.bitLength());
 
-    bsim::quad_value_bit_vector extA = zero_extend(2*a.bitLength(), a);
-    bsim::quad_value_bit_vector extB = zero_extend(2*b.bitLength(), b);
+    const int n = a.num_words();
+    if (!binary_operands(a, b) || (find_last_set_limbs(b.value_data(), n) < 0)) {
+      quotient = unknown_bv(a.bitLength());
+      remainder = unknown_bv(a.bitLength());
+      return;
+    }
 
-    bsim::quad_value_bit_vector quotient(a.bitLength(), 0);
-    bsim::quad_value_bit_vector a_tmp = extA;
+    // The quotient and remainder may be the operands, so divide into
+    // fresh vectors and move them into place afterwards
+    quad_value_bit_vector q(a.bitLength());
+    quad_value_bit_vector r(a.bitLength());
 
-    //std::cout << "a = " << extA << std::endl;
-    //std::cout << "b = " << extB << std::endl;
+    if (is_signed) {
+      signed_div_rem_limbs(q.value_data(), r.value_data(), a.value_data(), b.value_data(), n, a.bitLength());
+    } else {
+      div_rem_limbs(q.value_data(), r.value_data(), a.value_data(), b.value_data(), n);
+    }
 
-    // Use slow divide method
-    for (int i = (a.bitLength() - 1); i >= 0; i--) {
-      bsim::quad_value_bit_vector shifted_b = shl(extB, bsim::quad_value_bit_vector(b.bitLength(), i));
+    quotient = std::move(q);
+    remainder = std::move(r);
+  }
 
-      //std::cout << "Shifted b = " << shifted_b << std::endl;
-      //std::cout << "a_tmp     = " << a_tmp << std::endl;
+  static inline void
+  unsigned_div_rem(const quad_value_bit_vector& a,
+		   const quad_value_bit_vector& b,
+		   quad_value_bit_vector& quotient,
+		   quad_value_bit_vector& remainder) {
+    div_rem_bv(a, b, false, quotient, remainder);
+  }
 
-      if ((shifted_b < a_tmp) || (shifted_b == a_tmp)) {
-        quotient.set(i, quad_value(1));
-        a_tmp = sub_general_width_bv(a_tmp, shifted_b);
-      }
+  static inline
+  bsim::quad_value_bit_vector unsigned_divide(const bsim::quad_value_bit_vector& a,
+                                              const bsim::quad_value_bit_vector& b) {
+    quad_value_bit_vector quotient, remainder;
+    div_rem_bv(a, b, false, quotient, remainder);
+    return quotient;
+  }
 
-      //std::cout << "Final quotient = " << quotient << std::endl;
-    }
+  static inline
+  quad_value_bit_vector
+  unsigned_rem(const quad_value_bit_vector& a,
+	       const quad_value_bit_vector& b) {
+    quad_value_bit_vector quotient, remainder;
+    div_rem_bv(a, b, false, quotient, remainder);
+    return remainder;
+  }
 
-    //std::cout << "Final quotient = " << quotient << std::endl;
+  // Signed division rounds toward zero, the remainder takes the sign of
+  // the dividend
+  static inline void
+  signed_div_rem(const quad_value_bit_vector& a,
+		 const quad_value_bit_vector& b,
+		 quad_value_bit_vector& quotient,
+		 quad_value_bit_vector& remainder) {
+    div_rem_bv(a, b, true, quotient, remainder);
+  }
 
+  static inline
+  quad_value_bit_vector
+  signed_divide(const quad_value_bit_vector& a,
+		const quad_value_bit_vector& b) {
+    quad_value_bit_vector quotient, remainder;
+    div_rem_bv(a, b, true, quotient, remainder);
     return quotient;
   }
+
+  static inline
+  quad_value_bit_vector
+  signed_rem(const quad_value_bit_vector& a,
+	     const quad_value_bit_vector& b) {
+    quad_value_bit_vector quotient, remainder;
+    div_rem_bv(a, b, true, quotient, remainder);
+    return remainder;
+  }
   
+
 }
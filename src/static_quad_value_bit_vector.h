@@ -1,12 +1,20 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <bitset>
 #include <cassert>
 #include <iostream>
 #include <stdint.h>
 #include <type_traits>
 
+#include "bit_format.h"
+#include "bit_serialization.h"
+#include "bit_span.h"
+#include "limb_operations.h"
+#include "verilog_literal.h"
+
 // This is a comment
 
 typedef int8_t  bv_sint8;
@@ -22,52 +30,6 @@ typedef uint64_t bv_uint64;
 
 namespace bsim {
 
-  static inline std::string hex_digit_to_binary(const char hex_digit) {
-    switch (hex_digit) {
-    case '0':
-      return "0000";
-    case '1':
-      return "0001";
-    case '2':
-      return "0010";
-    case '3':
-      return "0011";
-    case '4':
-      return "0100";
-    case '5':
-      return "0101";
-    case '6':
-      return "0110";
-    case '7':
-      return "0111";
-    case '8':
-      return "1000";
-    case '9':
-      return "1001";
-    case 'a':
-      return "1010";
-    case 'b':
-      return "1011";
-    case 'c':
-      return "1100";
-    case 'd':
-      return "1101";
-    case 'e':
-      return "1110";
-    case 'f':
-      return "1111";
-    case 'x':
-      return "xxxx";
-    case 'z':
-      return "zzzz";
-      
-    default:
-      assert(false);
-    }
-
-    assert(false);
-  }
-
   class quad_value {
   protected:
     unsigned char value;
@@ -274,89 +236,104 @@ namespace bsim {
     return out;
   }
 
-  template<int N>
-  class static_quad_value_bit_vector {
-    quad_value bits[N];
+  // Whether an unknown plane has any bit set, kept up to date by the
+  // writers of the plane. A write that may have cleared the last unknown
+  // bit marks the summary stale and the reader rescans. The rescan
+  // happens in const is_binary, which may run on a shared vector from
+  // several threads, so the summary is a relaxed atomic.
+  template<bool Cached>
+  class unknown_plane_summary {
+    enum plane_summary { SUMMARY_STALE, SUMMARY_BINARY, SUMMARY_UNKNOWN };
+    mutable std::atomic<plane_summary> summary{SUMMARY_BINARY};
+
+    inline void set_summary(const plane_summary s) const {
+      summary.store(s, std::memory_order_relaxed);
+    }
 
   public:
 
-    static_quad_value_bit_vector() {
-      for (uint i = 0; i < ((uint) N); i++) {
-	bits[i] = quad_value(0);
-      }
+    unknown_plane_summary() {}
+
+    unknown_plane_summary(const unknown_plane_summary& other) :
+      summary{other.summary.load(std::memory_order_relaxed)} {}
+
+    unknown_plane_summary& operator=(const unknown_plane_summary& other) {
+      set_summary(other.summary.load(std::memory_order_relaxed));
+      return *this;
     }
 
-    static_quad_value_bit_vector(const std::string& str_raw) {
-      std::string bv_size = "";
-      int ind = 0;
-      while (str_raw[ind] != '\'') {
-        assert(isdigit(str_raw[ind]));
-        bv_size += str_raw[ind];
-        ind++;
+    inline void note_unknown_write(const bv_uint64 old_bits,
+                                   const bv_uint64 new_bits) {
+      if (new_bits != 0) {
+        set_summary(SUMMARY_UNKNOWN);
+      } else if (old_bits != 0) {
+        set_summary(SUMMARY_STALE);
       }
+    }
 
-      assert (str_raw[ind] == '\'');
+    // 1 when binary, 0 when not and -1 when stale
+    inline int cached_binary() const {
+      const plane_summary s = summary.load(std::memory_order_relaxed);
+      return s == SUMMARY_STALE ? -1 : s == SUMMARY_BINARY;
+    }
 
-      ind++;
+    inline void store_summary(const bool binary) const {
+      set_summary(binary ? SUMMARY_BINARY : SUMMARY_UNKNOWN);
+    }
 
-      char format = str_raw[ind];
+    inline void invalidate_summary() {
+      set_summary(SUMMARY_STALE);
+    }
+  };
 
-      assert((format == 'b') ||
-             (format == 'h') ||
-             (format == 'd'));
+  // Single limb planes are checked with one compare, so they skip the
+  // flag and keep registers packed into two limbs
+  template<>
+  class unknown_plane_summary<false> {
+  public:
 
-      ind++;
+    inline void note_unknown_write(const bv_uint64, const bv_uint64) {}
 
-      std::string digits = "";
-      while (ind < ((int) str_raw.size())) {
-        digits += str_raw[ind];
-        ind++;
-      }
+    inline int cached_binary() const {
+      return -1;
+    }
 
-      int num_bits = stoi(bv_size);
-      assert(num_bits == N);
+    inline void store_summary(const bool) const {}
 
-      //bits.resize(NUM_BYTES(num_bits));
-      //bits.resize(num_bits);
-      for (int i = 0; i < ((int) N); i++) {
-        bits[i] = 0;
-      }
+    inline void invalidate_summary() {}
+  };
 
-      // TODO: Check that digits are not too long
-
-      assert(format == 'h');
-
-      int bit_ind = 0;
-      for (int i = digits.size() - 1; i >= 0; i--) {
-        char hex_digit = digits[i];
-        std::string hex_to_binary = hex_digit_to_binary(hex_digit);
-
-        assert(hex_to_binary.size() == 4);
-
-        int k = 0;
-        for (int j = hex_to_binary.size() - 1; j >= 0; j--) {
-          // Dont add past the end
-          if ((bit_ind + k) < bitLength()) {
-            //std::cout << "setting digit = " << hex_to_binary[j] << std::endl;
-            if (hex_to_binary[j] == '1') {
-              set(bit_ind + k, quad_value(1));
-            } else if (hex_to_binary[j] == '0') {
-              set(bit_ind + k, quad_value(0));
-            } else if (hex_to_binary[j] == 'x') {
-              set(bit_ind + k, quad_value(QBV_UNKNOWN_VALUE));
-            } else if (hex_to_binary[j] == 'z') {
-              set(bit_ind + k, quad_value(QBV_HIGH_IMPEDANCE_VALUE));
-            } else {
-              assert(false);
-            }
-            k++;
-          } else {
-            //assert(hex_to_binary[j] == '0');
-          }
-        }
-        bit_ind += 4;
-      }
+  // Bits are stored in a value plane and an unknown plane with the same
+  // encoding as quad_value_bit_vector: 0 and 1 have a clear unknown bit,
+  // x has only the unknown bit set and z has both bits set. Bits past the
+  // end of the vector are kept at zero in both planes.
+  template<int N>
+  class static_quad_value_bit_vector :
+    private unknown_plane_summary<(NUM_WORDS(N) > 1)> {
+    std::array<bv_uint64, NUM_WORDS(N)> value_plane;
+    std::array<bv_uint64, NUM_WORDS(N)> unknown_plane;
 
+    typedef unknown_plane_summary<(NUM_WORDS(N) > 1)> summary_type;
+
+    using summary_type::note_unknown_write;
+    using summary_type::cached_binary;
+    using summary_type::store_summary;
+    using summary_type::invalidate_summary;
+
+  public:
+
+    static_quad_value_bit_vector() {
+      value_plane.fill(0);
+      unknown_plane.fill(0);
+    }
+
+    // A Verilog literal of width N, see verilog_literal.h
+    static_quad_value_bit_vector(const std::string& str) {
+      const verilog_literal lit = parse_verilog_literal(str);
+      assert(lit.width == N);
+      store_summary(!decode_verilog_literal(lit,
+                                            value_plane.data(),
+                                            unknown_plane.data()));
     }
 
     // static_quad_value_bit_vector(const std::string& str_raw) {
@@ -396,102 +373,114 @@ namespace bsim {
     //   }
     // }
 
-    static_quad_value_bit_vector(const int val) {
-      //bits.resize(NUM_BYTES(N));
-      //bits.resize(N);
+    // Only the low 32 bits of val are used, the rest of the vector is
+    // zero filled
+    static_quad_value_bit_vector(const int val) :
+      static_quad_value_bit_vector() {
+      value_plane[0] = (bv_uint64) ((bv_uint32) val);
+      clear_tail();
+    }
 
-      for (int i = 0; i < N; i++) {
-        if (i < ((int) sizeof(int)*8)) {
-          set(i, quad_value((val >> i) & 0x01));
-        } else {
-          set(i, quad_value(0));
-        }
-      }
+
+    // The binary digits, most significant first, into N characters of
+    // out, see quad_value_bit_vector::format_to
+    inline char* format_to(char* out) const {
+      return format_binary_limbs(out, value_plane.data(), unknown_plane.data(), 0, N);
     }
-                                                  
-
-    //Note: Need to check that all digits in each clump that
-    //contain 'x' or 'z' values are 'x' or 'z' values
-    std::string hex_string() {
-      std::string hex = std::to_string(N) + "'h";
-
-      std::string hex_digits = "";
-
-      for (int i = 0; i < ((int) bits.size()); i += 4) {
-        unsigned char bit_l = 0;
-        bool found_abnormal = false;
-
-        for (int j = 0; j < 4; j++) {
-          int index = i + j;
-          if (index >= ((int) bits.size())) {
-          } else {
-            if (bits[index].is_binary()) {
-              bit_l |= (bits[index].binary_value() & 0x01) << j;
-            } else if (bits[index].is_unknown()) {
-              bit_l = 'x';
-              found_abnormal = true;
-              break;
-            } else {
-              assert(bits[index].is_high_impedance());
-              bit_l = 'z';
-              found_abnormal = true;
-              break;
-            }
-          }
-        }
 
-        if (!found_abnormal) {
-          hex_digits += bit_l > 9 ? bit_l + 87 : bit_l + 48;
-        } else {
-          hex_digits += bit_l;
-        }
+    inline char* format_hex_to(char* out) const {
+      return format_hex_limbs(format_width_prefix(out, N, 'h'),
+                              value_plane.data(),
+                              unknown_plane.data(),
+                              N);
+    }
 
-      }
+    std::string hex_string() const {
+      std::string hex(hex_format_length(N), '0');
+      format_hex_to(&hex[0]);
+      return hex;
+    }
 
-      std::reverse(std::begin(hex_digits), std::end(hex_digits));
-      return hex + hex_digits;
+    // Binary records, see bit_serialization.h. The x/z plane is only
+    // written when the vector has unknown bits.
+    inline size_t serialized_size() const {
+      return serialized_record_size(N, !is_binary());
     }
-    
-    static_quad_value_bit_vector(const static_quad_value_bit_vector<N>& other) {
-      //bits.resize(other.bits.size());
-      //N = other.bitLength();
 
-      for (int i = 0; i < other.bitLength(); i++) {
-        bits[i] = other.bits[i];
+    // Writes serialized_size() bytes to out and returns their end
+    inline unsigned char* serialize_to(unsigned char* out) const {
+      return write_serial_record(out, N, value_plane.data(),
+                                 is_binary() ? nullptr : unknown_plane.data());
+    }
+
+    inline void serialize_to(std::vector<unsigned char>& buffer) const {
+      const size_t start = buffer.size();
+      buffer.resize(start + serialized_size());
+      serialize_to(&buffer[start]);
+    }
+
+    // Reads the record at the front of in and consumes it. Fails, leaving
+    // both unchanged, unless the record is complete and N bits wide.
+    inline bool deserialize_from(byte_span& in) {
+      int width;
+      bool has_unknown;
+      if (!read_serial_header(in, &width, &has_unknown) || (width != N)) {
+        return false;
+      }
+
+      const unsigned char* limbs = in.data + BV_SERIAL_HEADER_BYTES;
+      read_serial_limbs(value_plane.data(), limbs, NUM_WORDS(N));
+      if (has_unknown) {
+        read_serial_limbs(unknown_plane.data(),
+                          limbs + sizeof(bv_uint64)*NUM_WORDS(N),
+                          NUM_WORDS(N));
+      } else {
+        unknown_plane.fill(0);
       }
+      invalidate_summary();
+      clear_tail();
+
+      in.advance(serialized_record_size(N, has_unknown));
+      return true;
     }
+    
+    static_quad_value_bit_vector(const static_quad_value_bit_vector<N>& other) :
+      summary_type(other),
+      value_plane(other.value_plane),
+      unknown_plane(other.unknown_plane) {}
 
     static_quad_value_bit_vector<N>& operator=(const static_quad_value_bit_vector<N>& other) {
       if (&other == this) {
     	return *this;
       }
 
-      //bits.resize(other.bits.size());
-
-      //N = other.bitLength();
-
-      for (int i = 0; i < other.bitLength(); i++) {
-        bits[i] = other.bits[i];
-      }
+      value_plane = other.value_plane;
+      unknown_plane = other.unknown_plane;
+      summary_type::operator=(other);
 
       return *this;
     }
 
     bool is_binary() const {
-      for (int i = 0; i < ((int) bitLength()); i++) {
-        if (!get(i).is_binary()) {
-          return false;
+      const int cached = cached_binary();
+      if (cached >= 0) {
+        return cached != 0;
+      }
+
+      bool binary = true;
+      for (int i = 0; i < num_words(); i++) {
+        if (unknown_plane[i] != 0) {
+          binary = false;
+          break;
         }
       }
-      return true;
+      store_summary(binary);
+      return binary;
     }
     
     std::string binary_string() const {
-      std::string str = "";
-      for (int i = N - 1; i >= 0; i--) {
-        str += get(i).binary_string();
-      }
-
+      std::string str(N, '0');
+      format_to(&str[0]);
       return str;
     }
     
@@ -501,39 +490,91 @@ namespace bsim {
       // }
       // assert((v == 0) || (v == 1));
 
-      bits[ind] = quad_value(v);
+      set(ind, quad_value(v));
     }
 
     inline void set(const int ind, const quad_value val) {
-      //const unsigned char val) {
-      // int byte_num = ind / 8;
-      // int bit_num = ind % 8;
+      const int word_num = ind / BV_WORD_BITS;
+      const bv_uint64 bit = ((bv_uint64) 1) << (ind % BV_WORD_BITS);
+      const unsigned char c = val.get_char();
+
+      bv_uint64& v = value_plane[word_num];
+      bv_uint64& u = unknown_plane[word_num];
 
-      // unsigned char old = bits[byte_num];
-      // // The & 0x01 only seems to be needed for logical not
-      // old ^= (-(val & 0x01) ^ old) & (1 << bit_num);
+      note_unknown_write(u & bit, c & 0x02);
 
-      //bits[byte_num] = old;
-      bits[ind] = val;
+      v = (c & 0x01) ? (v | bit) : (v & ~bit);
+      u = (c & 0x02) ? (u | bit) : (u & ~bit);
     }
 
     quad_value get(const int ind) const {
-      return bits[ind];
-      // int byte_num = ind / 8;
-      // int bit_num = ind % 8;
+      const int word_num = ind / BV_WORD_BITS;
+      const int bit_num = ind % BV_WORD_BITS;
+
+      unsigned char v = (value_plane[word_num] >> bit_num) & 0x01;
+      unsigned char u = (unknown_plane[word_num] >> bit_num) & 0x01;
+      return quad_value(v | (u << 1));
+    }
+
+    static inline int num_words() {
+      return NUM_WORDS(N);
+    }
+
+    inline bv_uint64 get_value_word(const int i) const {
+      return value_plane[i];
+    }
+
+    inline bv_uint64 get_unknown_word(const int i) const {
+      return unknown_plane[i];
+    }
+
+    // The limbs of each plane, least significant first
+    inline const bv_uint64* value_data() const {
+      return value_plane.data();
+    }
+
+    // Writes through the value plane leave the unknown summary valid, so
+    // only the value plane is writable. Callers writing the top word
+    // keep the bits past the end at zero, as with set_value_word
+    inline bv_uint64* value_data() {
+      return value_plane.data();
+    }
+
+    inline const bv_uint64* unknown_data() const {
+      return unknown_plane.data();
+    }
+
+    // Note: Callers writing the top word are responsible for keeping
+    // the bits past the end of the vector at zero, see clear_tail
+    inline void set_value_word(const int i, const bv_uint64 w) {
+      value_plane[i] = w;
+    }
 
-      // unsigned char target_byte = bits[byte_num];
-      // return 0x01 & (target_byte >> bit_num);
+    inline void set_unknown_word(const int i, const bv_uint64 w) {
+      note_unknown_write(unknown_plane[i], w);
+      unknown_plane[i] = w;
+    }
+
+    inline void clear_tail() {
+      value_plane[NUM_WORDS(N) - 1] &= top_word_mask(N);
+      bv_uint64& u = unknown_plane[NUM_WORDS(N) - 1];
+      note_unknown_write(u, u & top_word_mask(N));
+      u &= top_word_mask(N);
     }
 
     inline bool equals(const static_quad_value_bit_vector<N>& other) const {
 
-      if (other.bitLength() != this->bitLength()) {
-        return false;
-      }
+      for (int i = 0; i < num_words(); i++) {
+        bv_uint64 a_u = unknown_plane[i];
+        bv_uint64 b_u = other.unknown_plane[i];
 
-      for (int i = 0; i < N; i++) {
-        if (get(i) != other.get(i)) {
+        // Unknown values are never equal to anything
+        if (((a_u & ~value_plane[i]) != 0) ||
+            ((b_u & ~other.value_plane[i]) != 0)) {
+          return false;
+        }
+
+        if ((a_u != b_u) || (value_plane[i] != other.value_plane[i])) {
           return false;
         }
       }
@@ -541,19 +582,16 @@ namespace bsim {
       return true;
     }
 
+    bool same_representation(const static_quad_value_bit_vector<N>& other) const {
+      return (value_plane == other.value_plane) &&
+        (unknown_plane == other.unknown_plane);
+    }
+
     template<typename ConvType>
     ConvType to_type() const {
-      ConvType tmp = 0;
-      ConvType exp = 1;
-      for (int i = 0; i < bitLength(); i++) {
-        tmp += exp*get(i).binary_value();
-        exp *= 2;
-      }
-      return tmp;
-      // ConvType tmp = *(const_cast<ConvType*>((const ConvType*) (&(bits[0]))));
-      // //TODO FIXME I am a sketchy hack.
-      // ConvType mask = sizeof(ConvType) > bits.size() ? (1<<N)-1 : -1; 
-      // return tmp & mask;
+      assert(is_binary());
+
+      return (ConvType) value_plane[0];
     }
 
     inline bv_uint64 as_native_int32() const {
@@ -582,38 +620,57 @@ namespace bsim {
     
   };
 
-  // static inline bool same_representation(const static_quad_value_bit_vector<N>& a,
-  //                          const static_quad_value_bit_vector<N>& b) {
-  //   if (a.bitLength() != b.bitLength()) {
-  //     return false;
-  //   }
+  template<int N>
+  static inline bool same_representation(const static_quad_value_bit_vector<N>& a,
+                                         const static_quad_value_bit_vector<N>& b) {
+    return a.same_representation(b);
+  }
 
-  //   for (int i = 0; i < ((int) a.bitLength()); i++) {
-  //     quad_value av = a.get(i);
-  //     quad_value bv = b.get(i);
-  //     if (!av.same_representation(bv)) {
-  //       return false;
-  //     }
-  //   }
-  //   return true;
-  // }
+  // Views of bits [start, end) of both planes of a, see bit_span.h
+  template<int N>
+  static inline quad_bit_span<static_quad_value_bit_vector<N> >
+  span(static_quad_value_bit_vector<N>& a, const int start, const int end) {
+    assert((0 <= start) && (start <= end) && (end <= N));
+    return quad_bit_span<static_quad_value_bit_vector<N> >(a, start, end - start);
+  }
+
+  template<int N>
+  static inline quad_bit_span<static_quad_value_bit_vector<N> >
+  span(static_quad_value_bit_vector<N>& a) {
+    return span(a, 0, N);
+  }
+
+  template<int N>
+  static inline const_quad_bit_span
+  const_span(const static_quad_value_bit_vector<N>& a,
+             const int start,
+             const int end) {
+    assert((0 <= start) && (start <= end) && (end <= N));
+    return const_quad_bit_span(a.value_data(), a.unknown_data(),
+                               NUM_WORDS(N), start, end - start);
+  }
+
+  template<int N>
+  static inline const_quad_bit_span
+  const_span(const static_quad_value_bit_vector<N>& a) {
+    return const_span(a, 0, N);
+  }
 
   template<int N>
   static inline static_quad_value_bit_vector<N> unknown_bv() {
     static_quad_value_bit_vector<N> res;
 
-    for (int i = 0; i < N; i++) {
-      res.set(i, QBV_UNKNOWN_VALUE);
+    for (int i = 0; i < res.num_words(); i++) {
+      res.set_unknown_word(i, ~((bv_uint64) 0));
     }
+    res.clear_tail();
     return res;
   }
 
   template<int N>
   static inline std::ostream& operator<<(std::ostream& out,
         				 const static_quad_value_bit_vector<N>& a) {
-    out << a.binary_string();
-
-    return out;
+    return write_binary_limbs(out, a.value_data(), a.unknown_data(), N);
   }
 
   template<int N>
@@ -631,33 +688,32 @@ namespace bsim {
   //   return a.get(a.bitLength() - 1);
   // }
 
+  // The arithmetic operations scan the unknown planes first. Any x or z
+  // bit in an operand makes the whole result x, otherwise the value planes
+  // go through the same limb kernels as two state vectors.
+  template<int N>
+  static inline bool binary_operands(const static_quad_value_bit_vector<N>& a,
+                                     const static_quad_value_bit_vector<N>& b) {
+    return a.is_binary() && b.is_binary();
+  }
+
   template<int N>
   static inline
   static_quad_value_bit_vector<N>
   add_general_width_bv(const static_quad_value_bit_vector<N>& a,
   		       const static_quad_value_bit_vector<N>& b) {
+    if (!binary_operands(a, b)) {
+      return unknown_bv<N>();
+    }
 
     static_quad_value_bit_vector<N> res;
-    unsigned char carry = 0;
-    for (int i = 0; i < ((int) a.bitLength()); i++) {
-
-      if (!a.get(i).is_binary() ||
-          !b.get(i).is_binary()) {
-        return unknown_bv<N>();
-      }
-
-      unsigned char sum = a.get(i).binary_value() + b.get(i).binary_value() + carry;
-
-      carry = 0;
-
-      unsigned char z_i = sum & 0x01;
-      res.set(i, quad_value(z_i));
-
-      if (sum >= 2) {
-  	carry = 1;
-      }
-
+    bv_uint64 carry = 0;
+    for (int i = 0; i < a.num_words(); i++) {
+      bv_uint64 sum;
+      carry = add_with_carry(a.get_value_word(i), b.get_value_word(i), carry, &sum);
+      res.set_value_word(i, sum);
     }
+    res.clear_tail();
 
     return res;
   }
@@ -667,73 +723,117 @@ namespace bsim {
   static_quad_value_bit_vector<N>
   sub_general_width_bv(const static_quad_value_bit_vector<N>& a,
   		       const static_quad_value_bit_vector<N>& b) {
-    int Width = a.bitLength();
+    if (!binary_operands(a, b)) {
+      return unknown_bv<N>();
+    }
+
     static_quad_value_bit_vector<N> diff;
-    static_quad_value_bit_vector<N> a_cpy = a;
+    bv_uint64 borrow = 0;
+    for (int i = 0; i < a.num_words(); i++) {
+      bv_uint64 d;
+      borrow = sub_with_borrow(a.get_value_word(i), b.get_value_word(i), borrow, &d);
+      diff.set_value_word(i, d);
+    }
+    diff.clear_tail();
 
-    for (int i = 0; i < Width; i++) {
+    return diff;
+  }    
 
-      if ((a_cpy.get(i) == 0) &&
-  	  (b.get(i) == 1)) {
+  // In place updates of a, these back the compound assignment operators.
+  // Like add and sub, any unknown bit in either operand makes the whole
+  // result unknown.
+  template<int N>
+  static inline void add_in_place(static_quad_value_bit_vector<N>& a,
+                                  const static_quad_value_bit_vector<N>& b) {
+    if (!binary_operands(a, b)) {
+      a = unknown_bv<N>();
+      return;
+    }
 
-  	int j = i + 1;
+    bv_uint64 carry = 0;
+    for (int i = 0; i < a.num_words(); i++) {
+      bv_uint64 sum;
+      carry = add_with_carry(a.get_value_word(i), b.get_value_word(i), carry, &sum);
+      a.set_value_word(i, sum);
+    }
+    a.clear_tail();
+  }
 
-  	diff.set(i, 1);	  
+  template<int N>
+  static inline void sub_in_place(static_quad_value_bit_vector<N>& a,
+                                  const static_quad_value_bit_vector<N>& b) {
+    if (!binary_operands(a, b)) {
+      a = unknown_bv<N>();
+      return;
+    }
 
-  	// Modify to carry
-  	while ((j < Width) && (a_cpy.get(j) != 1)) {
-  	  a_cpy.set(j, 1);
-  	  j++;
-  	}
+    bv_uint64 borrow = 0;
+    for (int i = 0; i < a.num_words(); i++) {
+      bv_uint64 diff;
+      borrow = sub_with_borrow(a.get_value_word(i), b.get_value_word(i), borrow, &diff);
+      a.set_value_word(i, diff);
+    }
+    a.clear_tail();
+  }
 
-  	if (j >= Width) {
-  	} else {
-  	  a_cpy.set(j, 0);
-  	}
+  // Logical shifts of the value plane, an operand with unknown bits
+  // becomes all unknown. A binary operand keeps a clear unknown plane,
+  // so neither shift touches the summary
+  template<int N>
+  static inline void shl_in_place(static_quad_value_bit_vector<N>& a,
+                                  const int shift) {
+    assert(shift >= 0);
 
-      } else if (a_cpy.get(i) == b.get(i)) {
-  	diff.set(i, 0);
-      } else if ((a_cpy.get(i) == 1) &&
-  		 (b.get(i) == 0)) {
-  	diff.set(i, 1);
-      } else {
-        return unknown_bv<N>();
-      }
+    if (!a.is_binary()) {
+      a = unknown_bv<N>();
+      return;
     }
 
-    return diff;
-  }    
+    shift_left_limbs(a.value_data(), a.value_data(), NUM_WORDS(N), shift);
+    a.value_data()[NUM_WORDS(N) - 1] &= top_word_mask(N);
+  }
+
+  template<int N>
+  static inline void lshr_in_place(static_quad_value_bit_vector<N>& a,
+                                   const int shift) {
+    assert(shift >= 0);
+
+    if (!a.is_binary()) {
+      a = unknown_bv<N>();
+      return;
+    }
+
+    shift_right_limbs(a.value_data(), a.value_data(), NUM_WORDS(N), shift, 0);
+  }
 
   template<int N>
   static inline
   static_quad_value_bit_vector<N>
   mul_general_width_bv(const static_quad_value_bit_vector<N>& a,
   		       const static_quad_value_bit_vector<N>& b) {
-    int Width = a.bitLength();
-    static_quad_value_bit_vector<N + N> full_len;
-
-    for (int i = 0; i < Width; i++) {
-      if (b.get(i) == 1) {
-
-  	static_quad_value_bit_vector<N + N> shifted_a;
-
-  	for (int j = 0; j < Width; j++) {
-  	  shifted_a.set(j + i, a.get(j));
-  	}
+    if (!binary_operands(a, b)) {
+      return unknown_bv<N>();
+    }
 
-  	full_len =
-  	  add_general_width_bv(full_len, shifted_a);
-      }
+    bv_uint64 a_words[NUM_WORDS(N)], b_words[NUM_WORDS(N)], prod[NUM_WORDS(N)];
+    for (int i = 0; i < NUM_WORDS(N); i++) {
+      a_words[i] = a.get_value_word(i);
+      b_words[i] = b.get_value_word(i);
     }
 
+    mul_limbs_low(prod, a_words, b_words, NUM_WORDS(N));
+
     static_quad_value_bit_vector<N> res;
-    for (int i = 0; i < Width; i++) {
-      res.set(i, full_len.get(i));
+    for (int i = 0; i < NUM_WORDS(N); i++) {
+      res.set_value_word(i, prod[i]);
     }
+    res.clear_tail();
 
     return res;
   }    
 
+  // The logic operations treat high impedance inputs like unknowns, so
+  // any bit they cannot decide comes out as x
   template<int N>
   class static_quad_value_bit_vector_operations {
   public:
@@ -743,27 +843,48 @@ namespace bsim {
     land(const static_quad_value_bit_vector<N>& a,
   	 const static_quad_value_bit_vector<N>& b) {
       static_quad_value_bit_vector<N> a_and_b;
-      for (int i = 0; i < a.bitLength(); i++) {
-  	a_and_b.set(i, a.get(i) & b.get(i));
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 av = a.get_value_word(i);
+        bv_uint64 au = a.get_unknown_word(i);
+        bv_uint64 bv = b.get_value_word(i);
+        bv_uint64 bu = b.get_unknown_word(i);
+
+        // A known zero on either side forces a known zero
+        bv_uint64 zeros = (~av & ~au) | (~bv & ~bu);
+
+  	a_and_b.set_value_word(i, av & bv & ~(au | bu));
+  	a_and_b.set_unknown_word(i, (au | bu) & ~zeros);
       }
+      a_and_b.clear_tail();
       return a_and_b;
 
     }
 
     static inline static_quad_value_bit_vector<N> lnot(const static_quad_value_bit_vector<N>& a) {
-      static_quad_value_bit_vector<N> not_a(a.bitLength());
-      for (int i = 0; i < a.bitLength(); i++) {
-  	not_a.set(i, ~a.get(i));
+      static_quad_value_bit_vector<N> not_a;
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 au = a.get_unknown_word(i);
+
+  	not_a.set_value_word(i, ~a.get_value_word(i) & ~au);
+  	not_a.set_unknown_word(i, au);
       }
+      not_a.clear_tail();
       return not_a;
 
     }
       
     static inline static_quad_value_bit_vector<N> lor(const static_quad_value_bit_vector<N>& a,
         				 const static_quad_value_bit_vector<N>& b) {
-      static_quad_value_bit_vector<N> a_or_b(a.bitLength());
-      for (int i = 0; i < a.bitLength(); i++) {
-  	a_or_b.set(i, a.get(i) | b.get(i));
+      static_quad_value_bit_vector<N> a_or_b;
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 au = a.get_unknown_word(i);
+        bv_uint64 bu = b.get_unknown_word(i);
+
+        // A known one on either side forces a known one
+        bv_uint64 ones = (a.get_value_word(i) & ~au) | (b.get_value_word(i) & ~bu);
+
+  	a_or_b.set_value_word(i, ones);
+  	a_or_b.set_unknown_word(i, (au | bu) & ~ones);
       }
       return a_or_b;
     }
@@ -772,13 +893,57 @@ namespace bsim {
     static_quad_value_bit_vector<N>
     lxor(const static_quad_value_bit_vector<N>& a,
   	 const static_quad_value_bit_vector<N>& b) {
-      static_quad_value_bit_vector<N> a_or_b(a.bitLength());
-      for (int i = 0; i < a.bitLength(); i++) {
-  	a_or_b.set(i, a.get(i) ^ b.get(i));
+      static_quad_value_bit_vector<N> a_or_b;
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 unk = a.get_unknown_word(i) | b.get_unknown_word(i);
+
+  	a_or_b.set_value_word(i, (a.get_value_word(i) ^ b.get_value_word(i)) & ~unk);
+  	a_or_b.set_unknown_word(i, unk);
       }
       return a_or_b;
 
     }
+
+    static inline void land_in_place(static_quad_value_bit_vector<N>& a,
+                                     const static_quad_value_bit_vector<N>& b) {
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 av = a.get_value_word(i);
+        bv_uint64 au = a.get_unknown_word(i);
+        bv_uint64 bv = b.get_value_word(i);
+        bv_uint64 bu = b.get_unknown_word(i);
+
+        // A known zero on either side forces a known zero
+        bv_uint64 zeros = (~av & ~au) | (~bv & ~bu);
+
+  	a.set_value_word(i, av & bv & ~(au | bu));
+  	a.set_unknown_word(i, (au | bu) & ~zeros);
+      }
+      a.clear_tail();
+    }
+
+    static inline void lor_in_place(static_quad_value_bit_vector<N>& a,
+                                    const static_quad_value_bit_vector<N>& b) {
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 au = a.get_unknown_word(i);
+        bv_uint64 bu = b.get_unknown_word(i);
+
+        // A known one on either side forces a known one
+        bv_uint64 ones = (a.get_value_word(i) & ~au) | (b.get_value_word(i) & ~bu);
+
+  	a.set_value_word(i, ones);
+  	a.set_unknown_word(i, (au | bu) & ~ones);
+      }
+    }
+
+    static inline void lxor_in_place(static_quad_value_bit_vector<N>& a,
+                                     const static_quad_value_bit_vector<N>& b) {
+      for (int i = 0; i < a.num_words(); i++) {
+        bv_uint64 unk = a.get_unknown_word(i) | b.get_unknown_word(i);
+
+  	a.set_value_word(i, (a.get_value_word(i) ^ b.get_value_word(i)) & ~unk);
+  	a.set_unknown_word(i, unk);
+      }
+    }
     
   };
 
@@ -815,6 +980,60 @@ namespace bsim {
     return static_quad_value_bit_vector_operations<N>::lxor(a, b);
   }
 
+  template<int N>
+  static inline static_quad_value_bit_vector<N>&
+  operator&=(static_quad_value_bit_vector<N>& a,
+             const static_quad_value_bit_vector<N>& b) {
+    static_quad_value_bit_vector_operations<N>::land_in_place(a, b);
+    return a;
+  }
+
+  template<int N>
+  static inline static_quad_value_bit_vector<N>&
+  operator|=(static_quad_value_bit_vector<N>& a,
+             const static_quad_value_bit_vector<N>& b) {
+    static_quad_value_bit_vector_operations<N>::lor_in_place(a, b);
+    return a;
+  }
+
+  template<int N>
+  static inline static_quad_value_bit_vector<N>&
+  operator^=(static_quad_value_bit_vector<N>& a,
+             const static_quad_value_bit_vector<N>& b) {
+    static_quad_value_bit_vector_operations<N>::lxor_in_place(a, b);
+    return a;
+  }
+
+  template<int N>
+  static inline static_quad_value_bit_vector<N>&
+  operator+=(static_quad_value_bit_vector<N>& a,
+             const static_quad_value_bit_vector<N>& b) {
+    add_in_place(a, b);
+    return a;
+  }
+
+  template<int N>
+  static inline static_quad_value_bit_vector<N>&
+  operator-=(static_quad_value_bit_vector<N>& a,
+             const static_quad_value_bit_vector<N>& b) {
+    sub_in_place(a, b);
+    return a;
+  }
+
+  template<int N>
+  static inline static_quad_value_bit_vector<N>&
+  operator<<=(static_quad_value_bit_vector<N>& a, const int shift) {
+    shl_in_place(a, shift);
+    return a;
+  }
+
+  template<int N>
+  static inline static_quad_value_bit_vector<N>&
+  operator>>=(static_quad_value_bit_vector<N>& a, const int shift) {
+    lshr_in_place(a, shift);
+    return a;
+  }
+
   template<int N>
   static inline bool operator!=(const static_quad_value_bit_vector<N>& a,
   				const static_quad_value_bit_vector<N>& b) {
@@ -832,13 +1051,12 @@ namespace bsim {
       return false;
     }
 
-    //int    int N = a.bitLength();
-    for (int i = N - 1; i >= 0; i--) {
-      if (a.get(i) > b.get(i)) {
+    for (int i = a.num_words() - 1; i >= 0; i--) {
+      if (a.get_value_word(i) > b.get_value_word(i)) {
   	return true;
       }
 
-      if (a.get(i) < b.get(i)) {
+      if (a.get_value_word(i) < b.get_value_word(i)) {
   	return false;
       }
     }
@@ -868,11 +1086,14 @@ namespace bsim {
     return !(a > b);
   }
 
+  // Reductions only count bits that are known ones
   template<int N>
   static inline static_quad_value_bit_vector<1>
   andr(const static_quad_value_bit_vector<N>& a) {
-    for (int i = 0; i < a.bitLength(); i++) {
-      if (a.get(i) != 1) {
+    for (int i = 0; i < a.num_words(); i++) {
+      bv_uint64 full =
+        (i == a.num_words() - 1) ? top_word_mask(N) : ~((bv_uint64) 0);
+      if ((a.get_value_word(i) & ~a.get_unknown_word(i)) != full) {
         return static_quad_value_bit_vector<1>(0);
       }
     }
@@ -883,8 +1104,8 @@ namespace bsim {
   template<int N>
   static inline static_quad_value_bit_vector<1>
   orr(const static_quad_value_bit_vector<N>& a) {
-    for (int i = 0; i < a.bitLength(); i++) {
-      if (a.get(i) == 1) {
+    for (int i = 0; i < a.num_words(); i++) {
+      if ((a.get_value_word(i) & ~a.get_unknown_word(i)) != 0) {
         return static_quad_value_bit_vector<1>(1);
       }
     }
@@ -1109,5 +1330,111 @@ namespace bsim {
 
     return res;
   }
+
+  // Long division of the value planes, computing the quotient and the
+  // remainder together. As in Verilog, an unknown bit in either operand
+  // or a zero divisor makes both results all x.
+  template<int N>
+  static inline void
+  div_rem_bv(const static_quad_value_bit_vector<N>& a,
+	     const static_quad_value_bit_vector<N>& b,
+	     const bool is_signed,
+	     static_quad_value_bit_vector<N>& quotient,
+	     static_quad_value_bit_vector<N>& remainder) {
+    const int n = NUM_WORDS(N);
+    if (!binary_operands(a, b)) {
+      quotient = unknown_bv<N>();
+      remainder = unknown_bv<N>();
+      return;
+    }
+
+    bv_uint64 a_words[NUM_WORDS(N)], b_words[NUM_WORDS(N)];
+    bv_uint64 q_words[NUM_WORDS(N)], r_words[NUM_WORDS(N)];
+    bool b_zero = true;
+    for (int i = 0; i < n; i++) {
+      a_words[i] = a.get_value_word(i);
+      b_words[i] = b.get_value_word(i);
+      b_zero = b_zero && (b_words[i] == 0);
+    }
+
+    if (b_zero) {
+      quotient = unknown_bv<N>();
+      remainder = unknown_bv<N>();
+      return;
+    }
+
+    if (is_signed) {
+      signed_div_rem_limbs(q_words, r_words, a_words, b_words, n, N);
+    } else {
+      div_rem_limbs(q_words, r_words, a_words, b_words, n);
+    }
+
+    quotient = static_quad_value_bit_vector<N>();
+    remainder = static_quad_value_bit_vector<N>();
+    for (int i = 0; i < n; i++) {
+      quotient.set_value_word(i, q_words[i]);
+      remainder.set_value_word(i, r_words[i]);
+    }
+  }
+
+  template<int N>
+  static inline void
+  unsigned_div_rem(const static_quad_value_bit_vector<N>& a,
+		   const static_quad_value_bit_vector<N>& b,
+		   static_quad_value_bit_vector<N>& quotient,
+		   static_quad_value_bit_vector<N>& remainder) {
+    div_rem_bv(a, b, false, quotient, remainder);
+  }
+
+  template<int N>
+  static inline
+  static_quad_value_bit_vector<N>
+  unsigned_divide(const static_quad_value_bit_vector<N>& a,
+		  const static_quad_value_bit_vector<N>& b) {
+    static_quad_value_bit_vector<N> quotient, remainder;
+    div_rem_bv(a, b, false, quotient, remainder);
+    return quotient;
+  }
+
+  template<int N>
+  static inline
+  static_quad_value_bit_vector<N>
+  unsigned_rem(const static_quad_value_bit_vector<N>& a,
+	       const static_quad_value_bit_vector<N>& b) {
+    static_quad_value_bit_vector<N> quotient, remainder;
+    div_rem_bv(a, b, false, quotient, remainder);
+    return remainder;
+  }
+
+  // Signed division rounds toward zero, the remainder takes the sign of
+  // the dividend
+  template<int N>
+  static inline void
+  signed_div_rem(const static_quad_value_bit_vector<N>& a,
+		 const static_quad_value_bit_vector<N>& b,
+		 static_quad_value_bit_vector<N>& quotient,
+		 static_quad_value_bit_vector<N>& remainder) {
+    div_rem_bv(a, b, true, quotient, remainder);
+  }
+
+  template<int N>
+  static inline
+  static_quad_value_bit_vector<N>
+  signed_divide(const static_quad_value_bit_vector<N>& a,
+		const static_quad_value_bit_vector<N>& b) {
+    static_quad_value_bit_vector<N> quotient, remainder;
+    div_rem_bv(a, b, true, quotient, remainder);
+    return quotient;
+  }
+
+  template<int N>
+  static inline
+  static_quad_value_bit_vector<N>
+  signed_rem(const static_quad_value_bit_vector<N>& a,
+	     const static_quad_value_bit_vector<N>& b) {
+    static_quad_value_bit_vector<N> quotient, remainder;
+    div_rem_bv(a, b, true, quotient, remainder);
+    return remainder;
+  }
   
 }
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bit_format.h"
+#include "limb_operations.h"
+
+// Streams value changes to a VCD file. Signals are declared up front
+// and are then traced with change() once per time step:
+//
+//   vcd_writer vcd(file);
+//   vcd.push_scope("top");
+//   const int pc = vcd.add_signal("pc", 32);
+//   vcd.pop_scope();
+//   vcd.end_definitions();
+//
+//   for (cycle ...) {
+//     vcd.set_time(cycle);
+//     vcd.change(pc, pc_reg);
+//   }
+//
+// change() takes any two valued vector with get_word, such as
+// bit_vector<N>, dynamic_bit_vector or a bit span, and any four valued
+// vector with get_value_word and get_unknown_word. The writer keeps a
+// shadow copy of every signal and compares it a limb at a time, so
+// unchanged signals cost one pass over their limbs and write nothing.
+// Output goes through one reusable buffer that is written to the stream
+// when it fills up.
+
+namespace bsim {
+
+  class vcd_writer {
+    struct vcd_signal {
+      std::string id;
+      int width;
+
+      // Value limbs followed by unknown limbs in shadow
+      size_t shadow_offset;
+    };
+
+    std::ostream& out;
+    std::vector<char> buffer;
+    size_t used;
+
+    std::vector<vcd_signal> signals;
+    std::vector<bv_uint64> shadow;
+
+    bool definitions_done;
+    bool time_pending;
+    bv_uint64 time;
+
+    vcd_writer(const vcd_writer&);
+    vcd_writer& operator=(const vcd_writer&);
+
+    // Identifiers are the index of the signal in base 94 over the
+    // printable characters, the shortest the format allows
+    static std::string signal_id_for(size_t index) {
+      std::string id;
+      do {
+        id += (char) ('!' + (index % 94));
+        index /= 94;
+      } while (index != 0);
+      return id;
+    }
+
+    // Room for n more characters in the buffer
+    inline char* reserve(const size_t n) {
+      if (used + n > buffer.size()) {
+        flush();
+        if (n > buffer.size()) {
+          buffer.resize(n);
+        }
+      }
+      return &buffer[used];
+    }
+
+    inline void write(const char* s, const size_t n) {
+      memcpy(reserve(n), s, n);
+      used += n;
+    }
+
+    inline void write(const std::string& s) {
+      write(s.data(), s.size());
+    }
+
+    inline void write_time() {
+      char digits[24];
+      char* end = format_decimal_word(digits, time, 0);
+
+      char* p = reserve(end - digits + 2);
+      *p++ = '#';
+      memcpy(p, digits, end - digits);
+      p += end - digits;
+      *p++ = '\n';
+      used = p - &buffer[0];
+    }
+
+    // Writes the shadow value of signal s
+    void write_value(const vcd_signal& s) {
+      static const char quad_chars[] = {'0', '1', 'x', 'z'};
+
+      const int n = NUM_WORDS(s.width);
+      const bv_uint64* value = &shadow[s.shadow_offset];
+      const bv_uint64* unknown = value + n;
+
+      if (time_pending) {
+        write_time();
+        time_pending = false;
+      }
+
+      char* p = reserve(s.width + s.id.size() + 3);
+
+      if (s.width == 1) {
+        *p++ = quad_chars[(value[0] & 0x01) | ((unknown[0] & 0x01) << 1)];
+      } else {
+        // Leading zeros are implied, unless the first digit left is x or
+        // z, which would be extended instead
+        const int top_value = find_last_set_limbs(value, n);
+        const int top_unknown = find_last_set_limbs(unknown, n);
+        int top = top_value > top_unknown ? top_value : top_unknown;
+        if (top < 0) {
+          top = 0;
+        } else if ((top == top_unknown) && (top < s.width - 1)) {
+          top++;
+        }
+
+        *p++ = 'b';
+        p = format_binary_limbs(p, value, unknown, 0, top + 1);
+        *p++ = ' ';
+      }
+
+      memcpy(p, s.id.data(), s.id.size());
+      p += s.id.size();
+      *p++ = '\n';
+
+      used = p - &buffer[0];
+    }
+
+  public:
+
+    explicit vcd_writer(std::ostream& out_,
+                        const std::string& timescale = "1ns",
+                        const size_t buffer_bytes = 1 << 20) :
+      out(out_), buffer(buffer_bytes), used(0),
+      definitions_done(false), time_pending(false), time(0) {
+      write("$timescale " + timescale + " $end\n");
+    }
+
+    ~vcd_writer() {
+      flush();
+    }
+
+    void push_scope(const std::string& name) {
+      assert(!definitions_done);
+      write("$scope module " + name + " $end\n");
+    }
+
+    void pop_scope() {
+      assert(!definitions_done);
+      write("$upscope $end\n");
+    }
+
+    // Declares a signal in the current scope and returns the handle to
+    // pass to change()
+    int add_signal(const std::string& name, const int width) {
+      assert(!definitions_done);
+      assert(width > 0);
+
+      vcd_signal s;
+      s.id = signal_id_for(signals.size());
+      s.width = width;
+      s.shadow_offset = shadow.size();
+
+      // Every signal starts out as x, so its first change is always
+      // written
+      const int n = NUM_WORDS(width);
+      shadow.resize(shadow.size() + 2*n, 0);
+      for (int i = 0; i < n; i++) {
+        shadow[s.shadow_offset + n + i] = ~((bv_uint64) 0);
+      }
+      shadow[s.shadow_offset + 2*n - 1] &= top_word_mask(width);
+
+      write("$var wire " + std::to_string(width) + " " + s.id + " " + name + " $end\n");
+
+      signals.push_back(s);
+      return signals.size() - 1;
+    }
+
+    void end_definitions() {
+      assert(!definitions_done);
+      write("$enddefinitions $end\n");
+      definitions_done = true;
+      time_pending = true;
+    }
+
+    // Starts a new time step. The time is only written if some signal
+    // changes in the step.
+    void set_time(const bv_uint64 t) {
+      assert(definitions_done);
+      assert(t >= time);
+
+      if (t != time) {
+        time_pending = true;
+      }
+      time = t;
+    }
+
+    // Records the value of a two valued vector for the signal
+    template<typename Vector>
+    auto change(const int handle, const Vector& v) ->
+      decltype(v.get_word(0), void()) {
+      assert(definitions_done);
+
+      const vcd_signal& s = signals[handle];
+      assert(v.bitLength() == s.width);
+
+      const int n = NUM_WORDS(s.width);
+      bv_uint64* value = &shadow[s.shadow_offset];
+      bv_uint64* unknown = value + n;
+
+      bv_uint64 diff = 0;
+      for (int i = 0; i < n; i++) {
+        const bv_uint64 w = v.get_word(i);
+        diff |= (w ^ value[i]) | unknown[i];
+        value[i] = w;
+        unknown[i] = 0;
+      }
+
+      if (diff != 0) {
+        write_value(s);
+      }
+    }
+
+    // Records the value of a four valued vector for the signal
+    template<typename Vector>
+    auto change(const int handle, const Vector& v) ->
+      decltype(v.get_unknown_word(0), void()) {
+      assert(definitions_done);
+
+      const vcd_signal& s = signals[handle];
+      assert(v.bitLength() == s.width);
+
+      const int n = NUM_WORDS(s.width);
+      bv_uint64* value = &shadow[s.shadow_offset];
+      bv_uint64* unknown = value + n;
+
+      bv_uint64 diff = 0;
+      for (int i = 0; i < n; i++) {
+        const bv_uint64 w = v.get_value_word(i);
+        const bv_uint64 u = v.get_unknown_word(i);
+        diff |= (w ^ value[i]) | (u ^ unknown[i]);
+        value[i] = w;
+        unknown[i] = u;
+      }
+
+      if (diff != 0) {
+        write_value(s);
+      }
+    }
+
+    inline const std::string& signal_id(const int handle) const {
+      return signals[handle].id;
+    }
+
+    inline int num_signals() const {
+      return signals.size();
+    }
+
+    // Writes out everything buffered so far
+    void flush() {
+      if (used > 0) {
+        out.write(&buffer[0], used);
+        used = 0;
+      }
+    }
+  };
+
+}
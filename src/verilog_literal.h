@@ -0,0 +1,367 @@
+#pragma once
+
+#include <cassert>
+#include <cstring>
+#include <string>
+
+#include "decimal_limbs.h"
+#include "limb_operations.h"
+
+// Parsing of Verilog number literals shared by every vector type:
+//
+//   8'hff  12'o7_7_7  16'd65535  4'b10xz  8'sh80  'HDEAD  8'bx
+//
+// Bases may be upper or lower case, an s before the base marks the
+// literal as signed, and digits may contain underscores, x, z and ?.
+// Literals without a size are 32 bits wide. Following Verilog, a literal
+// with fewer digits than its width is padded with zeros, or with x or z
+// when its leftmost digit is x or z, and digits past the width are
+// dropped.
+//
+// Parsing only finds the width and the digits, decode_verilog_literal
+// then writes the digits straight into the limbs of a vector.
+
+namespace bsim {
+
+  struct verilog_literal {
+    int width;
+    bool is_signed;
+
+    // 'b', 'o', 'd' or 'h'
+    char base;
+
+    // The digits in the parsed string, most significant first
+    const char* digits;
+    const char* digits_end;
+  };
+
+#define LITERAL_DIGIT_X 16
+#define LITERAL_DIGIT_Z 17
+#define LITERAL_SEPARATOR 18
+#define LITERAL_INVALID 19
+
+  // Value of every character as a digit
+  struct literal_digit_table {
+    unsigned char digit[256];
+
+    literal_digit_table() {
+      memset(digit, LITERAL_INVALID, sizeof(digit));
+
+      for (int i = 0; i < 10; i++) {
+        digit['0' + i] = i;
+      }
+      for (int i = 0; i < 6; i++) {
+        digit['a' + i] = 10 + i;
+        digit['A' + i] = 10 + i;
+      }
+
+      digit[(unsigned char) 'x'] = LITERAL_DIGIT_X;
+      digit[(unsigned char) 'X'] = LITERAL_DIGIT_X;
+      digit[(unsigned char) 'z'] = LITERAL_DIGIT_Z;
+      digit[(unsigned char) 'Z'] = LITERAL_DIGIT_Z;
+      digit[(unsigned char) '?'] = LITERAL_DIGIT_Z;
+      digit[(unsigned char) '_'] = LITERAL_SEPARATOR;
+    }
+  };
+
+  static inline const unsigned char* literal_digits() {
+    static const literal_digit_table table;
+    return table.digit;
+  }
+
+  static inline const char* skip_literal_spaces(const char* p,
+                                                const char* end) {
+    while ((p < end) && ((*p == ' ') || (*p == '\t'))) {
+      p++;
+    }
+    return p;
+  }
+
+  // Splits a literal like 8'shff into its parts. The result points into
+  // str, which has to outlive it.
+  static inline verilog_literal parse_verilog_literal(const std::string& str) {
+    const char* p = str.data();
+    const char* end = str.data() + str.size();
+
+    while ((end > p) && ((end[-1] == ' ') || (end[-1] == '\t'))) {
+      end--;
+    }
+    p = skip_literal_spaces(p, end);
+
+    verilog_literal lit;
+    lit.width = 32;
+    lit.is_signed = false;
+
+    if ((p < end) && (*p != '\'')) {
+      lit.width = 0;
+      while ((p < end) && (*p != '\'') && (*p != ' ') && (*p != '\t')) {
+        if (*p != '_') {
+          assert(('0' <= *p) && (*p <= '9'));
+          lit.width = 10*lit.width + (*p - '0');
+        }
+        p++;
+      }
+      p = skip_literal_spaces(p, end);
+    }
+
+    assert(lit.width > 0);
+    assert((p < end) && (*p == '\''));
+    p++;
+
+    if ((p < end) && ((*p == 's') || (*p == 'S'))) {
+      lit.is_signed = true;
+      p++;
+    }
+
+    assert(p < end);
+    lit.base = (*p >= 'A') && (*p <= 'Z') ? *p - 'A' + 'a' : *p;
+    assert((lit.base == 'b') ||
+           (lit.base == 'o') ||
+           (lit.base == 'd') ||
+           (lit.base == 'h'));
+    p++;
+
+    lit.digits = skip_literal_spaces(p, end);
+    lit.digits_end = end;
+
+    assert(lit.digits < lit.digits_end);
+
+    return lit;
+  }
+
+  // A plain string of binary digits, like 10x_z1, taken as a literal of
+  // the given width. The digits must fit in the width.
+  static inline verilog_literal binary_digits_literal(const int width,
+                                                      const std::string& str) {
+    verilog_literal lit;
+    lit.width = width;
+    lit.is_signed = false;
+    lit.base = 'b';
+    lit.digits = str.data();
+    lit.digits_end = str.data() + str.size();
+
+    int num_digits = 0;
+    for (int i = 0; i < ((int) str.size()); i++) {
+      num_digits += str[i] != '_';
+    }
+    assert(num_digits <= width);
+
+    return lit;
+  }
+
+  // Sets bits [start, end) of w
+  static inline void set_literal_bits(bv_uint64* w,
+                                      const int start,
+                                      const int end) {
+    for (int pos = start; pos < end; ) {
+      const int k = pos / BV_WORD_BITS;
+      const int shift = pos % BV_WORD_BITS;
+      const int count = end - pos < BV_WORD_BITS - shift ? end - pos : BV_WORD_BITS - shift;
+
+      w[k] |= top_word_mask(count) << shift;
+      pos += count;
+    }
+  }
+
+  // ORs a digit of bits bits into w at bit pos, dropping bits past width
+  static inline void or_literal_digit(bv_uint64* w,
+                                      const int width,
+                                      const int pos,
+                                      const int bits,
+                                      const bv_uint64 d) {
+    const int k = pos / BV_WORD_BITS;
+    const int shift = pos % BV_WORD_BITS;
+
+    w[k] |= d << shift;
+    if ((shift + bits > BV_WORD_BITS) && (k + 1 < NUM_WORDS(width))) {
+      w[k + 1] |= d >> (BV_WORD_BITS - shift);
+    }
+  }
+
+  // Whether the literal has at least one digit and every digit is valid
+  // for its base. A decimal literal is either a number or a single x or
+  // z digit.
+  static inline bool check_literal_digits(const verilog_literal& lit) {
+    const unsigned char* table = literal_digits();
+    const int base = lit.base == 'b' ? 2 : (lit.base == 'o' ? 8 : (lit.base == 'd' ? 10 : 16));
+
+    int count = 0;
+    bool has_unknown = false;
+    for (const char* p = lit.digits; p < lit.digits_end; p++) {
+      const unsigned char d = table[(unsigned char) *p];
+      if (d == LITERAL_SEPARATOR) {
+        continue;
+      }
+
+      if ((d == LITERAL_DIGIT_X) || (d == LITERAL_DIGIT_Z)) {
+        has_unknown = true;
+      } else if (d >= base) {
+        return false;
+      }
+      count++;
+    }
+
+    if ((base == 10) && has_unknown && (count > 1)) {
+      return false;
+    }
+    return count > 0;
+  }
+
+  // Digits in base 2, 8 or 16, a digit at a time from the least
+  // significant end
+  static inline bool decode_power_of_two_digits(const verilog_literal& lit,
+                                                const int bits,
+                                                bv_uint64* value,
+                                                bv_uint64* unknown) {
+    const unsigned char* table = literal_digits();
+    const bv_uint64 digit_mask = (((bv_uint64) 1) << bits) - 1;
+
+    bool has_unknown = false;
+    unsigned char top = 0;
+    int pos = 0;
+    for (const char* p = lit.digits_end; p > lit.digits; ) {
+      const unsigned char d = table[(unsigned char) *--p];
+      if (d == LITERAL_SEPARATOR) {
+        continue;
+      }
+
+      assert((d < (1 << bits)) || (d == LITERAL_DIGIT_X) || (d == LITERAL_DIGIT_Z));
+
+      if (pos >= lit.width) {
+        continue;
+      }
+
+      top = d;
+      if (d < (1 << bits)) {
+        or_literal_digit(value, lit.width, pos, bits, d);
+      } else {
+        has_unknown = true;
+        if (unknown != nullptr) {
+          or_literal_digit(unknown, lit.width, pos, bits, digit_mask);
+          if (d == LITERAL_DIGIT_Z) {
+            or_literal_digit(value, lit.width, pos, bits, digit_mask);
+          }
+        }
+      }
+      pos += bits;
+    }
+
+    // An x or z in the leftmost digit fills the rest of the width
+    if ((pos < lit.width) && (unknown != nullptr)) {
+      if (top == LITERAL_DIGIT_X) {
+        set_literal_bits(unknown, pos, lit.width);
+      } else if (top == LITERAL_DIGIT_Z) {
+        set_literal_bits(unknown, pos, lit.width);
+        set_literal_bits(value, pos, lit.width);
+      }
+    }
+
+    return has_unknown;
+  }
+
+  // Decimal digits, see decimal_limbs.h. A decimal literal is either a
+  // number or a single x or z digit.
+  static inline bool decode_decimal_digits(const verilog_literal& lit,
+                                           bv_uint64* value,
+                                           bv_uint64* unknown) {
+    const unsigned char* table = literal_digits();
+
+    int count = 0;
+    for (const char* p = lit.digits; p < lit.digits_end; p++) {
+      const unsigned char d = table[(unsigned char) *p];
+      if (d == LITERAL_SEPARATOR) {
+        continue;
+      }
+
+      if ((d == LITERAL_DIGIT_X) || (d == LITERAL_DIGIT_Z)) {
+        assert(count == 0);
+        for (const char* q = p + 1; q < lit.digits_end; q++) {
+          assert(table[(unsigned char) *q] == LITERAL_SEPARATOR);
+        }
+
+        if (unknown != nullptr) {
+          set_literal_bits(unknown, 0, lit.width);
+          if (d == LITERAL_DIGIT_Z) {
+            set_literal_bits(value, 0, lit.width);
+          }
+        }
+        return true;
+      }
+
+      assert(d < 10);
+      count++;
+    }
+
+    if (count <= BV_DECIMAL_CHUNK_DIGITS*BV_DECIMAL_SPLIT_LIMBS) {
+      accumulate_decimal_digits(lit.digits, lit.digits_end, value, NUM_WORDS(lit.width));
+    } else {
+      std::string digits;
+      digits.reserve(count);
+      for (const char* p = lit.digits; p < lit.digits_end; p++) {
+        if (*p != '_') {
+          digits += *p;
+        }
+      }
+      parse_decimal_limbs(digits.data(), count, value, NUM_WORDS(lit.width));
+    }
+
+    return false;
+  }
+
+  // Writes the literal into the NUM_WORDS(lit.width) limbs of value and,
+  // for four valued vectors, of unknown. x and z digits read as zero when
+  // unknown is null. Sets *has_unknown to whether the literal has any x
+  // or z digits. For input that is not known to be valid, such as a
+  // file: a literal that fails check_literal_digits is not decoded, every
+  // bit is set to x, or to zero when unknown is null, and false is
+  // returned.
+  static inline bool decode_verilog_literal_checked(const verilog_literal& lit,
+                                                    bv_uint64* value,
+                                                    bv_uint64* unknown,
+                                                    bool* has_unknown_out) {
+    const int n = NUM_WORDS(lit.width);
+
+    memset(value, 0, n*sizeof(bv_uint64));
+    if (unknown != nullptr) {
+      memset(unknown, 0, n*sizeof(bv_uint64));
+    }
+
+    if (!check_literal_digits(lit)) {
+      if (unknown != nullptr) {
+        set_literal_bits(unknown, 0, lit.width);
+      }
+      *has_unknown_out = unknown != nullptr;
+      return false;
+    }
+
+    bool has_unknown;
+    if (lit.base == 'd') {
+      has_unknown = decode_decimal_digits(lit, value, unknown);
+    } else {
+      const int bits = lit.base == 'b' ? 1 : (lit.base == 'o' ? 3 : 4);
+      has_unknown = decode_power_of_two_digits(lit, bits, value, unknown);
+    }
+
+    value[n - 1] &= top_word_mask(lit.width);
+    if (unknown != nullptr) {
+      unknown[n - 1] &= top_word_mask(lit.width);
+    }
+
+    *has_unknown_out = has_unknown && (unknown != nullptr);
+    return true;
+  }
+
+  // decode_verilog_literal_checked for literals that are valid by
+  // construction, such as the ones written in a model. Returns whether
+  // the literal has any x or z digits.
+  static inline bool decode_verilog_literal(const verilog_literal& lit,
+                                            bv_uint64* value,
+                                            bv_uint64* unknown) {
+    assert(check_literal_digits(lit));
+
+    bool has_unknown;
+    decode_verilog_literal_checked(lit, value, unknown, &has_unknown);
+    return has_unknown;
+  }
+
+}
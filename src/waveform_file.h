@@ -0,0 +1,798 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "limb_operations.h"
+#include "mapped_file.h"
+
+// A binary, block based waveform format for long traces. The file is
+//
+//   header    8 byte magic, 4 byte version, 4 zero bytes
+//   blocks    the value changes of a span of time
+//   lists     for every signal, the indices of the blocks it changes in
+//   footer    the signal table and the index of the blocks
+//   trailer   8 byte offset of the footer, 8 byte magic
+//
+// A block holds one column per signal that changed in its span. A column
+// is a run of changes, each a varint tag, (time - previous time) << 1 with
+// the low bit set when the value has x/z bits, followed by the limbs of
+// the value plane and then of the unknown plane as varints. The first
+// change of a column is stored as is and the rest as the XOR with the
+// change before, so a signal that toggles a few bits costs a byte or two
+// per limb. Columns restart from zero in every block, so any block
+// decodes on its own.
+//
+// The block index gives the time span and position of every block, and
+// each block starts with a table of its columns sorted by signal. The
+// reader maps the file and reads a signal over a window of time by
+// binary searching the signal's block list for the window and decoding
+// only that signal's columns, so a signal that last changed long before
+// the window costs one search rather than a walk back over every block.
+//
+// All fields are little endian.
+
+#define BV_WAVEFORM_MAGIC "BSIMWAVE"
+#define BV_WAVEFORM_VERSION 2
+#define BV_WAVEFORM_HEADER_BYTES 16
+#define BV_WAVEFORM_TRAILER_BYTES 16
+#define BV_WAVEFORM_INDEX_ENTRY_BYTES 32
+
+namespace bsim {
+
+  static inline void put_waveform_u32(std::vector<unsigned char>& out,
+                                      const unsigned v) {
+    for (int i = 0; i < 4; i++) {
+      out.push_back((v >> (8*i)) & 0xff);
+    }
+  }
+
+  static inline void put_waveform_u64(std::vector<unsigned char>& out,
+                                      const bv_uint64 v) {
+    for (int i = 0; i < 8; i++) {
+      out.push_back((v >> (8*i)) & 0xff);
+    }
+  }
+
+  static inline void put_waveform_varint(std::vector<unsigned char>& out,
+                                         bv_uint64 v) {
+    while (v >= 0x80) {
+      out.push_back((v & 0x7f) | 0x80);
+      v >>= 7;
+    }
+    out.push_back(v);
+  }
+
+  static inline unsigned get_waveform_u32(const unsigned char* p) {
+    unsigned v = 0;
+    for (int i = 0; i < 4; i++) {
+      v |= ((unsigned) p[i]) << (8*i);
+    }
+    return v;
+  }
+
+  static inline bv_uint64 get_waveform_u64(const unsigned char* p) {
+    bv_uint64 v = 0;
+    for (int i = 0; i < 8; i++) {
+      v |= ((bv_uint64) p[i]) << (8*i);
+    }
+    return v;
+  }
+
+  // Reads a varint from [*p, end), returns false when it runs off the end
+  static inline bool get_waveform_varint(const unsigned char** p,
+                                         const unsigned char* end,
+                                         bv_uint64* v) {
+    *v = 0;
+    for (int shift = 0; (shift < 64) && (*p < end); shift += 7) {
+      const unsigned char b = *(*p)++;
+      *v |= ((bv_uint64) (b & 0x7f)) << shift;
+      if ((b & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  class waveform_writer {
+    struct waveform_signal {
+      std::string name;
+      int width;
+      bool has_value;
+
+      // Value limbs followed by unknown limbs in shadow
+      size_t shadow_offset;
+
+      // Changes in the current block
+      std::vector<unsigned char> column;
+      bv_uint64 last_time;
+
+      // The blocks written with a column for the signal
+      std::vector<unsigned> block_list;
+    };
+
+    struct block_entry {
+      bv_uint64 start_time;
+      bv_uint64 end_time;
+      bv_uint64 offset;
+      bv_uint64 size;
+    };
+
+    std::ostream& out;
+    const size_t block_bytes;
+    bv_uint64 file_offset;
+    bool closed;
+
+    std::vector<waveform_signal> signals;
+    std::vector<bv_uint64> shadow;
+
+    // Signals with a column in the current block
+    std::vector<int> dirty;
+    size_t pending_bytes;
+    bv_uint64 block_start;
+    bv_uint64 last_change;
+
+    std::vector<block_entry> blocks;
+    std::vector<unsigned char> buffer;
+
+    // Limbs of the value being recorded
+    std::vector<bv_uint64> scratch;
+
+    bv_uint64 time;
+
+    waveform_writer(const waveform_writer&);
+    waveform_writer& operator=(const waveform_writer&);
+
+    void write_buffer() {
+      out.write((const char*) buffer.data(), buffer.size());
+      file_offset += buffer.size();
+      buffer.clear();
+    }
+
+    void write_block() {
+      if (dirty.empty()) {
+        return;
+      }
+
+      std::sort(dirty.begin(), dirty.end());
+
+      block_entry b;
+      b.start_time = block_start;
+      b.end_time = last_change;
+      b.offset = file_offset;
+
+      // Column table, then the columns in signal order
+      put_waveform_u32(buffer, dirty.size());
+      unsigned column_offset = 4 + 8*dirty.size();
+      for (size_t i = 0; i < dirty.size(); i++) {
+        put_waveform_u32(buffer, dirty[i]);
+        put_waveform_u32(buffer, column_offset);
+        column_offset += signals[dirty[i]].column.size();
+      }
+
+      for (size_t i = 0; i < dirty.size(); i++) {
+        std::vector<unsigned char>& column = signals[dirty[i]].column;
+        buffer.insert(buffer.end(), column.begin(), column.end());
+        column.clear();
+        signals[dirty[i]].block_list.push_back(blocks.size());
+      }
+
+      b.size = buffer.size();
+      blocks.push_back(b);
+      write_buffer();
+
+      dirty.clear();
+      pending_bytes = 0;
+    }
+
+    // Appends the change to the column of signal s and updates its
+    // shadow, the new limbs are in value and unknown
+    void record(const int handle,
+                const bv_uint64* value,
+                const bv_uint64* unknown) {
+      waveform_signal& s = signals[handle];
+      const int n = NUM_WORDS(s.width);
+      bv_uint64* old_value = &shadow[s.shadow_offset];
+      bv_uint64* old_unknown = old_value + n;
+
+      if (dirty.empty()) {
+        block_start = time;
+      }
+
+      // The first change of a column is XORed with zero
+      const bool first = s.column.empty();
+      if (first) {
+        dirty.push_back(handle);
+        s.last_time = block_start;
+      }
+
+      bool has_unknown = false;
+      for (int i = 0; i < n; i++) {
+        has_unknown = has_unknown || (unknown[i] != 0);
+      }
+
+      const size_t before = s.column.size();
+      put_waveform_varint(s.column, ((time - s.last_time) << 1) | has_unknown);
+
+      for (int i = 0; i < n; i++) {
+        put_waveform_varint(s.column, value[i] ^ (first ? 0 : old_value[i]));
+        old_value[i] = value[i];
+      }
+      for (int i = 0; i < n; i++) {
+        if (has_unknown) {
+          put_waveform_varint(s.column, unknown[i] ^ (first ? 0 : old_unknown[i]));
+        }
+        old_unknown[i] = unknown[i];
+      }
+
+      s.has_value = true;
+      s.last_time = time;
+      last_change = time;
+      pending_bytes += s.column.size() - before;
+    }
+
+  public:
+
+    explicit waveform_writer(std::ostream& out_,
+                             const size_t block_bytes_ = 1 << 20) :
+      out(out_), block_bytes(block_bytes_), file_offset(0), closed(false),
+      pending_bytes(0), block_start(0), last_change(0), time(0) {
+      assert(block_bytes < 0x7fffffffu);
+
+      buffer.insert(buffer.end(), BV_WAVEFORM_MAGIC, BV_WAVEFORM_MAGIC + 8);
+      put_waveform_u32(buffer, BV_WAVEFORM_VERSION);
+      put_waveform_u32(buffer, 0);
+      write_buffer();
+    }
+
+    ~waveform_writer() {
+      close();
+    }
+
+    // Declares a signal and returns the handle to pass to change()
+    int add_signal(const std::string& name, const int width) {
+      assert(!closed);
+      assert(width > 0);
+
+      waveform_signal s;
+      s.name = name;
+      s.width = width;
+      s.has_value = false;
+      s.shadow_offset = shadow.size();
+      s.last_time = 0;
+
+      shadow.resize(shadow.size() + 2*NUM_WORDS(width), 0);
+      signals.push_back(s);
+      return signals.size() - 1;
+    }
+
+    // Starts a new time step. Blocks are only ended between time steps.
+    void set_time(const bv_uint64 t) {
+      assert(!closed);
+      assert(t >= time);
+
+      if ((t != time) && (pending_bytes >= block_bytes)) {
+        write_block();
+      }
+      time = t;
+    }
+
+    // Records the value of a two valued vector for the signal, if it
+    // changed
+    template<typename Vector>
+    auto change(const int handle, const Vector& v) ->
+      decltype(v.get_word(0), void()) {
+      const waveform_signal& s = signals[handle];
+      assert(v.bitLength() == s.width);
+
+      const int n = NUM_WORDS(s.width);
+      const bv_uint64* old_value = &shadow[s.shadow_offset];
+      const bv_uint64* old_unknown = old_value + n;
+
+      bool changed = !s.has_value;
+      for (int i = 0; (i < n) && !changed; i++) {
+        changed = (v.get_word(i) != old_value[i]) || (old_unknown[i] != 0);
+      }
+
+      if (changed) {
+        scratch.assign(2*n, 0);
+        for (int i = 0; i < n; i++) {
+          scratch[i] = v.get_word(i);
+        }
+        record(handle, &scratch[0], &scratch[n]);
+      }
+    }
+
+    // Records the value of a four valued vector for the signal, if it
+    // changed
+    template<typename Vector>
+    auto change(const int handle, const Vector& v) ->
+      decltype(v.get_unknown_word(0), void()) {
+      const waveform_signal& s = signals[handle];
+      assert(v.bitLength() == s.width);
+
+      const int n = NUM_WORDS(s.width);
+      const bv_uint64* old_value = &shadow[s.shadow_offset];
+      const bv_uint64* old_unknown = old_value + n;
+
+      bool changed = !s.has_value;
+      for (int i = 0; (i < n) && !changed; i++) {
+        changed = (v.get_value_word(i) != old_value[i]) ||
+          (v.get_unknown_word(i) != old_unknown[i]);
+      }
+
+      if (changed) {
+        scratch.resize(2*n);
+        for (int i = 0; i < n; i++) {
+          scratch[i] = v.get_value_word(i);
+          scratch[n + i] = v.get_unknown_word(i);
+        }
+        record(handle, &scratch[0], &scratch[n]);
+      }
+    }
+
+    // Writes the last block, the footer and the trailer. Nothing can be
+    // recorded afterwards.
+    void close() {
+      if (closed) {
+        return;
+      }
+
+      write_block();
+
+      std::vector<bv_uint64> list_offsets(signals.size());
+      for (size_t i = 0; i < signals.size(); i++) {
+        list_offsets[i] = file_offset + buffer.size();
+        const std::vector<unsigned>& list = signals[i].block_list;
+        for (size_t j = 0; j < list.size(); j++) {
+          put_waveform_u32(buffer, list[j]);
+        }
+        if (buffer.size() >= block_bytes) {
+          write_buffer();
+        }
+      }
+      write_buffer();
+
+      const bv_uint64 footer_offset = file_offset;
+
+      put_waveform_u32(buffer, signals.size());
+      for (size_t i = 0; i < signals.size(); i++) {
+        put_waveform_u32(buffer, signals[i].width);
+        put_waveform_u32(buffer, signals[i].name.size());
+        buffer.insert(buffer.end(), signals[i].name.begin(), signals[i].name.end());
+        put_waveform_u64(buffer, list_offsets[i]);
+        put_waveform_u32(buffer, signals[i].block_list.size());
+      }
+
+      put_waveform_u32(buffer, blocks.size());
+      for (size_t i = 0; i < blocks.size(); i++) {
+        put_waveform_u64(buffer, blocks[i].start_time);
+        put_waveform_u64(buffer, blocks[i].end_time);
+        put_waveform_u64(buffer, blocks[i].offset);
+        put_waveform_u64(buffer, blocks[i].size);
+      }
+
+      put_waveform_u64(buffer, footer_offset);
+      buffer.insert(buffer.end(), BV_WAVEFORM_MAGIC, BV_WAVEFORM_MAGIC + 8);
+      write_buffer();
+
+      out.flush();
+      closed = true;
+    }
+
+    inline int num_blocks() const {
+      return blocks.size();
+    }
+  };
+
+  class waveform_reader {
+    struct signal_entry {
+      std::string name;
+      int width;
+
+      // Indices of the blocks with a column for the signal, in order
+      const unsigned char* block_list;
+      unsigned block_count;
+    };
+
+    struct block_entry {
+      bv_uint64 start_time;
+      bv_uint64 end_time;
+      const unsigned char* data;
+      bv_uint64 size;
+    };
+
+    mapped_file mapping;
+    const unsigned char* file;
+    size_t file_size;
+
+    std::vector<signal_entry> signals;
+    std::vector<block_entry> blocks;
+
+    waveform_reader(const waveform_reader&);
+    waveform_reader& operator=(const waveform_reader&);
+
+    // The column of signal in block b, false when it has none
+    bool find_column(const int b,
+                     const int signal,
+                     const unsigned char** begin,
+                     const unsigned char** end) const {
+      const block_entry& blk = blocks[b];
+      if (blk.size < 4) {
+        return false;
+      }
+
+      const unsigned count = get_waveform_u32(blk.data);
+      if ((blk.size - 4) / 8 < count) {
+        return false;
+      }
+
+      const unsigned char* table = blk.data + 4;
+      unsigned lo = 0;
+      unsigned hi = count;
+      while (lo < hi) {
+        const unsigned mid = lo + (hi - lo) / 2;
+        if (get_waveform_u32(table + 8*mid) < (unsigned) signal) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+
+      if ((lo == count) || (get_waveform_u32(table + 8*lo) != (unsigned) signal)) {
+        return false;
+      }
+
+      const bv_uint64 start = get_waveform_u32(table + 8*lo + 4);
+      const bv_uint64 stop = lo + 1 == count ? blk.size : get_waveform_u32(table + 8*(lo + 1) + 4);
+      if ((start > stop) || (stop > blk.size)) {
+        return false;
+      }
+
+      *begin = blk.data + start;
+      *end = blk.data + stop;
+      return true;
+    }
+
+    // Entry i of the block list of s, -1 when it is not a valid block
+    inline int list_block(const signal_entry& s, const unsigned i) const {
+      const unsigned k = get_waveform_u32(s.block_list + 4*i);
+      return k < blocks.size() ? (int) k : -1;
+    }
+
+    // Time of the first change in a column
+    bool first_change_time(const int b,
+                           const unsigned char* p,
+                           const unsigned char* end,
+                           bv_uint64* t) const {
+      bv_uint64 tag;
+      if (!get_waveform_varint(&p, end, &tag)) {
+        return false;
+      }
+      *t = blocks[b].start_time + (tag >> 1);
+      return true;
+    }
+
+    template<typename Vector>
+    static auto store(Vector& v,
+                      const bv_uint64* value,
+                      const bv_uint64*) ->
+      decltype(v.set_word(0, 0), void()) {
+      for (int i = 0; i < NUM_WORDS(v.bitLength()); i++) {
+        v.set_word(i, value[i]);
+      }
+    }
+
+    template<typename Vector>
+    static auto store(Vector& v,
+                      const bv_uint64* value,
+                      const bv_uint64* unknown) ->
+      decltype(v.set_unknown_word(0, 0), void()) {
+      for (int i = 0; i < NUM_WORDS(v.bitLength()); i++) {
+        v.set_value_word(i, value[i]);
+        v.set_unknown_word(i, unknown[i]);
+      }
+    }
+
+    template<typename Vector>
+    struct store_last {
+      Vector& v;
+      bool& found;
+
+      store_last(Vector& v_, bool& found_) : v(v_), found(found_) {}
+
+      void operator()(const bv_uint64,
+                      const bv_uint64* value,
+                      const bv_uint64* unknown) {
+        store(v, value, unknown);
+        found = true;
+      }
+    };
+
+  public:
+
+    waveform_reader() : file(nullptr), file_size(0) {}
+
+    ~waveform_reader() {
+      close();
+    }
+
+    // Maps the file and reads its signal table and block index. Returns
+    // false when the file can't be read or isn't a waveform file.
+    bool open(const std::string& path) {
+      close();
+
+      if (!mapping.open(path) ||
+          (mapping.size() < BV_WAVEFORM_HEADER_BYTES + BV_WAVEFORM_TRAILER_BYTES)) {
+        close();
+        return false;
+      }
+
+      file = mapping.data();
+      file_size = mapping.size();
+
+      if (!read_footer()) {
+        close();
+        return false;
+      }
+      return true;
+    }
+
+    void close() {
+      mapping.close();
+      file = nullptr;
+      file_size = 0;
+      signals.clear();
+      blocks.clear();
+    }
+
+    inline bool is_open() const {
+      return file != nullptr;
+    }
+
+    inline int num_signals() const {
+      return signals.size();
+    }
+
+    inline int num_blocks() const {
+      return blocks.size();
+    }
+
+    inline const std::string& signal_name(const int signal) const {
+      return signals[signal].name;
+    }
+
+    inline int signal_width(const int signal) const {
+      return signals[signal].width;
+    }
+
+    // The handle of the first signal with the name, or -1
+    int find_signal(const std::string& name) const {
+      for (int i = 0; i < num_signals(); i++) {
+        if (signals[i].name == name) {
+          return i;
+        }
+      }
+      return -1;
+    }
+
+    // Calls f(time, value, unknown) with the value of the signal in
+    // effect at start, if it has one, and then with every change in
+    // (start, end]. value and unknown point to the NUM_WORDS(width)
+    // limbs of each plane. Only the blocks overlapping the window and,
+    // when the signal last changed before it, the block holding that
+    // change are decoded. Returns false on a corrupt file.
+    template<typename F>
+    bool for_each_change(const int signal,
+                         const bv_uint64 start,
+                         const bv_uint64 end,
+                         F f) const {
+      assert((0 <= signal) && (signal < num_signals()));
+      assert(start <= end);
+
+      const signal_entry& s = signals[signal];
+
+      // The number of blocks of the signal starting at or before start
+      unsigned lo = 0;
+      unsigned hi = s.block_count;
+      while (lo < hi) {
+        const unsigned mid = lo + (hi - lo) / 2;
+        const int k = list_block(s, mid);
+        if (k < 0) {
+          return false;
+        }
+        if (blocks[k].start_time <= start) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+
+      // The value in effect at start is in the last of those blocks, or
+      // in the one before it when the signal only changes after start in
+      // the last one. Earlier blocks end before later ones start.
+      const unsigned char* begin;
+      const unsigned char* stop;
+      unsigned first = 0;
+      if (lo > 0) {
+        first = lo - 1;
+        bv_uint64 t;
+        if (!find_column(list_block(s, first), signal, &begin, &stop) ||
+            !first_change_time(list_block(s, first), begin, stop, &t)) {
+          return false;
+        }
+        if ((t > start) && (first > 0)) {
+          first--;
+        }
+      }
+
+      const int n = NUM_WORDS(signals[signal].width);
+      std::vector<bv_uint64> limbs(2*n);
+      bv_uint64* value = &limbs[0];
+      bv_uint64* unknown = &limbs[n];
+
+      // The last value at or before start, reported once the first
+      // change after start is found
+      std::vector<bv_uint64> held(2*n);
+      bool holding = false;
+      bv_uint64 held_time = 0;
+
+      for (unsigned e = first; e < s.block_count; e++) {
+        const int k = list_block(s, e);
+        if (k < 0) {
+          return false;
+        }
+        if (blocks[k].start_time > end) {
+          break;
+        }
+        if (!find_column(k, signal, &begin, &stop)) {
+          return false;
+        }
+
+        std::fill(limbs.begin(), limbs.end(), 0);
+        bv_uint64 t = blocks[k].start_time;
+        const unsigned char* p = begin;
+        while (p < stop) {
+          bv_uint64 tag;
+          if (!get_waveform_varint(&p, stop, &tag)) {
+            return false;
+          }
+          t += tag >> 1;
+
+          if ((t > start) && holding) {
+            f(held_time, (const bv_uint64*) &held[0], (const bv_uint64*) &held[n]);
+            holding = false;
+          }
+          if (t > end) {
+            return true;
+          }
+
+          for (int i = 0; i < n; i++) {
+            bv_uint64 w;
+            if (!get_waveform_varint(&p, stop, &w)) {
+              return false;
+            }
+            value[i] ^= w;
+          }
+          for (int i = 0; i < n; i++) {
+            bv_uint64 w = 0;
+            if ((tag & 0x01) && !get_waveform_varint(&p, stop, &w)) {
+              return false;
+            }
+            unknown[i] = (tag & 0x01) ? unknown[i] ^ w : 0;
+          }
+
+          if (t <= start) {
+            std::copy(limbs.begin(), limbs.end(), held.begin());
+            holding = true;
+            held_time = t;
+          } else {
+            f(t, (const bv_uint64*) value, (const bv_uint64*) unknown);
+          }
+        }
+      }
+
+      if (holding) {
+        f(held_time, (const bv_uint64*) &held[0], (const bv_uint64*) &held[n]);
+      }
+
+      return true;
+    }
+
+    // Sets v to the value of the signal at time t. Returns false when
+    // the signal has no value at t.
+    template<typename Vector>
+    bool value_at(const int signal, const bv_uint64 t, Vector& v) const {
+      assert(v.bitLength() == signal_width(signal));
+
+      bool found = false;
+      return for_each_change(signal, t, t, store_last<Vector>(v, found)) && found;
+    }
+
+  private:
+
+    bool read_footer() {
+      if (memcmp(file, BV_WAVEFORM_MAGIC, 8) != 0 ||
+          (get_waveform_u32(file + 8) != BV_WAVEFORM_VERSION) ||
+          (memcmp(file + file_size - 8, BV_WAVEFORM_MAGIC, 8) != 0)) {
+        return false;
+      }
+
+      const bv_uint64 footer_offset = get_waveform_u64(file + file_size - BV_WAVEFORM_TRAILER_BYTES);
+      if ((footer_offset < BV_WAVEFORM_HEADER_BYTES) ||
+          (footer_offset + 4 > file_size - BV_WAVEFORM_TRAILER_BYTES)) {
+        return false;
+      }
+
+      const unsigned char* p = file + footer_offset;
+      const unsigned char* footer_end = file + file_size - BV_WAVEFORM_TRAILER_BYTES;
+
+      const unsigned signal_count = get_waveform_u32(p);
+      p += 4;
+      for (unsigned i = 0; i < signal_count; i++) {
+        if (footer_end - p < 8) {
+          return false;
+        }
+
+        signal_entry s;
+        s.width = get_waveform_u32(p);
+        const unsigned name_size = get_waveform_u32(p + 4);
+        p += 8;
+        if ((s.width <= 0) || ((unsigned) (footer_end - p) < name_size)) {
+          return false;
+        }
+
+        s.name.assign((const char*) p, name_size);
+        p += name_size;
+
+        if (footer_end - p < 12) {
+          return false;
+        }
+        const bv_uint64 list_offset = get_waveform_u64(p);
+        s.block_count = get_waveform_u32(p + 8);
+        p += 12;
+        if ((list_offset < BV_WAVEFORM_HEADER_BYTES) ||
+            (list_offset > footer_offset) ||
+            ((footer_offset - list_offset) / 4 < s.block_count)) {
+          return false;
+        }
+        s.block_list = file + list_offset;
+
+        signals.push_back(s);
+      }
+
+      if (footer_end - p < 4) {
+        return false;
+      }
+      const unsigned block_count = get_waveform_u32(p);
+      p += 4;
+      if ((bv_uint64) (footer_end - p) < ((bv_uint64) block_count)*BV_WAVEFORM_INDEX_ENTRY_BYTES) {
+        return false;
+      }
+
+      for (unsigned i = 0; i < block_count; i++) {
+        block_entry b;
+        b.start_time = get_waveform_u64(p);
+        b.end_time = get_waveform_u64(p + 8);
+        const bv_uint64 offset = get_waveform_u64(p + 16);
+        b.size = get_waveform_u64(p + 24);
+        p += BV_WAVEFORM_INDEX_ENTRY_BYTES;
+
+        if ((offset < BV_WAVEFORM_HEADER_BYTES) ||
+            (offset > footer_offset) ||
+            (b.size > footer_offset - offset)) {
+          return false;
+        }
+        b.data = file + offset;
+        blocks.push_back(b);
+      }
+
+      return true;
+    }
+  };
+
+}
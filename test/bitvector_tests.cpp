@@ -3,6 +3,12 @@
 #include "catch.hpp"
 
 #include "bit_vector.h"
+#include "memory_image.h"
+#include "vcd_writer.h"
+#include "temporary_file.h"
+
+#include <fstream>
+#include <sstream>
 
 using namespace std;
 
@@ -284,17 +290,35 @@ namespace bsim {
       }
     }
 
-    // SECTION("Signed division") {
-    //   int val_a = -23;
-    //   signed_int<32> a(val_a);
+    SECTION("Signed division") {
+
+      SECTION("32 bit numbers") {
+	int val_a = -23;
+	signed_int<32> a(val_a);
+
+	int val_b = 7;
+	signed_int<32> b(val_b);
+
+	signed_int<32> res = a / b;
 
-    //   int val_b = 7;
-    //   signed_int<32> b(val_b);
+	REQUIRE(res.as_native_int32() == (-23 / 7));
+      }
+
+      SECTION("Most negative number divided by -1 wraps") {
+	signed_int<8> a("10000000");
+	signed_int<8> b("11111111");
 
-    //   signed_int<32> res = a / b;
+	REQUIRE((a / b) == a);
+      }
 
-    //   REQUIRE(res.to_type<int>() == (-23 / 7));
-    // }
+      SECTION("91 bit numbers") {
+	signed_int<91> a(-23);
+	signed_int<91> b(7);
+
+	REQUIRE((a / b) == signed_int<91>(-3));
+	REQUIRE((b / a) == signed_int<91>(0));
+      }
+    }
 
     SECTION("Unsigned multiplication") {
 
@@ -667,6 +691,444 @@ namespace bsim {
 
   }
 
+  TEST_CASE("Native word operations") {
+
+    SECTION("Logical not clears bits past the width") {
+      bit_vector<5> a("01010");
+      bit_vector<5> b("10101");
+
+      REQUIRE(~a == b);
+      REQUIRE(~~a == a);
+    }
+
+    SECTION("Or and xor of 13 bit numbers") {
+      bit_vector<13> a("1100110011001");
+      bit_vector<13> b("1010101010101");
+
+      REQUIRE((a | b) == bit_vector<13>("1110111011101"));
+      REQUIRE((a ^ b) == bit_vector<13>("0110011001100"));
+    }
+
+    SECTION("Unsigned arithmetic wraps at the width") {
+      unsigned_int<12> a((bv_uint16) 4000);
+      unsigned_int<12> b((bv_uint16) 100);
+
+      REQUIRE((a + b) == unsigned_int<12>((bv_uint16) ((4000 + 100) % 4096)));
+      REQUIRE((b - a) == unsigned_int<12>((bv_uint16) (4096 + 100 - 4000)));
+      REQUIRE((a * b) == unsigned_int<12>((bv_uint16) ((4000 * 100) % 4096)));
+      REQUIRE((a / b) == unsigned_int<12>((bv_uint16) 40));
+    }
+
+    SECTION("Signed 40 bit multiplication") {
+      signed_int<40> a(-3000);
+      signed_int<40> b(1234);
+
+      REQUIRE((a * b) == signed_int<40>(-3000 * 1234));
+      REQUIRE(a < b);
+      REQUIRE(b >= a);
+    }
+
+    SECTION("Left shift and top bit position") {
+      bit_vector<24> a("000000000000000000010011");
+
+      REQUIRE(top_bit_position(a) == 4);
+      REQUIRE(top_bit_position(left_shift(a, 7)) == 11);
+      REQUIRE(top_bit_position(left_shift(a, 24)) == -1);
+    }
+
+    SECTION("Top bit position of a 70 bit number") {
+      bit_vector<70> a;
+      a.set(69, 1);
+
+      REQUIRE(top_bit_position(a) == 69);
+    }
+  }
+
+  TEST_CASE("Two limb native operations") {
+
+    SECTION("96 bit add carries across the limb boundary") {
+      unsigned_int<96> a((bv_uint64) 0xffffffffffffffffULL);
+      unsigned_int<96> one((bv_uint64) 1);
+
+      unsigned_int<96> correct;
+      correct.set(64, 1);
+
+      REQUIRE((a + one) == correct);
+      REQUIRE((correct - one) == a);
+    }
+
+    SECTION("128 bit multiply and divide") {
+      unsigned_int<128> a((bv_uint64) 0xffffffffffffffffULL);
+
+      unsigned_int<128> sq = a * a;
+
+      REQUIRE(sq.get(127) == 1);
+      REQUIRE(sq.get(64) == 0);
+      REQUIRE(sq.get(65) == 1);
+      REQUIRE(sq.get(0) == 1);
+      REQUIRE((sq / a) == a);
+    }
+
+    SECTION("72 bit signed division and comparison") {
+      signed_int<72> a(-1000);
+      signed_int<72> b(7);
+
+      REQUIRE((a / b) == signed_int<72>(-1000 / 7));
+      REQUIRE((a * b) == signed_int<72>(-7000));
+      REQUIRE(a < b);
+    }
+
+    SECTION("100 bit logic and shifts") {
+      bit_vector<100> a;
+      a.set(70, 1);
+      a.set(2, 1);
+
+      REQUIRE(top_bit_position(a) == 70);
+      REQUIRE(top_bit_position(left_shift(a, 29)) == 99);
+      REQUIRE(top_bit_position(left_shift(a, 30)) == 32);
+      REQUIRE((~~a) == a);
+      REQUIRE((a & ~a) == bit_vector<100>());
+    }
+  }
+
+  TEST_CASE("Carry chain over many limbs") {
+    unsigned_int<512> ones;
+    for (int i = 0; i < 500; i++) {
+      ones.set(i, 1);
+    }
+
+    unsigned_int<512> one((bv_uint64) 1);
+
+    unsigned_int<512> top;
+    top.set(500, 1);
+
+    SECTION("Add ripples a carry through every limb") {
+      REQUIRE((ones + one) == top);
+    }
+
+    SECTION("Subtract ripples a borrow through every limb") {
+      REQUIRE((top - one) == ones);
+    }
+
+    SECTION("Subtract wraps below zero") {
+      unsigned_int<512> all;
+      for (int i = 0; i < 512; i++) {
+	all.set(i, 1);
+      }
+
+      REQUIRE((unsigned_int<512>() - one) == all);
+      REQUIRE((all + one) == unsigned_int<512>());
+    }
+  }
+
+  TEST_CASE("Limb multiplication") {
+
+    SECTION("256 bit square of all ones") {
+      // (2^200 - 1)^2 = 2^400 - 2^201 + 1, truncated to 256 bits
+      unsigned_int<256> a;
+      for (int i = 0; i < 200; i++) {
+	a.set(i, 1);
+      }
+
+      unsigned_int<256> correct;
+      correct.set(0, 1);
+      for (int i = 201; i < 256; i++) {
+	correct.set(i, 1);
+      }
+
+      REQUIRE((a * a) == correct);
+    }
+
+    SECTION("Signed 300 bit multiplication") {
+      signed_int<300> a(-12345);
+      signed_int<300> b(678);
+
+      REQUIRE((a * b) == signed_int<300>(-12345 * 678));
+    }
+  }
+
+  TEST_CASE("Division and remainder") {
+
+    SECTION("Native remainder") {
+      unsigned_int<20> a((bv_uint32) 1000003);
+      unsigned_int<20> b((bv_uint32) 1009);
+
+      REQUIRE((a % b) == unsigned_int<20>((bv_uint32) (1000003 % 1009)));
+
+      signed_int<20> c(-1000);
+      signed_int<20> d(7);
+
+      REQUIRE((c % d) == signed_int<20>(-1000 % 7));
+      REQUIRE((c % signed_int<20>(-1)) == signed_int<20>(0));
+    }
+
+    SECTION("200 bit quotient and remainder") {
+      // a = 2^190 + 5, b = 2^70 + 1
+      unsigned_int<200> a((bv_uint64) 5);
+      a.set(190, 1);
+
+      unsigned_int<200> b((bv_uint64) 1);
+      b.set(70, 1);
+
+      unsigned_int<200> q;
+      unsigned_int<200> r;
+      unsigned_int_operations<200>::div_rem(a, b, q, r);
+
+      REQUIRE((q * b + r) == a);
+      REQUIRE(r < b);
+      REQUIRE((a / b) == q);
+      REQUIRE((a % b) == r);
+    }
+
+    SECTION("200 bit signed remainder takes the sign of the dividend") {
+      signed_int<200> a(-1000);
+      signed_int<200> b(7);
+
+      REQUIRE((a / b) == signed_int<200>(-1000 / 7));
+      REQUIRE((a % b) == signed_int<200>(-1000 % 7));
+      REQUIRE((signed_int<200>(1000) % signed_int<200>(-7)) == signed_int<200>(1000 % -7));
+    }
+
+    SECTION("Division by zero gives all ones and the dividend") {
+      unsigned_int<20> a((bv_uint32) 1000003);
+      REQUIRE((a / unsigned_int<20>()) == unsigned_int<20>(signed_int<20>(-1).get_bits()));
+      REQUIRE((a % unsigned_int<20>()) == a);
+      REQUIRE((signed_int<20>(-1000) / signed_int<20>(0)) == signed_int<20>(-1));
+      REQUIRE((signed_int<20>(-1000) % signed_int<20>(0)) == signed_int<20>(-1000));
+
+      unsigned_int<100> b((bv_uint64) 12345);
+      b.set(90, 1);
+      REQUIRE((b / unsigned_int<100>()) == unsigned_int<100>(signed_int<100>(-1).get_bits()));
+      REQUIRE((b % unsigned_int<100>()) == b);
+      REQUIRE((signed_int<100>(-1000) / signed_int<100>(0)) == signed_int<100>(-1));
+      REQUIRE((signed_int<100>(-1000) % signed_int<100>(0)) == signed_int<100>(-1000));
+
+      unsigned_int<200> c((bv_uint64) 5);
+      c.set(190, 1);
+      unsigned_int<200> q;
+      unsigned_int<200> r;
+      unsigned_int_operations<200>::div_rem(c, unsigned_int<200>(), q, r);
+      REQUIRE(q == unsigned_int<200>(signed_int<200>(-1).get_bits()));
+      REQUIRE(r == c);
+      REQUIRE((signed_int<200>(-1000) / signed_int<200>(0)) == signed_int<200>(-1));
+      REQUIRE((signed_int<200>(-1000) % signed_int<200>(0)) == signed_int<200>(-1000));
+    }
+  }
+
+  TEST_CASE("Bit scans") {
+
+    SECTION("Narrow vector") {
+      bit_vector<12> a("001001000100");
+
+      REQUIRE(popcount(a) == 3);
+      REQUIRE(find_first_set(a) == 2);
+      REQUIRE(find_next_set(a, 3) == 6);
+      REQUIRE(find_next_set(a, 10) == -1);
+      REQUIRE(count_leading_zeros(a) == 2);
+      REQUIRE(count_trailing_zeros(a) == 2);
+      REQUIRE(count_leading_zeros(bit_vector<12>()) == 12);
+    }
+
+    SECTION("Vector wider than two limbs") {
+      bit_vector<300> a;
+      a.set(299, 1);
+      a.set(130, 1);
+
+      REQUIRE(popcount(a) == 2);
+      REQUIRE(top_bit_position(a) == 299);
+      REQUIRE(find_first_set(a) == 130);
+      REQUIRE(find_next_set(a, 131) == 299);
+      REQUIRE(count_leading_zeros(a) == 0);
+      REQUIRE(count_trailing_zeros(bit_vector<300>()) == 300);
+    }
+  }
+
+  TEST_CASE("Compound assignment") {
+
+    SECTION("Logic and shifts in place") {
+      bit_vector<100> a;
+      a.set(70, 1);
+      a.set(2, 1);
+
+      bit_vector<100> mask;
+      mask.set(70, 1);
+
+      bit_vector<100> b = a;
+      b &= mask;
+      REQUIRE(b == mask);
+
+      b |= a;
+      REQUIRE(b == a);
+
+      b ^= mask;
+      REQUIRE(b == (a ^ mask));
+
+      b <<= 95;
+      REQUIRE(b.get(97) == 1);
+      REQUIRE(top_bit_position(b) == 97);
+
+      b >>= 97;
+      REQUIRE(b == bit_vector<100>(1));
+
+      bit_vector<8> narrow("10000001");
+      narrow <<= 1;
+      REQUIRE(narrow == bit_vector<8>("00000010"));
+    }
+
+    SECTION("Arithmetic in place") {
+      unsigned_int<96> a((bv_uint64) 0xffffffffffffffffULL);
+      unsigned_int<96> one((bv_uint64) 1);
+
+      unsigned_int<96> sum = a;
+      sum += one;
+      REQUIRE(sum == (a + one));
+
+      sum -= one;
+      REQUIRE(sum == a);
+
+      unsigned_int<16> acc((bv_uint16) 0);
+      for (int i = 0; i < 1000; i++) {
+        acc += unsigned_int<16>((bv_uint16) 100);
+      }
+      REQUIRE(acc == unsigned_int<16>((bv_uint16) 34464));
+
+      signed_int<72> s(-64);
+      s >>= 3;
+      REQUIRE(s == signed_int<72>(-8));
+      s <<= 2;
+      REQUIRE(s == signed_int<72>(-32));
+    }
+  }
+
+  TEST_CASE("Bit spans") {
+
+    SECTION("Fields of a wide vector") {
+      bit_vector<200> bus;
+      bit_span opcode = span(bus, 60, 75);
+      opcode.set_word(0, 0x7abc);
+
+      REQUIRE(bus.get(60) == 0);
+      REQUIRE(bus.get(62) == 1);
+      REQUIRE(bus.get(74) == 1);
+      REQUIRE(bus.get(75) == 0);
+      REQUIRE(const_span(bus, 60, 75).as_native_uint64() == 0x7abc);
+      REQUIRE(popcount(bus) == popcount(const_span(bus)));
+
+      bit_vector<200> other;
+      span(other, 130, 145).assign(opcode);
+      REQUIRE(const_span(other, 130, 145) == const_span(bus, 60, 75));
+      REQUIRE(const_span(other, 129, 144) != const_span(bus, 60, 75));
+
+      span(bus, 0, 200).fill(1);
+      REQUIRE(andr(const_span(bus)) == 1);
+      REQUIRE(bus == ~bit_vector<200>());
+    }
+
+    SECTION("Fields of a narrow vector") {
+      bit_vector<12> a("101100111000");
+      REQUIRE(const_span(a, 3, 9).as_native_uint64() == 0x27);
+      REQUIRE(xorr(const_span(a, 3, 9)) == 0);
+      REQUIRE(orr(const_span(a, 0, 3)) == 0);
+
+      span(a, 8, 12).fill(0);
+      REQUIRE(a == bit_vector<12>("000000111000"));
+    }
+  }
+
+  TEST_CASE("Verilog literals") {
+    REQUIRE(bit_vector<8>("8'b1010_0101") == bit_vector<8>("10100101"));
+    REQUIRE(bit_vector<12>("12'o7070") == bit_vector<12>(07070));
+    REQUIRE(bit_vector<20>("20'd1000000") == bit_vector<20>(1000000));
+
+    bit_vector<72> a("72'hAB_0000_0000_0000_00CD");
+    REQUIRE(a.get_word(0) == 0xcd);
+    REQUIRE(a.get_word(1) == 0xab);
+  }
+
+  TEST_CASE("Formatting into buffers") {
+    bit_vector<12> a("12'habc");
+
+    char buf[16];
+    REQUIRE(std::string(buf, a.format_to(buf)) == "101010111100");
+    REQUIRE(std::string(buf, a.format_hex_to(buf)) == "12'habc");
+
+    bit_vector<130> b;
+    b.set(129, 1);
+    b.set(0, 1);
+
+    stringstream ss;
+    ss << b;
+    REQUIRE(ss.str() == "1" + std::string(128, '0') + "1");
+
+    // Wider than one chunk of the stream buffer
+    bit_vector<1100> c;
+    c.set(1099, 1);
+    c.set(3, 1);
+
+    std::string expected(1100, '0');
+    expected[0] = '1';
+    expected[1096] = '1';
+
+    stringstream wide;
+    wide << c;
+    REQUIRE(wide.str() == expected);
+  }
+
+  TEST_CASE("Decimal conversion") {
+    REQUIRE(bit_vector<20>(1000000).to_decimal_string() == "1000000");
+    REQUIRE(bit_vector<70>().to_decimal_string() == "0");
+
+    bit_vector<128> a("128'd340282366920938463463374607431768211455");
+    REQUIRE(a.get_word(0) == ~((bv_uint64) 0));
+    REQUIRE(a.get_word(1) == ~((bv_uint64) 0));
+    REQUIRE(a.to_decimal_string() == "340282366920938463463374607431768211455");
+  }
+
+  TEST_CASE("Binary serialization") {
+    bit_vector<100> a("100'hf_0000_0000_0000_0000_1234");
+    bit_vector<12> b(0xabc);
+
+    std::vector<unsigned char> buffer;
+    a.serialize_to(buffer);
+    b.serialize_to(buffer);
+
+    byte_span in(buffer);
+    bit_vector<100> c;
+    bit_vector<12> d;
+    REQUIRE(!d.deserialize_from(in));
+    REQUIRE(c.deserialize_from(in));
+    REQUIRE(d.deserialize_from(in));
+    REQUIRE(c == a);
+    REQUIRE(d == b);
+    REQUIRE(in.size == 0);
+  }
+
+  TEST_CASE("Memory images and tracing of static vectors") {
+    const temporary_file image("bsim_static_memory");
+    std::ofstream(image.path()) << "@2 1_0000_0001 x_ffff_ffff\n";
+
+    packed_memory mem(33, 4);
+    REQUIRE(load_readmemh(image.path(), mem));
+
+    bit_vector<33> w;
+    mem.read(2, w);
+    REQUIRE(w == bit_vector<33>("33'h1_0000_0001"));
+
+    // x and z bits read as zero
+    mem.read(3, w);
+    REQUIRE(w == bit_vector<33>("33'h0_ffff_ffff"));
+
+    std::ostringstream out;
+    {
+      vcd_writer vcd(out);
+      const int word = vcd.add_signal("word", 33);
+      vcd.end_definitions();
+      vcd.set_time(0);
+      vcd.change(word, w);
+    }
+    REQUIRE(out.str().find("#0\nb" + std::string(32, '1') + " !\n") != std::string::npos);
+  }
+
   TEST_CASE("Adding bit vectors with general add") {
 
     bit_vector<29> a("00000000000000000000011101011");
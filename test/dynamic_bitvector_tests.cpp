@@ -1,6 +1,15 @@
 #include "catch.hpp"
 
 #include "dynamic_bit_vector.h"
+#include "dynamic_bit_vector_expressions.h"
+#include "memory_image.h"
+#include "vcd_writer.h"
+#include "waveform_file.h"
+#include "temporary_file.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 
 using namespace std;
 
@@ -678,6 +687,854 @@ namespace bsim {
 
   }
 
+  TEST_CASE("Multi word operations") {
+    dbv a(130);
+    a.set(129, 1);
+    a.set(64, 1);
+    a.set(3, 1);
+
+    dbv b(130);
+    b.set(129, 1);
+    b.set(63, 1);
+    b.set(3, 1);
+
+    SECTION("And across limbs") {
+      dbv correct(130);
+      correct.set(129, 1);
+      correct.set(3, 1);
+
+      REQUIRE((a & b) == correct);
+    }
+
+    SECTION("Not clears the bits past the end") {
+      dbv c = ~(~a);
+
+      REQUIRE(c == a);
+      REQUIRE(andr(~dbv(130)) == dbv(1, "1"));
+    }
+
+    SECTION("Greater than compares the high limbs first") {
+      REQUIRE(a > b);
+      REQUIRE(b < a);
+      REQUIRE(!(b > a));
+    }
+
+    SECTION("Reductions") {
+      REQUIRE(orr(a) == dbv(1, "1"));
+      REQUIRE(orr(dbv(130)) == dbv(1, "0"));
+      REQUIRE(xorr(a) == dbv(1, "1"));
+      REQUIRE(xorr(a ^ b) == dbv(1, "0"));
+    }
+  }
+
+  TEST_CASE("Two limb arithmetic") {
+    dbv a("96'h00000000ffffffffffffffff");
+    dbv one(96, 1);
+
+    SECTION("Add carries into the high limb") {
+      dbv sum = add_general_width_bv(a, one);
+
+      REQUIRE(sum == dbv("96'h000000010000000000000000"));
+    }
+
+    SECTION("Subtract borrows from the high limb") {
+      dbv b("96'h000000010000000000000000");
+      dbv diff = sub_general_width_bv(b, one);
+
+      REQUIRE(diff == dbv("96'h00000000ffffffffffffffff"));
+    }
+
+    SECTION("Multiply wraps at the width") {
+      dbv b("96'h800000000000000000000003");
+      dbv c = mul_general_width_bv(b, dbv(96, 2));
+
+      REQUIRE(c == dbv("96'h000000000000000000000006"));
+    }
+
+    SECTION("Shifts across the limb boundary") {
+      dbv b("72'h800000000000000001");
+
+      REQUIRE(shl(b, dbv(8, 64)) == dbv("72'h010000000000000000"));
+      REQUIRE(lshr(b, dbv(8, 64)) == dbv("72'h000000000000000080"));
+      REQUIRE(ashr(b, dbv(8, 64)) == dbv("72'hffffffffffffffff80"));
+    }
+  }
+
+  TEST_CASE("Dynamic carry chain over many limbs") {
+    dbv ones(300);
+    for (int i = 0; i < 290; i++) {
+      ones.set(i, 1);
+    }
+
+    dbv one(300, 1);
+
+    dbv top(300);
+    top.set(290, 1);
+
+    REQUIRE(add_general_width_bv(ones, one) == top);
+    REQUIRE(sub_general_width_bv(top, one) == ones);
+    REQUIRE(sub_general_width_bv(dbv(300), one) == ~dbv(300));
+  }
+
+  TEST_CASE("Wide multiplication") {
+    // (2^k - 1)^2 = 2^2k - 2^(k + 1) + 1
+
+    SECTION("Schoolbook") {
+      dbv a(512);
+      for (int i = 0; i < 250; i++) {
+        a.set(i, 1);
+      }
+
+      dbv correct(512);
+      correct.set(0, 1);
+      for (int i = 251; i < 500; i++) {
+        correct.set(i, 1);
+      }
+
+      REQUIRE(mul_general_width_bv(a, a) == correct);
+    }
+
+    SECTION("Karatsuba") {
+      dbv a(4096);
+      for (int i = 0; i < 2000; i++) {
+        a.set(i, 1);
+      }
+
+      dbv correct(4096);
+      correct.set(0, 1);
+      for (int i = 2001; i < 4000; i++) {
+        correct.set(i, 1);
+      }
+
+      REQUIRE(mul_general_width_bv(a, a) == correct);
+    }
+  }
+
+  TEST_CASE("Division") {
+
+    SECTION("Unsigned 300 bit quotient and remainder") {
+      dbv a(300);
+      a.set(290, 1);
+      a.set(3, 1);
+
+      dbv b(300);
+      b.set(150, 1);
+      b.set(0, 1);
+
+      dbv q, r;
+      unsigned_div_rem(a, b, q, r);
+
+      REQUIRE(add_general_width_bv(mul_general_width_bv(q, b), r) == a);
+      REQUIRE(r < b);
+      REQUIRE(unsigned_divide(a, b) == q);
+      REQUIRE(unsigned_rem(a, b) == r);
+    }
+
+    SECTION("Signed division of 70 bit numbers") {
+      dbv minus_100 = sub_general_width_bv(dbv(70), dbv(70, 100));
+      dbv minus_14 = sub_general_width_bv(dbv(70), dbv(70, 14));
+      dbv minus_2 = sub_general_width_bv(dbv(70), dbv(70, 2));
+
+      REQUIRE(signed_divide(minus_100, dbv(70, 7)) == minus_14);
+      REQUIRE(signed_rem(minus_100, dbv(70, 7)) == minus_2);
+      REQUIRE(signed_divide(minus_100, minus_14) == dbv(70, 7));
+    }
+
+    SECTION("Division by zero gives all ones and the dividend") {
+      dbv a(300);
+      a.set(290, 1);
+      a.set(3, 1);
+
+      REQUIRE(unsigned_divide(a, dbv(300)) == ~dbv(300));
+      REQUIRE(unsigned_rem(a, dbv(300)) == a);
+
+      dbv minus_100 = sub_general_width_bv(dbv(70), dbv(70, 100));
+      REQUIRE(signed_divide(minus_100, dbv(70)) == ~dbv(70));
+      REQUIRE(signed_rem(minus_100, dbv(70)) == minus_100);
+    }
+
+    SECTION("Quotient and remainder written over the operands") {
+      dbv a(130, 1000);
+      dbv b(130, 7);
+      unsigned_div_rem(a, b, a, b);
+
+      REQUIRE(a == dbv(130, 142));
+      REQUIRE(b == dbv(130, 6));
+    }
+  }
+
+  TEST_CASE("Wide shifts and rotates") {
+    dbv a(1024);
+    a.set(1023, 1);
+    a.set(700, 1);
+    a.set(5, 1);
+
+    SECTION("Shift left across limbs") {
+      dbv correct(1024);
+      correct.set(900, 1);
+      correct.set(205, 1);
+
+      REQUIRE(shl(a, dbv(16, 200)) == correct);
+    }
+
+    SECTION("Logical and arithmetic shift right") {
+      dbv correct(1024);
+      correct.set(893, 1);
+      correct.set(570, 1);
+
+      REQUIRE(lshr(a, dbv(16, 130)) == correct);
+
+      dbv sign_fill = ashr(a, dbv(16, 1000));
+      REQUIRE(sign_fill.get(1023) == 1);
+      REQUIRE(sign_fill.get(23) == 1);
+      REQUIRE(sign_fill.get(22) == 0);
+    }
+
+    SECTION("Shifting by the width or more") {
+      REQUIRE(shl(a, dbv(16, 1024)) == dbv(1024));
+      REQUIRE(lshr(a, dbv(16, 5000)) == dbv(1024));
+      REQUIRE(ashr(a, dbv(16, 1024)) == ~dbv(1024));
+
+      dbv huge(200);
+      huge.set(150, 1);
+      REQUIRE(lshr(a, huge) == dbv(1024));
+      REQUIRE(ashr(dbv(7, 3), dbv(3, 7)) == dbv(7, 0));
+    }
+
+    SECTION("Rotates") {
+      dbv correct(1024);
+      correct.set(1003, 1);
+      correct.set(680, 1);
+      correct.set(1009, 1);
+
+      REQUIRE(rotate_left(a, dbv(16, 1004)) == correct);
+      REQUIRE(rotate_right(correct, dbv(16, 1004)) == a);
+      REQUIRE(rotate_left(a, dbv(16, 1024)) == a);
+      REQUIRE(rotate_left(dbv(10, 3), dbv(8, 19)) == dbv(10, 513));
+    }
+  }
+
+  TEST_CASE("Dynamic bit scans") {
+    dbv a(200);
+    a.set(190, 1);
+    a.set(64, 1);
+    a.set(63, 1);
+
+    REQUIRE(popcount(a) == 3);
+    REQUIRE(find_first_set(a) == 63);
+    REQUIRE(find_next_set(a, 64) == 64);
+    REQUIRE(find_next_set(a, 65) == 190);
+    REQUIRE(find_next_set(a, 191) == -1);
+    REQUIRE(find_last_set(a) == 190);
+    REQUIRE(count_leading_zeros(a) == 9);
+    REQUIRE(count_trailing_zeros(a) == 63);
+    REQUIRE(count_trailing_zeros(dbv(200)) == 200);
+    REQUIRE(xorr(a) == dbv(1, 1));
+    REQUIRE(andr(~dbv(200)) == dbv(1, 1));
+  }
+
+  TEST_CASE("Dynamic copies across the inline limit") {
+    dbv narrow(BV_DYNAMIC_INLINE_BITS, 5);
+    dbv wide(BV_DYNAMIC_INLINE_BITS + 1, 9);
+    wide.set(BV_DYNAMIC_INLINE_BITS, 1);
+
+    dbv c = wide;
+    REQUIRE(c == wide);
+    REQUIRE(c.word_data() != wide.word_data());
+
+    c = narrow;
+    REQUIRE(c == narrow);
+
+    c = wide;
+    REQUIRE(c.get(BV_DYNAMIC_INLINE_BITS) == 1);
+    REQUIRE(c.get(0) == 1);
+    REQUIRE(c.get(3) == 1);
+  }
+
+  TEST_CASE("Dynamic move construction and assignment") {
+    REQUIRE(std::is_nothrow_move_constructible<dbv>::value);
+    REQUIRE(std::is_nothrow_move_assignable<dbv>::value);
+
+    const int wide = BV_DYNAMIC_INLINE_BITS + 72;
+    dbv a(wide);
+    a.set(wide - 50, 1);
+    const bv_uint64* limbs = a.word_data();
+
+    dbv b(std::move(a));
+    REQUIRE(b.word_data() == limbs);
+    REQUIRE(b.bitLength() == wide);
+    REQUIRE(b.get(wide - 50) == 1);
+    REQUIRE(a.bitLength() == 0);
+
+    a = std::move(b);
+    REQUIRE(a.word_data() == limbs);
+    REQUIRE(a.get(wide - 50) == 1);
+    REQUIRE(b.bitLength() == 0);
+
+    dbv small(BV_DYNAMIC_INLINE_BITS, 7);
+    dbv small_moved(std::move(small));
+    REQUIRE(small_moved == dbv(BV_DYNAMIC_INLINE_BITS, 7));
+    REQUIRE(small.bitLength() == 0);
+
+    std::vector<dbv> vs;
+    for (int i = 0; i < 100; i++) {
+      vs.push_back(dbv(130, i));
+    }
+    for (int i = 0; i < 100; i++) {
+      REQUIRE(vs[i] == dbv(130, i));
+    }
+  }
+
+  TEST_CASE("Dynamic compound assignment") {
+    dbv state(200, 0);
+    state.set(0, 1);
+
+    dbv mask(200, 0);
+    mask.set(130, 1);
+    mask.set(0, 1);
+
+    state ^= mask;
+    REQUIRE(state == shl(dbv(200, 1), dbv(8, 130)));
+
+    state |= dbv(200, 3);
+    state &= mask;
+    REQUIRE(state == mask);
+
+    state <<= 69;
+    REQUIRE(find_first_set(state) == 69);
+    REQUIRE(find_last_set(state) == 199);
+
+    state >>= dbv(8, 69);
+    REQUIRE(state == mask);
+
+    dbv ones = ~dbv(130);
+    dbv acc = ones;
+    acc += dbv(130, 1);
+    REQUIRE(acc == dbv(130, 0));
+    acc -= dbv(130, 1);
+    REQUIRE(acc == ones);
+  }
+
+  TEST_CASE("Lazy bitwise expressions") {
+    dbv a(150, 0x0ff0);
+    dbv b(150, 0x3c3c);
+    dbv c(150, 0x5555);
+    dbv d(150, 0x00ff);
+    a.set(140, 1);
+    c.set(140, 1);
+
+    dbv eager = (a & b) | (~c ^ d);
+
+    dbv fused = (lazy(a) & b) | (~lazy(c) ^ d);
+    REQUIRE(fused == eager);
+    REQUIRE(fused.bitLength() == 150);
+
+    dbv r(150, 7);
+    const bv_uint64* limbs = r.word_data();
+    r = lazy(a) ^ b;
+    REQUIRE(r == (a ^ b));
+    REQUIRE(r.word_data() == limbs);
+
+    r = ~lazy(r) | c;
+    REQUIRE(r == (~(a ^ b) | c));
+    REQUIRE(r.word_data() == limbs);
+    r = lazy(a) ^ b;
+
+    // The destination may also be an operand
+    evaluate_into(r, ~lazy(r) & c);
+    REQUIRE(r == (~(a ^ b) & c));
+
+    dbv narrow(3);
+    evaluate_into(narrow, lazy(a) | d);
+    REQUIRE(narrow == (a | d));
+  }
+
+  TEST_CASE("Dynamic bit spans") {
+    dbv packet(300);
+    span(packet, 100, 232).set_word(1, 0xffffffffffffffffULL);
+    span(packet, 100, 232).set(0, 1);
+
+    REQUIRE(packet.get(100) == 1);
+    REQUIRE(packet.get(164) == 1);
+    REQUIRE(packet.get(227) == 1);
+    REQUIRE(packet.get(228) == 0);
+    REQUIRE(popcount(const_span(packet, 100, 232)) == 65);
+
+    const_bit_span header = const_span(packet, 160, 170);
+    REQUIRE(header.subspan(4, 10) == const_span(dbv(6, 0x3f)));
+    REQUIRE(to_dynamic_bit_vector(header) == slice(packet, 160, 170));
+    REQUIRE(concat(slice(packet, 0, 120), slice(packet, 120, 300)) == packet);
+  }
+
+  TEST_CASE("Dynamic arena allocation") {
+    bit_vector_arena arena(1024);
+    dbv reg(300);
+
+    for (int cycle = 0; cycle < 10; cycle++) {
+      {
+        arena_scope scope(arena);
+        dbv next = add_general_width_bv(reg, dbv(300, 1));
+        REQUIRE(bit_vector_arena::current() == &arena);
+
+        // reg was made outside the scope, so this copies into its own
+        // storage instead of taking the arena's
+        reg = std::move(next);
+      }
+      arena.reset();
+    }
+
+    REQUIRE(bit_vector_arena::current() == nullptr);
+    REQUIRE(reg == dbv(300, 10));
+    REQUIRE(arena.bytes_reserved() == 1024);
+
+    {
+      arena_scope scope(arena);
+      dbv huge(64*300);
+      huge.set(64*300 - 1, 1);
+      REQUIRE(find_last_set(huge) == 64*300 - 1);
+    }
+    arena.reset();
+    REQUIRE(arena.bytes_reserved() == 1024);
+
+    // Temporaries pushed into a longer lived container are copied out of
+    // the arena
+    std::vector<dbv> regs;
+    {
+      arena_scope scope(arena);
+      regs.push_back(add_general_width_bv(reg, dbv(300, 1)));
+      regs.push_back(dbv(100, 3));
+    }
+    arena.reset();
+
+    {
+      arena_scope scope(arena);
+      dbv reuse = ~dbv(300, 0);
+      REQUIRE(popcount(reuse) == 300);
+    }
+    arena.reset();
+
+    REQUIRE(regs[0] == dbv(300, 11));
+    REQUIRE(regs[1] == dbv(100, 3));
+
+    // Growing the element past the inline limbs allocates from the heap
+    // too, not from the arena it was made in
+    regs[1] = dbv(300, 4);
+    {
+      arena_scope scope(arena);
+      dbv reuse = ~dbv(300, 0);
+    }
+    arena.reset();
+    REQUIRE(regs[1] == dbv(300, 4));
+  }
+
+  TEST_CASE("Dynamic Verilog literals") {
+    SECTION("Every base") {
+      REQUIRE(dynamic_bit_vector("4'b1010") == dynamic_bit_vector(4, 10));
+      REQUIRE(dynamic_bit_vector("12'o7_7_7") == dynamic_bit_vector(12, 511));
+      REQUIRE(dynamic_bit_vector("16'd65_535") == dynamic_bit_vector(16, 65535));
+      REQUIRE(dynamic_bit_vector("8'hFf") == dynamic_bit_vector(8, 255));
+      REQUIRE(dynamic_bit_vector("8'SH80") == dynamic_bit_vector(8, 128));
+    }
+
+    SECTION("Unsized literals are 32 bits") {
+      dynamic_bit_vector a("'hdead_BEEF");
+      REQUIRE(a.bitLength() == 32);
+      REQUIRE(a.to_type<bv_uint32>() == 0xdeadbeef);
+    }
+
+    SECTION("Digits past the width are dropped") {
+      REQUIRE(dynamic_bit_vector("4'hff") == dynamic_bit_vector(4, 15));
+      REQUIRE(dynamic_bit_vector("10'd1025") == dynamic_bit_vector(10, 1));
+    }
+
+    SECTION("Wide literals") {
+      dynamic_bit_vector ones(100, std::string(100, '1'));
+      REQUIRE(dynamic_bit_vector("100'd1267650600228229401496703205375") == ones);
+      REQUIRE(dynamic_bit_vector("100'hf_ffff_ffff_ffff_ffff_ffff_ffff") == ones);
+
+      dynamic_bit_vector a("130'h2_0000_0000_0000_0000_0000_0000_0000_0001");
+      REQUIRE(a.get(129) == 1);
+      REQUIRE(a.get(0) == 1);
+      REQUIRE(popcount(const_span(a)) == 2);
+    }
+  }
+
+  TEST_CASE("Dynamic formatting into buffers") {
+    SECTION("Binary and hex digits") {
+      dynamic_bit_vector a("70'h3f_0000_0000_0000_00a5");
+
+      char buf[80];
+      char* end = a.format_to(buf);
+      REQUIRE(end - buf == 70);
+      REQUIRE(std::string(buf, end) ==
+              "111111" + std::string(56, '0') + "10100101");
+
+      end = a.format_hex_to(buf);
+      REQUIRE(std::string(buf, end) == "70'h3f00000000000000a5");
+      REQUIRE(end - buf == hex_format_length(70));
+      REQUIRE(dynamic_bit_vector("9'h1ff").hex_string() == "9'h1ff");
+    }
+
+    SECTION("Streaming wide vectors") {
+      dynamic_bit_vector a(1500);
+      a.set(1499, 1);
+      a.set(700, 1);
+      a.set(3, 1);
+
+      std::string expected(1500, '0');
+      expected[0] = '1';
+      expected[1499 - 700] = '1';
+      expected[1499 - 3] = '1';
+
+      stringstream ss;
+      ss << a;
+      REQUIRE(ss.str() == expected);
+    }
+  }
+
+  TEST_CASE("Dynamic decimal conversion") {
+    SECTION("Narrow values") {
+      REQUIRE(dynamic_bit_vector(16, 0).to_decimal_string() == "0");
+      REQUIRE(dynamic_bit_vector(16, 65535).to_decimal_string() == "65535");
+
+      dynamic_bit_vector a("128'hffff_ffff_ffff_ffff_ffff_ffff_ffff_ffff");
+      REQUIRE(a.to_decimal_string() == "340282366920938463463374607431768211455");
+      REQUIRE(dynamic_bit_vector("128'd340282366920938463463374607431768211455") == a);
+    }
+
+    SECTION("Values split around powers of ten") {
+      std::string nines(600, '9');
+      std::string power = "1" + std::string(600, '0');
+
+      dynamic_bit_vector a("2000'd" + nines);
+      dynamic_bit_vector b("2000'd" + power);
+      REQUIRE(a.to_decimal_string() == nines);
+      REQUIRE(b.to_decimal_string() == power);
+
+      dynamic_bit_vector one(2000, 1);
+      REQUIRE(add_general_width_bv(a, one) == b);
+    }
+
+    SECTION("Round trip") {
+      std::string digits;
+      for (int i = 0; i < 2500; i++) {
+        digits += '1' + ((7*i + i / 13) % 9);
+      }
+
+      dynamic_bit_vector a("8400'd" + digits);
+      REQUIRE(a.to_decimal_string() == digits);
+    }
+  }
+
+  TEST_CASE("Dynamic binary serialization") {
+    dynamic_bit_vector a("200'h8a_0000_0000_0000_0000_0000_0000_0000_0000_0000_0000_0000_0001");
+    dynamic_bit_vector b(5, 19);
+
+    std::vector<unsigned char> buffer;
+    a.serialize_to(buffer);
+    b.serialize_to(buffer);
+    REQUIRE(buffer.size() == a.serialized_size() + b.serialized_size());
+    REQUIRE(a.serialized_size() == 8 + 4*8);
+
+    SECTION("Records are read back in order") {
+      byte_span in(buffer);
+      dynamic_bit_vector c;
+      REQUIRE(c.deserialize_from(in));
+      REQUIRE(c == a);
+      REQUIRE(c.deserialize_from(in));
+      REQUIRE(c == b);
+      REQUIRE(in.size == 0);
+      REQUIRE(!c.deserialize_from(in));
+    }
+
+    SECTION("Truncated and unknown records are rejected") {
+      byte_span truncated(buffer.data(), a.serialized_size() - 1);
+      dynamic_bit_vector c(5, 3);
+      REQUIRE(!c.deserialize_from(truncated));
+      REQUIRE(truncated.size == a.serialized_size() - 1);
+      REQUIRE(c == dynamic_bit_vector(5, 3));
+
+      buffer[0] = BV_SERIAL_VERSION + 1;
+      byte_span newer(buffer);
+      REQUIRE(!c.deserialize_from(newer));
+    }
+  }
+
+  TEST_CASE("VCD tracing") {
+    std::ostringstream out;
+
+    {
+      vcd_writer vcd(out, "1ps", 64);
+      vcd.push_scope("top");
+      const int clk = vcd.add_signal("clk", 1);
+      const int data = vcd.add_signal("data", 100);
+      vcd.pop_scope();
+      vcd.end_definitions();
+
+      REQUIRE(vcd.num_signals() == 2);
+      REQUIRE(vcd.signal_id(clk) == "!");
+      REQUIRE(vcd.signal_id(data) == "\"");
+
+      dynamic_bit_vector d(100, 5);
+
+      vcd.set_time(0);
+      vcd.change(clk, dynamic_bit_vector(1, 0));
+      vcd.change(data, d);
+
+      // Nothing changes, so no time is written
+      vcd.set_time(5);
+      vcd.change(clk, dynamic_bit_vector(1, 0));
+      vcd.change(data, d);
+
+      vcd.set_time(10);
+      vcd.change(clk, dynamic_bit_vector(1, 1));
+      vcd.change(data, d);
+
+      d.set(99, 1);
+      vcd.set_time(20);
+      vcd.change(clk, dynamic_bit_vector(1, 1));
+      vcd.change(data, d);
+    }
+
+    std::string expected =
+      "$timescale 1ps $end\n"
+      "$scope module top $end\n"
+      "$var wire 1 ! clk $end\n"
+      "$var wire 100 \" data $end\n"
+      "$upscope $end\n"
+      "$enddefinitions $end\n"
+      "#0\n"
+      "0!\n"
+      "b101 \"\n"
+      "#10\n"
+      "1!\n"
+      "#20\n"
+      "b1" + std::string(96, '0') + "101 \"\n";
+
+    REQUIRE(out.str() == expected);
+  }
+
+  TEST_CASE("VCD identifiers") {
+    std::ostringstream out;
+    vcd_writer vcd(out);
+    for (int i = 0; i < 95; i++) {
+      vcd.add_signal("s", 8);
+    }
+
+    REQUIRE(vcd.signal_id(93) == "~");
+    REQUIRE(vcd.signal_id(94) == "!\"");
+  }
+
+  struct collect_changes {
+    std::vector<bv_uint64>& times;
+    std::vector<dynamic_bit_vector>& values;
+    int width;
+
+    void operator()(const bv_uint64 t,
+                    const bv_uint64* value,
+                    const bv_uint64*) {
+      dynamic_bit_vector v(width);
+      for (int i = 0; i < NUM_WORDS(width); i++) {
+        v.set_word(i, value[i]);
+      }
+      times.push_back(t);
+      values.push_back(v);
+    }
+  };
+
+  TEST_CASE("Waveform files") {
+    const temporary_file wave_file("bsim_waveform");
+    const std::string& path = wave_file.path();
+
+    {
+      std::ofstream file(path, std::ios::binary);
+      waveform_writer wave(file, 64);
+      const int counter = wave.add_signal("counter", 130);
+      const int slow = wave.add_signal("slow", 8);
+
+      // counter changes every step, slow every 100 steps, so blocks fill
+      // up with counter values and most have no column for slow
+      dynamic_bit_vector c(130, 0);
+      for (int t = 0; t < 1000; t++) {
+        wave.set_time(10*t);
+        c = add_general_width_bv(c, dynamic_bit_vector(130, 1));
+        if (t == 500) {
+          c.set(129, 1);
+        }
+        wave.change(counter, c);
+        wave.change(slow, dynamic_bit_vector(8, t / 100));
+      }
+
+      REQUIRE(wave.num_blocks() > 10);
+    }
+
+    waveform_reader reader;
+    REQUIRE(reader.open(path));
+    REQUIRE(reader.num_signals() == 2);
+    REQUIRE(reader.num_blocks() > 10);
+    REQUIRE(reader.find_signal("slow") == 1);
+    REQUIRE(reader.find_signal("fast") == -1);
+    REQUIRE(reader.signal_width(0) == 130);
+
+    SECTION("Values at a time") {
+      dynamic_bit_vector v(130);
+      REQUIRE(reader.value_at(0, 0, v));
+      REQUIRE(v == dynamic_bit_vector(130, 1));
+
+      REQUIRE(reader.value_at(0, 4005, v));
+      REQUIRE(v == dynamic_bit_vector(130, 401));
+
+      dynamic_bit_vector top(130, 502);
+      top.set(129, 1);
+      REQUIRE(reader.value_at(0, 5019, v));
+      REQUIRE(v == top);
+
+      // The last change of slow is many blocks before these times
+      dynamic_bit_vector s(8);
+      REQUIRE(reader.value_at(1, 3990, s));
+      REQUIRE(s == dynamic_bit_vector(8, 3));
+      REQUIRE(reader.value_at(1, 100000, s));
+      REQUIRE(s == dynamic_bit_vector(8, 9));
+    }
+
+    SECTION("Changes in a window") {
+      std::vector<bv_uint64> times;
+      std::vector<dynamic_bit_vector> values;
+      collect_changes f{times, values, 8};
+
+      REQUIRE(reader.for_each_change(1, 2500, 5000, f));
+      REQUIRE(times.size() == 4);
+      REQUIRE(times[0] == 2000);
+      REQUIRE(values[0] == dynamic_bit_vector(8, 2));
+      REQUIRE(times[3] == 5000);
+      REQUIRE(values[3] == dynamic_bit_vector(8, 5));
+    }
+
+    SECTION("Other files are rejected") {
+      waveform_reader other;
+      REQUIRE(!other.open("no_such_waveform_file.wave"));
+
+      const temporary_file bad("bsim_bad_waveform");
+      std::ofstream(bad.path()) << "not a waveform file at all";
+      REQUIRE(!other.open(bad.path()));
+    }
+  }
+
+  TEST_CASE("Memory images") {
+    const temporary_file image("bsim_memory");
+    const std::string& path = image.path();
+    packed_memory mem(20, 64);
+
+    SECTION("Words, comments and addresses") {
+      std::ofstream(path) <<
+        "// boot rom\n"
+        "1_2345 abcde /* two words\n"
+        "   ffff */ 7\n"
+        "@10 fffff\n"
+        "\t@0_3 00001// after\n";
+
+      REQUIRE(load_readmemh(path, mem));
+      REQUIRE(!mem.has_unknown_plane());
+
+      dynamic_bit_vector v(20);
+      mem.read(0, v);
+      REQUIRE(v == dynamic_bit_vector(20, 0x12345));
+      mem.read(1, v);
+      REQUIRE(v == dynamic_bit_vector(20, 0xabcde));
+      mem.read(2, v);
+      REQUIRE(v == dynamic_bit_vector(20, 7));
+      mem.read(3, v);
+      REQUIRE(v == dynamic_bit_vector(20, 1));
+      mem.read(16, v);
+      REQUIRE(v == dynamic_bit_vector(20, 0xfffff));
+      mem.read(4, v);
+      REQUIRE(v == dynamic_bit_vector(20, 0));
+    }
+
+    SECTION("Binary images load from the start address") {
+      std::ofstream(path) << "1010 0000_0000_0000_0000_0001\n";
+
+      REQUIRE(load_readmemb(path, mem, 62));
+
+      dynamic_bit_vector v(20);
+      mem.read(62, v);
+      REQUIRE(v == dynamic_bit_vector(20, 10));
+      mem.read(63, v);
+      REQUIRE(v == dynamic_bit_vector(20, 1));
+    }
+
+    SECTION("Bad images are rejected") {
+      REQUIRE(!load_readmemh("no_such_memory_image.hex", mem));
+
+      std::ofstream(path) << "12 3g\n";
+      REQUIRE(!load_readmemh(path, mem));
+
+      std::ofstream(path) << "@4x 12\n";
+      REQUIRE(!load_readmemh(path, mem));
+
+      std::ofstream(path) << "@3f 1 2\n";
+      REQUIRE(!load_readmemh(path, mem));
+
+      std::ofstream(path) << "12\n";
+      REQUIRE(!load_readmemb(path, mem));
+    }
+
+    SECTION("Later words win when directives overlap") {
+      const int depth = 150000;
+      packed_memory large(32, depth);
+
+      {
+        std::ofstream file(path);
+        file << "@0\n";
+        for (int i = 0; i < depth; i++) {
+          file << "00000001\n";
+        }
+        file << "@0\n";
+        for (int i = 0; i < depth; i++) {
+          file << "00000002\n";
+        }
+        file << "@10 00000003\n";
+      }
+
+      REQUIRE(load_readmem(path, 4, large, 0, 8));
+
+      bool all_later = true;
+      for (int i = 0; i < depth; i++) {
+        const bv_uint64 expected = i == 16 ? 3 : 2;
+        all_later = all_later && (large.get_value_word(i, 0) == expected);
+      }
+      REQUIRE(all_later);
+    }
+
+    SECTION("Large images are split between threads") {
+      const int depth = 200000;
+      packed_memory large(100, depth);
+
+      {
+        std::ofstream file(path);
+        char word[32];
+        for (int i = 0; i < depth; i++) {
+          if (i % 1000 == 0) {
+            file << "/* block " << i << "\n  comment ffff @0 */\n// line @1 ffff\n@" << std::hex << i << std::dec << "\n";
+          }
+          snprintf(word, sizeof(word), "%x_%08x\n", i % 7, i);
+          file << word;
+        }
+      }
+
+      REQUIRE(load_readmem(path, 4, large, 0, 8));
+
+      dynamic_bit_vector v(100);
+      for (int i = 0; i < depth; i += 997) {
+        large.read(i, v);
+        dynamic_bit_vector expected(100, i % 7);
+        expected = shl(expected, dynamic_bit_vector(100, 32));
+        expected = expected | dynamic_bit_vector(100, i);
+        REQUIRE(v == expected);
+      }
+    }
+  }
+
   TEST_CASE("Signed comparison") {
 
     SECTION("Greater than") {
@@ -1,6 +1,14 @@
 #include "catch.hpp"
 
 #include "quad_value_bit_vector.h"
+#include "memory_image.h"
+#include "vcd_writer.h"
+#include "waveform_file.h"
+#include "temporary_file.h"
+
+#include <fstream>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 
@@ -8,6 +16,26 @@ namespace bsim {
 
   typedef quad_value_bit_vector dbv;
 
+  // First in the file so the reductions first run inside the scope
+  TEST_CASE("Quad value reduction constants outlive arenas") {
+    bit_vector_arena arena;
+    {
+      arena_scope scope(arena);
+      REQUIRE(orr(quad_value_bit_vector(8, 0)) == quad_value_bit_vector(1, 0));
+
+      quad_value_bit_vector heap(300, 7, arena_allocator<bv_uint64>(nullptr));
+      REQUIRE(heap == quad_value_bit_vector(300, 7));
+    }
+    arena.reset();
+
+    {
+      arena_scope scope(arena);
+      std::vector<quad_value_bit_vector> reuse(20, quad_value_bit_vector("64'hz"));
+      REQUIRE(same_representation(orr(quad_value_bit_vector(8, 0)), quad_value_bit_vector(1, 0)));
+      REQUIRE(same_representation(andr(quad_value_bit_vector(8, 255)), quad_value_bit_vector(1, 1)));
+    }
+  }
+
   TEST_CASE("Quad_Value vector comparison") {
 
     SECTION("3 bits") {
@@ -418,6 +446,24 @@ namespace bsim {
 	REQUIRE(c == quad_value_bit_vector(32, cn));
       }
 
+      SECTION("200 bit numbers") {
+        quad_value_bit_vector a(200);
+        a.set(150, 1);
+        a.set(3, 1);
+
+        quad_value_bit_vector b(200);
+        b.set(40, 1);
+        b.set(1, 1);
+
+        quad_value_bit_vector correct(200);
+        correct.set(190, 1);
+        correct.set(151, 1);
+        correct.set(43, 1);
+        correct.set(4, 1);
+
+        REQUIRE(mul_general_width_bv(a, b) == correct);
+      }
+
       SECTION("Unknown values") {
         dbv a("32'hxx0fx1b3");
         dbv b("32'h11934891");
@@ -426,6 +472,33 @@ namespace bsim {
       }
     }
 
+    SECTION("Division") {
+
+      SECTION("Binary operands") {
+        dbv a(100, 1000);
+        a.set(80, 1);
+        dbv b(100, 37);
+
+        dbv q, r;
+        unsigned_div_rem(a, b, q, r);
+
+        REQUIRE(add_general_width_bv(mul_general_width_bv(q, b), r) == a);
+        REQUIRE(r < b);
+      }
+
+      SECTION("Signed") {
+        dbv minus_9 = sub_general_width_bv(dbv(16, 0), dbv(16, 9));
+
+        REQUIRE(signed_divide(minus_9, dbv(16, 2)) == sub_general_width_bv(dbv(16, 0), dbv(16, 4)));
+        REQUIRE(signed_rem(minus_9, dbv(16, 2)) == sub_general_width_bv(dbv(16, 0), dbv(16, 1)));
+      }
+
+      SECTION("Unknowns and zero divisors give x") {
+        REQUIRE(same_representation(unsigned_divide(dbv("8'h1x"), dbv("8'h03")), dbv("8'hxx")));
+        REQUIRE(same_representation(unsigned_rem(dbv("8'h13"), dbv("8'h00")), dbv("8'hxx")));
+      }
+    }
+
     SECTION("Logical and bit vectors") {
 
       SECTION("x values") {
@@ -628,6 +701,509 @@ namespace bsim {
     }
   }
 
+  TEST_CASE("Quad value packed logic") {
+
+    SECTION("High impedance inputs behave like unknowns") {
+      dbv a(4, "zz10");
+      dbv b(4, "01zz");
+
+      REQUIRE(same_representation(a & b, dbv(4, "0xx0")));
+      REQUIRE(same_representation(a | b, dbv(4, "x11x")));
+      REQUIRE(same_representation(a ^ b, dbv(4, "xxxx")));
+      REQUIRE(same_representation(~a, dbv(4, "xx01")));
+    }
+
+    SECTION("Unknowns across limbs") {
+      dbv a(100);
+      a.set(99, QBV_UNKNOWN_VALUE);
+      a.set(70, 1);
+      a.set(2, QBV_HIGH_IMPEDANCE_VALUE);
+
+      dbv b(100);
+      b.set(99, 1);
+      b.set(70, 1);
+
+      dbv c = a & b;
+
+      REQUIRE(c.get(99).is_unknown());
+      REQUIRE(c.get(70) == 1);
+      REQUIRE(c.get(2) == 0);
+      REQUIRE(!c.is_binary());
+      REQUIRE(same_representation(~(~b), b));
+    }
+
+    SECTION("Unknowns are not equal to themselves") {
+      dbv a(70, "x0");
+
+      REQUIRE(!(a == a));
+      REQUIRE(same_representation(a, a));
+    }
+  }
+
+  TEST_CASE("Quad value spans") {
+    quad_value_bit_vector a(150);
+    a.set(149, 1);
+    a.set(100, quad_value(QBV_HIGH_IMPEDANCE_VALUE));
+    a.set(70, quad_value(QBV_UNKNOWN_VALUE));
+    a.set(65, 1);
+
+    SECTION("Fields read both planes") {
+      const_quad_bit_span field = const_span(a, 60, 110);
+      REQUIRE(field.bitLength() == 50);
+      REQUIRE(field.get_value_word(0) == ((((bv_uint64) 1) << 5) | (((bv_uint64) 1) << 40)));
+      REQUIRE(field.get_unknown_word(0) == ((((bv_uint64) 1) << 10) | (((bv_uint64) 1) << 40)));
+      REQUIRE(!field.is_binary());
+      REQUIRE(field.subspan(0, 10).is_binary());
+
+      REQUIRE(same_representation(slice(a, 60, 110), to_quad_value_bit_vector(field)));
+      REQUIRE(slice(a, 60, 110).binary_string() ==
+              std::string(9, '0') + "z" + std::string(29, '0') + "x0000100000");
+    }
+
+    SECTION("Writes keep the binary summary") {
+      quad_value_bit_vector b(150, 0);
+      REQUIRE(b.is_binary());
+
+      span(b, 60, 110).assign(const_span(a, 60, 110));
+      REQUIRE(!b.is_binary());
+      REQUIRE(same_representation(const_span(b, 60, 110), const_span(a, 60, 110)));
+      REQUIRE(b.get(65) == quad_value(1));
+      REQUIRE(b.get(149) == quad_value(0));
+
+      span(b, 60, 110).assign(const_span(quad_value_bit_vector(50, 3)));
+      REQUIRE(b.is_binary());
+      REQUIRE(b.get(61) == quad_value(1));
+    }
+
+    SECTION("Concatenation keeps x and z") {
+      quad_value_bit_vector c = concat(a, quad_value_bit_vector("3'bxz1"));
+      REQUIRE(c.bitLength() == 153);
+      REQUIRE(c.get(150).same_representation(quad_value(1)));
+      REQUIRE(c.get(151).same_representation(quad_value(QBV_HIGH_IMPEDANCE_VALUE)));
+      REQUIRE(c.get(152).same_representation(quad_value(QBV_UNKNOWN_VALUE)));
+      REQUIRE(same_representation(const_span(c, 0, 150), const_span(a)));
+    }
+  }
+
+  TEST_CASE("Quad value bit scans") {
+    quad_value_bit_vector a(12);
+    a.set(11, quad_value(1));
+    a.set(9, quad_value(QBV_UNKNOWN_VALUE));
+    a.set(8, quad_value(1));
+    a.set(6, quad_value(QBV_HIGH_IMPEDANCE_VALUE));
+    a.set(2, quad_value(1));
+
+    REQUIRE(popcount(a) == 3);
+    REQUIRE(find_first_set(a) == 2);
+    REQUIRE(find_next_set(a, 3) == 8);
+    REQUIRE(find_last_set(a) == 11);
+    REQUIRE(count_trailing_zeros(a) == 2);
+    REQUIRE(xorr(a) == quad_value_bit_vector(1, 1));
+    REQUIRE(andr(a) == quad_value_bit_vector(1, 0));
+
+    // Scans across limbs skip limbs whose ones are all unknown
+    quad_value_bit_vector w(200);
+    w.set(199, quad_value(QBV_UNKNOWN_VALUE));
+    w.set(150, quad_value(QBV_HIGH_IMPEDANCE_VALUE));
+    w.set(130, quad_value(1));
+    w.set(70, quad_value(QBV_UNKNOWN_VALUE));
+    w.set(5, quad_value(1));
+
+    REQUIRE(find_first_set(w) == 5);
+    REQUIRE(find_next_set(w, 6) == 130);
+    REQUIRE(find_next_set(w, 131) == -1);
+    REQUIRE(find_next_set(w, 500) == -1);
+    REQUIRE(find_last_set(w) == 130);
+    REQUIRE(count_leading_zeros(w) == 69);
+  }
+
+  TEST_CASE("Quad value move construction and assignment") {
+    REQUIRE(std::is_nothrow_move_constructible<quad_value_bit_vector>::value);
+    REQUIRE(std::is_nothrow_move_assignable<quad_value_bit_vector>::value);
+
+    quad_value_bit_vector a(100);
+    a.set(70, quad_value(QBV_UNKNOWN_VALUE));
+
+    quad_value_bit_vector b(std::move(a));
+    REQUIRE(b.bitLength() == 100);
+    REQUIRE(b.get(70).is_unknown());
+    REQUIRE(a.bitLength() == 0);
+
+    a = std::move(b);
+    REQUIRE(a.get(70).is_unknown());
+    REQUIRE(b.bitLength() == 0);
+  }
+
+  TEST_CASE("Quad value compound assignment") {
+    quad_value_bit_vector a(100, 5);
+    quad_value_bit_vector b(100, 3);
+
+    quad_value_bit_vector c = a;
+    c += b;
+    REQUIRE(c == quad_value_bit_vector(100, 8));
+    c -= a;
+    REQUIRE(c == b);
+
+    c <<= 90;
+    REQUIRE(c.get(91) == quad_value(1));
+    c >>= quad_value_bit_vector(8, 90);
+    REQUIRE(c == b);
+
+    c &= a;
+    REQUIRE(c == quad_value_bit_vector(100, 1));
+    c |= b;
+    REQUIRE(c == b);
+    c ^= a;
+    REQUIRE(c == quad_value_bit_vector(100, 6));
+
+    b.set(80, quad_value(QBV_UNKNOWN_VALUE));
+    c += b;
+    REQUIRE(same_representation(c, unknown_bv(100)));
+
+    quad_value_bit_vector d(100, 0);
+    d |= b;
+    REQUIRE(d.get(80).is_unknown());
+    REQUIRE(d.get(0) == quad_value(1));
+  }
+
+  TEST_CASE("Quad value arena allocation") {
+    bit_vector_arena arena;
+    quad_value_bit_vector reg(200, 0);
+
+    for (int cycle = 0; cycle < 5; cycle++) {
+      {
+        arena_scope scope(arena);
+        quad_value_bit_vector next = reg;
+        next += quad_value_bit_vector(200, 3);
+        reg = std::move(next);
+      }
+      arena.reset();
+    }
+
+    REQUIRE(reg == quad_value_bit_vector(200, 15));
+
+    std::vector<quad_value_bit_vector> regs;
+    {
+      arena_scope scope(arena);
+      regs.push_back(add_general_width_bv(reg, quad_value_bit_vector(200, 1)));
+    }
+    arena.reset();
+
+    {
+      arena_scope scope(arena);
+      std::vector<quad_value_bit_vector> reuse(8, unknown_bv(200));
+      REQUIRE(!reuse.back().is_binary());
+    }
+    arena.reset();
+
+    REQUIRE(regs[0] == quad_value_bit_vector(200, 16));
+  }
+
+  TEST_CASE("Quad value unknown propagation in arithmetic") {
+    quad_value_bit_vector a(150, 1000);
+    a.set(140, 1);
+    quad_value_bit_vector b(150, 17);
+
+    quad_value_bit_vector x = b;
+    x.set(149, quad_value(QBV_UNKNOWN_VALUE));
+
+    quad_value_bit_vector z = b;
+    z.set(0, quad_value(QBV_HIGH_IMPEDANCE_VALUE));
+
+    quad_value_bit_vector all_x = unknown_bv(150);
+
+    REQUIRE(same_representation(add_general_width_bv(a, x), all_x));
+    REQUIRE(same_representation(sub_general_width_bv(z, a), all_x));
+    REQUIRE(same_representation(mul_general_width_bv(a, x), all_x));
+    REQUIRE(same_representation(mul_general_width_bv(z, a), all_x));
+    REQUIRE(same_representation(unsigned_divide(a, z), all_x));
+
+    // Fully known operands take the limb kernels
+    REQUIRE(sub_general_width_bv(add_general_width_bv(a, b), b) == a);
+    REQUIRE(unsigned_divide(mul_general_width_bv(b, b), b) == b);
+  }
+
+  TEST_CASE("Quad value cached binary summary") {
+    quad_value_bit_vector a(150, 9);
+    REQUIRE(a.is_binary());
+
+    a.set(100, quad_value(QBV_UNKNOWN_VALUE));
+    a.set(3, quad_value(QBV_HIGH_IMPEDANCE_VALUE));
+    REQUIRE(!a.is_binary());
+
+    // Clearing one unknown bit leaves the other
+    a.set(100, 1);
+    REQUIRE(!a.is_binary());
+
+    quad_value_bit_vector copy = a;
+    REQUIRE(!copy.is_binary());
+
+    a.set(3, 0);
+    REQUIRE(a.is_binary());
+    REQUIRE(!copy.is_binary());
+
+    copy.set_unknown_word(0, 0);
+    REQUIRE(copy.is_binary());
+
+    quad_value_bit_vector x = unknown_bv(150);
+    REQUIRE(!x.is_binary());
+
+    quad_value_bit_vector moved(std::move(x));
+    REQUIRE(!moved.is_binary());
+
+    moved = a;
+    REQUIRE(moved.is_binary());
+    REQUIRE(moved == a);
+
+    // A stale summary is refreshed by const readers, which may share the
+    // vector between threads
+    quad_value_bit_vector shared(150, 9);
+    shared.set(70, quad_value(QBV_UNKNOWN_VALUE));
+    shared.set(70, 1);
+
+    std::vector<std::thread> readers;
+    std::vector<int> binary(4, 0);
+    for (int i = 0; i < 4; i++) {
+      readers.push_back(std::thread([&shared, &binary, i]() {
+        binary[i] = shared.is_binary();
+      }));
+    }
+    for (size_t i = 0; i < readers.size(); i++) {
+      readers[i].join();
+    }
+    REQUIRE(binary == std::vector<int>(4, 1));
+  }
+
+  TEST_CASE("Quad value Verilog literals") {
+    SECTION("Unknown digits") {
+      quad_value_bit_vector a("8'b10xz_?z01");
+      REQUIRE(a.binary_string() == "10xzzz01");
+      REQUIRE(!a.is_binary());
+
+      REQUIRE(quad_value_bit_vector("12'hX_F").binary_string() == "xxxxxxxx1111");
+      REQUIRE(quad_value_bit_vector("6'o3z").binary_string() == "011zzz");
+    }
+
+    SECTION("A leading x or z fills the width") {
+      REQUIRE(same_representation(quad_value_bit_vector("70'hx"), unknown_bv(70)));
+      REQUIRE(same_representation(quad_value_bit_vector("70'dX"), unknown_bv(70)));
+      REQUIRE(quad_value_bit_vector("8'bz1").binary_string() == "zzzzzzz1");
+      REQUIRE(quad_value_bit_vector("8'b01").binary_string() == "00000001");
+    }
+
+    SECTION("Known literals") {
+      quad_value_bit_vector a("8'sd200");
+      REQUIRE(a.is_binary());
+      REQUIRE(a == quad_value_bit_vector(8, 200));
+      REQUIRE(quad_value_bit_vector("80'd18446744073709551616").get(64) == 1);
+    }
+
+    SECTION("Invalid digits are reported") {
+      const std::string good = "8'o7_x";
+      const std::string bad_octal = "8'o78";
+      const std::string bad_decimal = "8'd1a";
+      const std::string mixed_decimal = "8'd1x";
+      const std::string no_digits = "8'h__";
+
+      REQUIRE(check_literal_digits(parse_verilog_literal(good)));
+      REQUIRE(!check_literal_digits(parse_verilog_literal(bad_octal)));
+      REQUIRE(!check_literal_digits(parse_verilog_literal(bad_decimal)));
+      REQUIRE(!check_literal_digits(parse_verilog_literal(mixed_decimal)));
+      REQUIRE(!check_literal_digits(parse_verilog_literal(no_digits)));
+
+      bv_uint64 value = 0;
+      bv_uint64 unknown = 0;
+      bool has_unknown = false;
+      REQUIRE(!decode_verilog_literal_checked(parse_verilog_literal(bad_decimal),
+                                              &value, &unknown, &has_unknown));
+      REQUIRE(value == 0);
+      REQUIRE(unknown == 0xff);
+      REQUIRE(has_unknown);
+
+      REQUIRE(!decode_verilog_literal_checked(parse_verilog_literal(bad_octal),
+                                              &value, nullptr, &has_unknown));
+      REQUIRE(value == 0);
+      REQUIRE(!has_unknown);
+
+      REQUIRE(decode_verilog_literal_checked(parse_verilog_literal(good),
+                                             &value, &unknown, &has_unknown));
+      REQUIRE(value == 0x38);
+      REQUIRE(unknown == 0x07);
+      REQUIRE(has_unknown);
+    }
+  }
+
+  TEST_CASE("Quad value formatting into buffers") {
+    SECTION("Unknown bits across byte boundaries") {
+      quad_value_bit_vector a("20'b1x_0000_zz01_1000_0x1z");
+
+      char buf[32];
+      char* end = a.format_to(buf);
+      REQUIRE(std::string(buf, end) == "001x0000zz0110000x1z");
+      REQUIRE(std::string(buf, end) == a.binary_string());
+
+      end = a.format_hex_to(buf);
+      REQUIRE(std::string(buf, end) == "20'hx0z8z");
+    }
+
+    SECTION("Streaming wide vectors") {
+      quad_value_bit_vector a(1100);
+      a.set(1099, quad_value(QBV_UNKNOWN_VALUE));
+      a.set(600, quad_value(QBV_HIGH_IMPEDANCE_VALUE));
+      a.set(0, 1);
+
+      std::string expected(1100, '0');
+      expected[0] = 'x';
+      expected[1099 - 600] = 'z';
+      expected[1099] = '1';
+
+      stringstream ss;
+      ss << a;
+      REQUIRE(ss.str() == expected);
+      REQUIRE(a.binary_string() == expected);
+    }
+  }
+
+  TEST_CASE("Quad value decimal conversion") {
+    REQUIRE(quad_value_bit_vector("8'd200").to_decimal_string() == "200");
+
+    std::string digits = "1" + std::string(50, '0') + "7";
+    REQUIRE(quad_value_bit_vector("200'd" + digits).to_decimal_string() == digits);
+
+    REQUIRE(quad_value_bit_vector("8'hx").to_decimal_string() == "x");
+    REQUIRE(quad_value_bit_vector("70'hz").to_decimal_string() == "z");
+    REQUIRE(quad_value_bit_vector("8'b1x00_00z0").to_decimal_string() == "X");
+    REQUIRE(quad_value_bit_vector("8'b1z00_0000").to_decimal_string() == "Z");
+  }
+
+  TEST_CASE("Quad value binary serialization") {
+    quad_value_bit_vector a("130'hx_0000_0000_0000_0000_0000_0000_0000_00z1");
+    quad_value_bit_vector b(70, 12345);
+
+    std::vector<unsigned char> buffer;
+    a.serialize_to(buffer);
+    b.serialize_to(buffer);
+
+    // Only vectors with unknown bits carry the x/z plane
+    REQUIRE(a.serialized_size() == 8 + 2*3*8);
+    REQUIRE(b.serialized_size() == 8 + 2*8);
+
+    byte_span in(buffer);
+    quad_value_bit_vector c;
+    REQUIRE(c.deserialize_from(in));
+    REQUIRE(same_representation(c, a));
+    REQUIRE(!c.is_binary());
+
+    REQUIRE(c.deserialize_from(in));
+    REQUIRE(same_representation(c, b));
+    REQUIRE(c.is_binary());
+    REQUIRE(in.size == 0);
+  }
+
+  TEST_CASE("Quad value VCD tracing") {
+    std::ostringstream out;
+
+    {
+      vcd_writer vcd(out);
+      const int en = vcd.add_signal("en", 1);
+      const int bus = vcd.add_signal("bus", 8);
+      vcd.end_definitions();
+
+      vcd.set_time(0);
+      vcd.change(en, quad_value_bit_vector("1'bx"));
+      vcd.change(bus, quad_value_bit_vector("8'bx"));
+
+      vcd.set_time(1);
+      vcd.change(en, quad_value_bit_vector("1'bz"));
+      vcd.change(bus, quad_value_bit_vector("8'b0000_1z01"));
+
+      // A leading x keeps a zero in front of it, or it would fill the bus
+      vcd.set_time(2);
+      vcd.change(en, quad_value_bit_vector("1'bz"));
+      vcd.change(bus, quad_value_bit_vector("8'b0000_0x01"));
+
+      vcd.set_time(3);
+      vcd.change(en, quad_value_bit_vector("1'b1"));
+      vcd.change(bus, quad_value_bit_vector("8'b0000_0x01"));
+    }
+
+    std::string expected =
+      "$timescale 1ns $end\n"
+      "$var wire 1 ! en $end\n"
+      "$var wire 8 \" bus $end\n"
+      "$enddefinitions $end\n"
+      "#1\n"
+      "z!\n"
+      "b1z01 \"\n"
+      "#2\n"
+      "b0x01 \"\n"
+      "#3\n"
+      "1!\n";
+
+    REQUIRE(out.str() == expected);
+  }
+
+  TEST_CASE("Quad value waveform files") {
+    const temporary_file wave_file("bsim_quad_waveform");
+    const std::string& path = wave_file.path();
+
+    {
+      std::ofstream file(path, std::ios::binary);
+      waveform_writer wave(file, 32);
+      const int bus = wave.add_signal("bus", 70);
+
+      wave.set_time(0);
+      wave.change(bus, quad_value_bit_vector("70'hx"));
+      for (int t = 1; t < 100; t++) {
+        wave.set_time(t);
+        quad_value_bit_vector v(70, t);
+        if (t % 3 == 0) {
+          v.set(69, quad_value(QBV_HIGH_IMPEDANCE_VALUE));
+        }
+        wave.change(bus, v);
+      }
+    }
+
+    waveform_reader reader;
+    REQUIRE(reader.open(path));
+
+    quad_value_bit_vector v(70);
+    REQUIRE(reader.value_at(0, 0, v));
+    REQUIRE(v.same_representation(quad_value_bit_vector("70'hx")));
+
+    quad_value_bit_vector expected(70, 42);
+    expected.set(69, quad_value(QBV_HIGH_IMPEDANCE_VALUE));
+    REQUIRE(reader.value_at(0, 42, v));
+    REQUIRE(v.same_representation(expected));
+
+    REQUIRE(reader.value_at(0, 43, v));
+    REQUIRE(v.same_representation(quad_value_bit_vector(70, 43)));
+  }
+
+  TEST_CASE("Quad value memory images") {
+    const temporary_file image("bsim_quad_memory");
+    const std::string& path = image.path();
+    std::ofstream(path) << "1x_z? x 0000_0000\n@5 z\n";
+
+    packed_memory mem(16, 8);
+    REQUIRE(load_readmemh(path, mem));
+    REQUIRE(mem.has_unknown_plane());
+
+    quad_value_bit_vector v(16);
+    mem.read(0, v);
+    REQUIRE(v.same_representation(quad_value_bit_vector("16'h1xzz")));
+    mem.read(1, v);
+    REQUIRE(v.same_representation(quad_value_bit_vector("16'hx")));
+    mem.read(2, v);
+    REQUIRE(v.same_representation(quad_value_bit_vector(16, 0)));
+    mem.read(5, v);
+    REQUIRE(v.same_representation(quad_value_bit_vector("16'hz")));
+
+    mem.write(5, quad_value_bit_vector(16, 9));
+    mem.read(5, v);
+    REQUIRE(v.same_representation(quad_value_bit_vector(16, 9)));
+  }
+
   TEST_CASE("Quad value comparison") {
 
     SECTION("Equal and not equal") {
@@ -816,6 +1392,41 @@ namespace bsim {
       REQUIRE(res == dbv(9, "011000000"));
     }
 
+    SECTION("Shifts and rotates across limbs") {
+      dbv a(100);
+      a.set(99, 1);
+      a.set(2, 1);
+
+      dbv shifted(100);
+      shifted.set(66, 1);
+
+      REQUIRE(shl(a, dbv(8, 64)) == shifted);
+      REQUIRE(lshr(a, dbv(8, 100)) == dbv(100, 0));
+      REQUIRE(ashr(a, dbv(8, 200)) == ~dbv(100, 0));
+
+      dbv rotated(100);
+      rotated.set(0, 1);
+      rotated.set(3, 1);
+
+      REQUIRE(rotate_left(a, dbv(8, 1)) == rotated);
+      REQUIRE(rotate_right(rotated, dbv(8, 101)) == a);
+      REQUIRE(rotate_left(a, dbv(8, 0)) == a);
+      REQUIRE(rotate_right(rotate_left(a, dbv(8, 70)), dbv(8, 70)) == a);
+
+      dbv by_70(100);
+      by_70.set(69, 1);
+      by_70.set(72, 1);
+      REQUIRE(rotate_left(a, dbv(8, 70)) == by_70);
+
+      dbv sign_filled(100);
+      sign_filled.set(96, 1);
+      sign_filled.set(97, 1);
+      sign_filled.set(98, 1);
+      sign_filled.set(99, 1);
+      REQUIRE(ashr(a, dbv(8, 3)) == sign_filled);
+      REQUIRE(a.get(99) == quad_value(1));
+    }
+
     SECTION("lshr by bit vector width") {
       dbv a(16, "0010111011010100");
       dbv b(16, "0000000000010000");
@@ -2,6 +2,8 @@
 
 #include "static_quad_value_bit_vector.h"
 
+#include <sstream>
+
 using namespace std;
 
 namespace bsim {
@@ -896,4 +898,180 @@ namespace bsim {
 //     REQUIRE(negate_general_width_bv(a) == b);
 //   }
 
+  TEST_CASE("static_quad_value packed planes") {
+
+    SECTION("64 bit register fits in two limbs") {
+      REQUIRE(sizeof(static_quad_value_bit_vector<64>) == 2*sizeof(bv_uint64));
+    }
+
+    SECTION("Unknowns through logic operations") {
+      static_quad_value_bit_vector<70> a;
+      a.set(69, QBV_UNKNOWN_VALUE);
+      a.set(68, 1);
+      a.set(1, QBV_HIGH_IMPEDANCE_VALUE);
+
+      static_quad_value_bit_vector<70> b;
+      b.set(69, 1);
+      b.set(68, 1);
+      b.set(1, 1);
+
+      static_quad_value_bit_vector<70> c = a & b;
+
+      REQUIRE(c.get(69).is_unknown());
+      REQUIRE(c.get(68) == 1);
+      REQUIRE(c.get(1).is_unknown());
+
+      REQUIRE((a | b).get(69) == 1);
+      REQUIRE((a ^ b).get(69).is_unknown());
+      REQUIRE((~a).get(68) == 0);
+      REQUIRE(same_representation(~(~b), b));
+    }
+
+    SECTION("Comparison across limbs") {
+      static_quad_value_bit_vector<100> a;
+      a.set(90, 1);
+
+      static_quad_value_bit_vector<100> b;
+      b.set(10, 1);
+
+      REQUIRE(a > b);
+      REQUIRE(b < a);
+      REQUIRE(orr(a) == static_quad_value_bit_vector<1>(1));
+      REQUIRE(andr(~a) == static_quad_value_bit_vector<1>(0));
+    }
+  }
+
+  TEST_CASE("static_quad_value division") {
+    static_quad_value_bit_vector<130> a(1000);
+    a.set(120, 1);
+
+    static_quad_value_bit_vector<130> b(37);
+
+    static_quad_value_bit_vector<130> q, r;
+    unsigned_div_rem(a, b, q, r);
+
+    REQUIRE(add_general_width_bv(mul_general_width_bv(q, b), r) == a);
+    REQUIRE(r < b);
+
+    b.set(5, quad_value(QBV_UNKNOWN_VALUE));
+    REQUIRE(same_representation(unsigned_divide(a, b), unknown_bv<130>()));
+  }
+
+  TEST_CASE("static_quad_value unknown propagation in arithmetic") {
+    static_quad_value_bit_vector<150> a(1000);
+    a.set(140, 1);
+    static_quad_value_bit_vector<150> b(17);
+
+    static_quad_value_bit_vector<150> x = b;
+    x.set(149, quad_value(QBV_UNKNOWN_VALUE));
+
+    REQUIRE(same_representation(add_general_width_bv(a, x), unknown_bv<150>()));
+    REQUIRE(same_representation(mul_general_width_bv(x, a), unknown_bv<150>()));
+    REQUIRE(sub_general_width_bv(add_general_width_bv(a, b), b) == a);
+    REQUIRE(unsigned_divide(mul_general_width_bv(b, b), b) == b);
+  }
+
+  TEST_CASE("static_quad_value cached binary summary") {
+    static_quad_value_bit_vector<130> a(9);
+    REQUIRE(a.is_binary());
+
+    a.set(129, quad_value(QBV_UNKNOWN_VALUE));
+    REQUIRE(!a.is_binary());
+
+    static_quad_value_bit_vector<130> copy = a;
+    REQUIRE(!copy.is_binary());
+
+    a.set(129, 1);
+    REQUIRE(a.is_binary());
+    REQUIRE(!copy.is_binary());
+
+    copy = a;
+    REQUIRE(copy.is_binary());
+
+    a.set_unknown_word(1, 0x4);
+    REQUIRE(!a.is_binary());
+    a.set_unknown_word(1, 0);
+    REQUIRE(a.is_binary());
+  }
+
+  TEST_CASE("static_quad_value binary serialization") {
+    static_quad_value_bit_vector<130> a(77);
+    a.set(129, quad_value(QBV_HIGH_IMPEDANCE_VALUE));
+
+    std::vector<unsigned char> buffer;
+    a.serialize_to(buffer);
+
+    byte_span in(buffer);
+    static_quad_value_bit_vector<129> wrong_width;
+    REQUIRE(!wrong_width.deserialize_from(in));
+
+    static_quad_value_bit_vector<130> b;
+    REQUIRE(b.deserialize_from(in));
+    REQUIRE(same_representation(a, b));
+    REQUIRE(!b.is_binary());
+  }
+
+  TEST_CASE("static_quad_value compound assignment") {
+    static_quad_value_bit_vector<100> a(5);
+    static_quad_value_bit_vector<100> b(3);
+
+    static_quad_value_bit_vector<100> c = a;
+    c += b;
+    REQUIRE(c == static_quad_value_bit_vector<100>(8));
+    c -= a;
+    REQUIRE(c == b);
+
+    c <<= 90;
+    REQUIRE(c.get(91) == 1);
+    c >>= 90;
+    REQUIRE(c == b);
+
+    // Bits shifted past the top are dropped
+    static_quad_value_bit_vector<100> d = b;
+    d <<= 99;
+    d >>= 99;
+    REQUIRE(d == static_quad_value_bit_vector<100>(1));
+
+    c &= a;
+    REQUIRE(c == static_quad_value_bit_vector<100>(1));
+    c |= b;
+    c ^= a;
+    REQUIRE(c == static_quad_value_bit_vector<100>(6));
+
+    b.set(80, quad_value(QBV_UNKNOWN_VALUE));
+    c -= b;
+    REQUIRE(same_representation(c, unknown_bv<100>()));
+  }
+
+  TEST_CASE("static_quad_value spans") {
+    static_quad_value_bit_vector<100> a;
+    a.set(90, quad_value(QBV_UNKNOWN_VALUE));
+    a.set(62, 1);
+
+    static_quad_value_bit_vector<100> b;
+    span(b, 40, 100).assign(const_span(a, 40, 100));
+    REQUIRE(same_representation(a, b));
+    REQUIRE(!b.is_binary());
+
+    span(b, 90, 91).set_unknown_word(0, 0);
+    REQUIRE(b.is_binary());
+    REQUIRE(const_span(b, 60, 64).get_value_word(0) == 4);
+  }
+
+  TEST_CASE("static_quad_value streaming wide vectors") {
+    static_quad_value_bit_vector<1100> a;
+    a.set(1099, quad_value(QBV_UNKNOWN_VALUE));
+    a.set(600, quad_value(QBV_HIGH_IMPEDANCE_VALUE));
+    a.set(0, 1);
+
+    std::string expected(1100, '0');
+    expected[0] = 'x';
+    expected[1099 - 600] = 'z';
+    expected[1099] = '1';
+
+    stringstream ss;
+    ss << a;
+    REQUIRE(ss.str() == expected);
+  }
+
 }
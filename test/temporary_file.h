@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// A uniquely named file in the temporary directory for tests that write
+// files. The file is removed when the object goes out of scope, so it is
+// cleaned up even when a REQUIRE fails part way through a test.
+
+namespace bsim {
+
+  class temporary_file {
+    std::string file_path;
+
+    temporary_file(const temporary_file&);
+    temporary_file& operator=(const temporary_file&);
+
+  public:
+
+    explicit temporary_file(const std::string& prefix) {
+      const char* dir = getenv("TMPDIR");
+      std::string pattern = std::string(dir != nullptr ? dir : "/tmp") +
+        "/" + prefix + "_XXXXXX";
+
+      std::vector<char> name(pattern.begin(), pattern.end());
+      name.push_back('\0');
+
+      const int fd = mkstemp(&name[0]);
+      assert(fd >= 0);
+      close(fd);
+
+      file_path = &name[0];
+    }
+
+    ~temporary_file() {
+      std::remove(file_path.c_str());
+    }
+
+    inline const std::string& path() const {
+      return file_path;
+    }
+  };
+
+}